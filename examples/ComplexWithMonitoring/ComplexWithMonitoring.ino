@@ -237,7 +237,7 @@ const char* Modes [] =
 
 void DisplayStats ( void )
 {
-	static uint8_t						uiLastCount [ NUM_MOTORS ];
+	static uint32_t						ulLastCount [ NUM_MOTORS ];
 	static bool							bLastState [ NUM_MOTORS ];
 	static uint32_t						ulLastMotorRunTime [ NUM_MOTORS ];
 	static uint32_t						ulLastIdleSecs = 0UL;
@@ -246,24 +246,29 @@ void DisplayStats ( void )
 	static String						sLastState;
 	static String						sLastMode = F ( "None" );
 
-	uint32_t ulIdleSecs = TheOiler.GetTimeOilerIdle ();
+	// take a consistent copy of everything displayed, rather than reading each value whilst interrupts may be changing them
+	OilerClass::SNAPSHOT		Snapshot;
+	OilerClass::MOTOR_SNAPSHOT	Motors [ NUM_MOTORS ];
+	uint8_t uiNumMotors = TheOiler.GetSnapshot ( &Snapshot, Motors, NUM_MOTORS );
+
+	uint32_t ulIdleSecs = Snapshot.ulIdlems / 1000;
 	if ( ulIdleSecs != ulLastIdleSecs )
 	{
 		ulLastIdleSecs = ulIdleSecs;
 		ClearPartofLine ( STATS_ROW, STATS_RESULT_COL, MAX_COLS - STATS_RESULT_COL );
 		AT ( STATS_ROW, STATS_RESULT_COL, String ( ulIdleSecs ) );
 	}
-	for ( int i = 0; i < NUM_MOTORS; i++ )
+	for ( uint8_t i = 0; i < uiNumMotors; i++ )
 	{
-		uint8_t uiWorkDone = TheOiler.GetMotorWorkCount ( i );
-		if ( uiWorkDone != uiLastCount [ i ] )
+		uint32_t ulWorkDone = Motors [ i ].ulWorkCount;
+		if ( ulWorkDone != ulLastCount [ i ] )
 		{
-			uiLastCount [ i ] = uiWorkDone;
+			ulLastCount [ i ] = ulWorkDone;
 			ClearPartofLine ( STATS_ROW + i * 3 + 1, STATS_RESULT_COL, MAX_COLS - STATS_RESULT_COL );
-			AT ( STATS_ROW + i * 3 + 1, STATS_RESULT_COL, String ( uiWorkDone ) );
+			AT ( STATS_ROW + i * 3 + 1, STATS_RESULT_COL, String ( ulWorkDone ) );
 		}
 
-		bool bResult = TheOiler.IsMotorRunning ( i );
+		bool bResult = Motors [ i ].State == OilerMotorBaseClass::MOVING;
 		if ( bResult != bLastState [ i ] )
 		{
 			bLastState [ i ] = bResult;
@@ -271,7 +276,7 @@ void DisplayStats ( void )
 			AT ( STATS_ROW + i * 3 + 2, STATS_RESULT_COL, bResult == true ? F ( "Running" ) : F ( "Stopped" ) );
 		}
 
-		uint32_t ulResult = TheOiler.GetTimeSinceMotorStarted ( i );
+		uint32_t ulResult = Motors [ i ].ulRunningms / 1000;
 		if ( ulResult != ulLastMotorRunTime [ i ] )
 		{
 			ulLastMotorRunTime [ i ] = ulResult;
@@ -281,7 +286,7 @@ void DisplayStats ( void )
 	}
 
 	// Update machine info if necessary
-	uint32_t ulMachineUnits = TheMachine.GetWorkUnits ();
+	uint32_t ulMachineUnits = Snapshot.ulMachineWorkUnits [ 0 ];
 	if ( ulMachineUnits != ulLastMachineUnits )
 	{
 		ulLastMachineUnits = ulMachineUnits;
@@ -289,7 +294,7 @@ void DisplayStats ( void )
 		AT ( STATS_ROW + 7, STATS_RESULT_COL, String ( ulMachineUnits ) );
 	}
 
-	uint32_t ulMachineIdleSecs = TheMachine.GetActiveTime ();
+	uint32_t ulMachineIdleSecs = Snapshot.ulMachineActivems [ 0 ] / 1000;
 	if ( ulMachineIdleSecs != ulLastMachineIdleSecs )
 	{
 		ulLastMachineIdleSecs = ulMachineIdleSecs;
@@ -319,15 +324,15 @@ void DisplayStats ( void )
 	}
 
 	String sState;
-	if ( TheOiler.IsIdle () )
+	if ( Snapshot.Status == OilerClass::IDLE )
 	{
 		sState = F ( "Idle" );
 	} 
-	else if ( TheOiler.IsOff () )
+	else if ( Snapshot.Status == OilerClass::OFF )
 	{
 		sState = F ( "Off" );
 	} 
-	else if ( TheOiler.IsOiling () )
+	else if ( Snapshot.Status == OilerClass::OILING )
 	{
 		sState = F ( "Oiling" );
 	}
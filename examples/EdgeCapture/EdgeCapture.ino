@@ -0,0 +1,78 @@
+/*
+	OilerLib Example sketch - EdgeCapture
+
+	Author:	Mark Naylor, 2021
+
+	Description
+
+	This sample sketch demonstrates capturing the timing of the drip sensor and lathe signals while the oiler runs, so they can be replayed
+	on a PC with the host tools in extras/sim (see readme.txt).
+	It uses one dc motor controlled by a relay, with pins matching those oiler_sim uses so a capture can be replayed without changes:
+		relay on pin 4, drip sensor on pin 8, lathe active signal on pin 2 and spindle signal on pin 3
+
+	Send these characters over Serial:
+		s	start capturing, anything captured before is discarded
+		x	stop capturing
+		d	write the edges captured so far in binary. The first d after s writes the trace header, each later d carries on the same trace
+
+	Save what the sketch sends after each d to one file with a terminal program that can log binary, e.g. PuTTY, then run
+		oiler_sim --motors 1 --mode work --target 5000 --replay capture.otr --trace
+	The capture buffer holds CAPTURE_SIZE - 1 port changes, send d often enough that it does not fill, edges that do not fit are lost and counted.
+*/
+#include "OilerLib.h"
+#include "EdgeCapture.h"
+
+#define RELAY_PIN						4
+#define DRIP_SENSOR_PIN					8
+#define MACHINE_ACTIVE_PIN				2
+#define MACHINE_WORK_PIN				3
+#define SPINDLE_REVS					5000		// restart pump after this many spindle revolutions
+#define CAPTURE_SIZE					64			// power of 2, each port change uses 6 bytes
+
+EdgeCaptureClass::EDGE CaptureBuffer [ CAPTURE_SIZE ];
+EdgeCaptureClass Capture ( CaptureBuffer, CAPTURE_SIZE );
+
+void setup ()
+{
+	Serial.begin ( 115200 );
+	while ( !Serial );
+
+	if ( TheOiler.AddMotor ( RELAY_PIN, DRIP_SENSOR_PIN ) == false || TheMachine.AddFeatures ( MACHINE_ACTIVE_PIN, MACHINE_WORK_PIN ) == false )
+	{
+		Serial.println ( F ( "Unable to set up oiler, stopped" ) );
+		while ( 1 );
+	}
+	TheOiler.AddMachine ( &TheMachine );
+	TheOiler.SetStartEventToTargetWork ( SPINDLE_REVS );
+
+	// pins are already set up by the oiler and machine, capture just records their signals
+	Capture.AddPin ( DRIP_SENSOR_PIN );
+	Capture.AddPin ( MACHINE_ACTIVE_PIN );
+	Capture.AddPin ( MACHINE_WORK_PIN );
+
+	TheOiler.On ();
+}
+
+void loop ()
+{
+	if ( Serial.available () > 0 )
+	{
+		switch ( Serial.read () )
+		{
+			case 's':
+				Capture.Start ();
+				break;
+
+			case 'x':
+				Capture.Stop ();
+				break;
+
+			case 'd':
+				Capture.WriteTrace ( Serial );
+				break;
+
+			default:
+				break;
+		}
+	}
+}
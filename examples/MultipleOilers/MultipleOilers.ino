@@ -0,0 +1,81 @@
+/*
+	OilerLib Example sketch - MultipleOilers
+
+	Author:	Mark Naylor, June 2021
+
+	Description
+
+	This sample sketch demonstrates using the OilerLib library to run two independently configured groups of pumps on one board:
+		the way oiler group has two relay driven pumps, restarts every 60 seconds and signals its own alert pin if a pump is delayed
+		the headstock oiler group has one relay driven pump, restarts every 20 seconds and signals a different alert pin
+	Each group is an OilerGroupClass that owns its motors and its own timer and pin callbacks, so turning one group off does not affect the other.
+	TheOiler is not used so it takes no memory.
+*/
+#include "OilerLib.h"
+
+#define WAY_PUMP1_PIN					4			// digital pin driving relay of first way oil pump
+#define WAY_PUMP2_PIN					5			// digital pin driving relay of second way oil pump
+#define WAY_DRIP1_PIN					17			// digital pin which will go high when drips sent from way pump 1
+#define WAY_DRIP2_PIN					3			// digital pin which will go high when drips sent from way pump 2
+#define WAY_ALERT_PIN					19			// digital pin signalled if way oil is delayed
+#define WAY_RESTART_SECS				60			// restart way pumps every 60 seconds
+
+#define HEAD_PUMP_PIN					6			// digital pin driving relay of headstock oil pump
+#define HEAD_DRIP_PIN					8			// digital pin which will go high when drips sent from headstock pump
+#define HEAD_ALERT_PIN					18			// digital pin signalled if headstock oil is delayed
+#define HEAD_RESTART_SECS				20			// restart headstock pump every 20 seconds
+
+OilerGroupClass<2> WayOiler;
+OilerGroupClass<1> HeadOiler;
+
+void setup ()
+{
+	Serial.begin ( 19200 );
+	while ( !Serial );
+
+	String Heading = F ( "\nOiler Example Sketch, Version " );
+	Heading += String ( OILER_VERSION );
+	Serial.println ( Heading );
+
+	if ( WayOiler.AddMotor ( WAY_PUMP1_PIN, WAY_DRIP1_PIN ) == false || WayOiler.AddMotor ( WAY_PUMP2_PIN, WAY_DRIP2_PIN ) == false )
+	{
+		Serial.println ( F ( "Unable to add way oil pumps, stopped" ) );
+		while ( 1 );
+	}
+	if ( HeadOiler.AddMotor ( HEAD_PUMP_PIN, HEAD_DRIP_PIN ) == false )
+	{
+		Serial.println ( F ( "Unable to add headstock oil pump, stopped" ) );
+		while ( 1 );
+	}
+
+	// each group has its own restart period and alert
+	WayOiler.SetStartEventToTime ( WAY_RESTART_SECS );
+	WayOiler.SetAlert ( WAY_ALERT_PIN, 3 * WAY_RESTART_SECS );
+	HeadOiler.SetStartEventToTime ( HEAD_RESTART_SECS );
+	HeadOiler.SetAlert ( HEAD_ALERT_PIN, 3 * HEAD_RESTART_SECS );
+
+	if ( WayOiler.On () == false || HeadOiler.On () == false )
+	{
+		Serial.println ( F ( "Unable to start oilers, stopped" ) );
+		while ( 1 );
+	}
+	Serial.println ( F ( "Oilers started" ) );
+}
+
+void loop ()
+{
+	static bool bLastWayAlert = false;
+	static bool bLastHeadAlert = false;
+
+	if ( WayOiler.IsAlert () != bLastWayAlert )
+	{
+		bLastWayAlert = WayOiler.IsAlert ();
+		Serial.println ( bLastWayAlert ? F ( "Way oil alert" ) : F ( "Way oil alert cleared" ) );
+	}
+	if ( HeadOiler.IsAlert () != bLastHeadAlert )
+	{
+		bLastHeadAlert = HeadOiler.IsAlert ();
+		Serial.println ( bLastHeadAlert ? F ( "Headstock oil alert" ) : F ( "Headstock oil alert cleared" ) );
+	}
+	delay ( 500 );
+}
@@ -0,0 +1,122 @@
+// BenchCompare.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// oiler_bench_compare, compares benchmark results with a baseline, both CSV files of name,samples,min,max,mean as written by RunSimavr.cmake.
+//
+//	oiler_bench_compare baseline.csv results.csv [tolerance %]
+//
+// Prints each benchmark's mean and max against the baseline. A benchmark regresses if its mean or max exceeds the baseline by more than the
+// tolerance (default 0, cycle counts under simavr are exact so any increase is a change), a benchmark in the baseline but not the results
+// also fails. Benchmarks not in the baseline are reported as new. Lines starting with # and the header are ignored. A baseline with no results
+// has not been generated yet, a warning is printed and every result is reported as new rather than the comparison failing.
+// Exits 0 if nothing regressed, 1 if something did and 2 on error.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+typedef struct
+{
+	unsigned long	ulSamples;
+	unsigned long	ulMin;
+	unsigned long	ulMax;
+	double			dMean;
+} BENCH_RESULT;
+
+typedef std::map<std::string, BENCH_RESULT> BENCH_RESULTS;
+
+/// <summary>
+/// Reads results, lines of name,samples,min,max,mean
+/// </summary>
+/// <param name="pFileName">CSV file</param>
+/// <param name="pResults">filled with result of each benchmark</param>
+/// <returns>true if read</returns>
+static bool LoadResults ( const char* pFileName, BENCH_RESULTS* pResults )
+{
+	bool bResult = false;
+	FILE* pFile = fopen ( pFileName, "r" );
+	if ( pFile != NULL )
+	{
+		char Line [ 256 ];
+		bResult = true;
+		while ( bResult && fgets ( Line, sizeof ( Line ), pFile ) != NULL )
+		{
+			char Name [ 128 ];
+			BENCH_RESULT Result;
+			if ( sscanf ( Line, "%127[^,],%lu,%lu,%lu,%lf", Name, &Result.ulSamples, &Result.ulMin, &Result.ulMax, &Result.dMean ) == 5 )
+			{
+				( *pResults ) [ Name ] = Result;
+			}
+			else
+			{
+				bResult = Line [ 0 ] == '\n' || Line [ 0 ] == '#' || strncmp ( Line, "name,", 5 ) == 0;
+			}
+		}
+		fclose ( pFile );
+	}
+	if ( !bResult )
+	{
+		fprintf ( stderr, "oiler_bench_compare: unable to read %s\n", pFileName );
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Percentage change from baseline, 0 if baseline is 0 and value is too
+/// </summary>
+static double PercentChange ( double dBaseline, double dValue )
+{
+	return dBaseline == 0 ? ( dValue == 0 ? 0 : 100 ) : ( dValue - dBaseline ) * 100 / dBaseline;
+}
+
+int main ( int iArgc, char** ppArgv )
+{
+	if ( iArgc < 3 || iArgc > 4 )
+	{
+		fprintf ( stderr, "usage: oiler_bench_compare baseline.csv results.csv [tolerance %%]\n" );
+		return 2;
+	}
+	double dTolerance = iArgc == 4 ? atof ( ppArgv [ 3 ] ) : 0;
+	BENCH_RESULTS Baseline, Results;
+	if ( !LoadResults ( ppArgv [ 1 ], &Baseline ) || !LoadResults ( ppArgv [ 2 ], &Results ) )
+	{
+		return 2;
+	}
+	if ( Baseline.empty () )
+	{
+		fprintf ( stderr, "oiler_bench_compare: warning, baseline %s has no results so nothing is checked, generate it with the matching _baseline target\n", ppArgv [ 1 ] );
+	}
+
+	bool bRegressed = false;
+	printf ( "%-36s %10s %10s %8s %8s %8s %8s\n", "benchmark", "mean", "baseline", "change", "max", "baseline", "change" );
+	for ( BENCH_RESULTS::iterator it = Results.begin (); it != Results.end (); ++it )
+	{
+		BENCH_RESULTS::iterator itBase = Baseline.find ( it->first );
+		if ( itBase == Baseline.end () )
+		{
+			printf ( "%-36s %10.1f %10s %8s %8lu %8s %8s  new\n", it->first.c_str (), it->second.dMean, "-", "-", it->second.ulMax, "-", "-" );
+		}
+		else
+		{
+			double dMeanChange = PercentChange ( itBase->second.dMean, it->second.dMean );
+			double dMaxChange = PercentChange ( (double)itBase->second.ulMax, (double)it->second.ulMax );
+			bool bWorse = dMeanChange > dTolerance || dMaxChange > dTolerance;
+			printf ( "%-36s %10.1f %10.1f %+7.1f%% %8lu %8lu %+7.1f%%%s\n", it->first.c_str (), it->second.dMean, itBase->second.dMean, dMeanChange,
+				it->second.ulMax, itBase->second.ulMax, dMaxChange, bWorse ? "  REGRESSED" : "" );
+			bRegressed |= bWorse;
+		}
+	}
+	for ( BENCH_RESULTS::iterator it = Baseline.begin (); it != Baseline.end (); ++it )
+	{
+		if ( Results.find ( it->first ) == Results.end () )
+		{
+			printf ( "%-36s missing from results\n", it->first.c_str () );
+			bRegressed = true;
+		}
+	}
+	printf ( "%s\n", bRegressed ? "benchmarks regressed" : Baseline.empty () ? "no baseline, nothing checked" : "no regressions" );
+	return bRegressed ? 1 : 0;
+}
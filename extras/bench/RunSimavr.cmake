@@ -0,0 +1,30 @@
+# Runs a benchmark firmware under simavr and writes the results it prints over Serial as CSV
+#
+#	cmake -DSIMAVR=simavr -DFIRMWARE=isr_bench.elf -DRESULTS=results.csv [-DTITLE=text] -P RunSimavr.cmake
+#
+# The firmware prints a line bench,name,samples,min,max,mean for each benchmark and then sleeps with interrupts disabled, which ends simavr.
+# Lines are matched wherever they appear in simavr's output, which may surround them with its own text and colour codes.
+#
+foreach ( Var SIMAVR FIRMWARE RESULTS )
+	if ( NOT DEFINED ${Var} )
+		message ( FATAL_ERROR "RunSimavr.cmake: ${Var} not set" )
+	endif ()
+endforeach ()
+
+execute_process ( COMMAND ${SIMAVR} -m atmega328p -f 16000000 ${FIRMWARE}
+	OUTPUT_VARIABLE Output ERROR_VARIABLE Errors RESULT_VARIABLE Result TIMEOUT 600 )
+
+string ( REGEX MATCHALL "bench,[A-Za-z0-9_.]+,[0-9]+,[0-9]+,[0-9]+,[0-9]+\\.[0-9]" Lines "${Output}${Errors}" )
+if ( NOT Lines )
+	message ( FATAL_ERROR "RunSimavr.cmake: no results from ${FIRMWARE} (simavr returned ${Result})\n${Output}${Errors}" )
+endif ()
+
+if ( DEFINED TITLE )
+	set ( Csv "# ${TITLE}\n" )
+endif ()
+string ( APPEND Csv "name,samples,min,max,mean\n" )
+foreach ( Line ${Lines} )
+	string ( REGEX REPLACE "^bench," "" Line "${Line}" )
+	string ( APPEND Csv "${Line}\n" )
+endforeach ()
+file ( WRITE ${RESULTS} "${Csv}" )
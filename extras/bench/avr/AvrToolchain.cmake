@@ -0,0 +1,19 @@
+# Cross compiles for an ATmega328P with avr-gcc, used by the AVR benchmarks in this directory
+#
+# avr-gcc is found on the PATH or in AVR_TOOLCHAIN_DIR, e.g. the hardware/tools/avr/bin directory of an Arduino IDE install
+#
+set ( CMAKE_SYSTEM_NAME Generic )
+set ( CMAKE_SYSTEM_PROCESSOR avr )
+
+find_program ( AVR_GCC avr-gcc HINTS ${AVR_TOOLCHAIN_DIR} )
+find_program ( AVR_GXX avr-g++ HINTS ${AVR_TOOLCHAIN_DIR} )
+if ( NOT AVR_GCC OR NOT AVR_GXX )
+	message ( FATAL_ERROR "avr-gcc not found, add it to the PATH or set AVR_TOOLCHAIN_DIR" )
+endif ()
+
+set ( CMAKE_C_COMPILER ${AVR_GCC} )
+set ( CMAKE_CXX_COMPILER ${AVR_GXX} )
+set ( CMAKE_ASM_COMPILER ${AVR_GCC} )
+
+# a test program cannot be linked without knowing the mcu
+set ( CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY )
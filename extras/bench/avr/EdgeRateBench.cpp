@@ -0,0 +1,245 @@
+// EdgeRateBench.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// Firmware that finds, on an ATmega328P, the shortest time between drips (and spindle pulses) at which the library still counts every one,
+// with 0 to 3 steppers running at different step rates. Built by extras/bench/avr and run under simavr by the avr_edge_bench target, see
+// readme.txt. It would run the same on an Uno with nothing connected to pins 9 and 10, the results are sent over Serial.
+//
+// Timer1 makes the edges. In CTC mode it toggles OC1A, pin 9, the drip sensor of a relay motor, and optionally OC1B, pin 10, the spindle
+// signal of TheMachine, half a period later. Both are outputs so the pins are driven by the timer, and a pin change interrupt fires for an
+// output pin just as for an input. Each trial runs for TRIAL_MS with the sketch idle, as it would be in loop(), and then stops the timer
+// between toggles. The toggles made are worked out from the time the timer ran, read from micros(), and the count left in Timer1, which is
+// exact as long as micros() is within half a period. Every falling edge should then have added one to the motor's work count or the
+// machine's work units.
+//
+// For each combination a binary search finds the shortest drip interval, in us, with every edge counted. Each result is a line
+// bench,edge_interval_us.<combination>,edges,us,us,us.0 so the results can be compared with a baseline like the cycle counts of
+// IsrBench.cpp, a longer interval is worse. A combination that counts every edge at MIN_INTERVAL_US reports MIN_INTERVAL_US and one that
+// loses edges even at MAX_INTERVAL_US reports NO_INTERVAL_US, longer than any interval tried so it compares as a regression rather than an
+// improvement. The firmware then sleeps with interrupts disabled, which ends simavr.
+//
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "OilerLib.h"
+#include "FourPinStepperMotor.h"
+
+#define RELAY_PIN					4
+#define DRIP_PIN					9					// OC1A
+#define SPINDLE_PIN					10					// OC1B
+#define MACHINE_ACTIVE_PIN			12
+#define MAX_STEPPERS				3
+#define TRIAL_MS					100
+#define MIN_INTERVAL_US				64					// shortest time between drips tried, a toggle every 32us, micros() must be within half of it
+#define MAX_INTERVAL_US				8000				// longest time between drips tried
+#define NO_INTERVAL_US				0xFFFF				// reported if edges are lost even at MAX_INTERVAL_US
+#define DRIPS_TO_STOP				0xFFFFFFFFUL		// motor keeps moving for the whole run
+
+// steppers are not part of the oiler, they only load the timer interrupt as they would when oiling
+StaticFourPinStepperMotorClass Stepper1 ( 14, 15, 16, 17, NOT_A_PIN, DRIPS_TO_STOP, 0, 2000, 0 );
+StaticFourPinStepperMotorClass Stepper2 ( 18, 19, 2, 3, NOT_A_PIN, DRIPS_TO_STOP, 0, 2000, 0 );
+StaticFourPinStepperMotorClass Stepper3 ( 5, 6, 7, 8, NOT_A_PIN, DRIPS_TO_STOP, 0, 2000, 0 );
+StaticFourPinStepperMotorClass* Steppers [ MAX_STEPPERS ] = { &Stepper1, &Stepper2, &Stepper3 };
+
+const uint16_t StepIntervals [] = { 2000, 1000, 500 };	// us between steps, 500 is the fastest the timer can step
+
+/// <summary>
+/// Runs the given number of steppers at the given step interval, the rest are stopped
+/// </summary>
+/// <param name="uiCount">steppers to run</param>
+/// <param name="ulStepus">us between steps</param>
+static void SetSteppers ( uint8_t uiCount, uint32_t ulStepus )
+{
+	for ( uint8_t i = 0; i < MAX_STEPPERS; i++ )
+	{
+		Steppers [ i ]->Off ();
+	}
+	for ( uint8_t i = 0; i < uiCount; i++ )
+	{
+		Steppers [ i ]->SetSpeed ( ulStepus );
+		Steppers [ i ]->SetDriveLevel ( DRIVE_LEVEL_NOMINAL );
+		Steppers [ i ]->On ();
+	}
+}
+
+/// <summary>
+/// Makes edges for TRIAL_MS and checks every falling edge was counted
+/// </summary>
+/// <param name="uiIntervalus">us between falling edges of each pin, even</param>
+/// <param name="bSpindle">true to also make edges on the spindle pin</param>
+/// <param name="pulEdges">set to the falling edges made</param>
+/// <returns>true if every falling edge was counted</returns>
+static bool RunTrial ( uint16_t uiIntervalus, bool bSpindle, uint32_t* pulEdges )
+{
+	// Timer1 at clk/8 counts half us, so toggling every uiIntervalus ticks gives a falling edge every uiIntervalus us
+	uint16_t uiPeriod = uiIntervalus;
+	uint32_t ulDrips = TheOiler.GetMotorWorkCount ( 0 );
+	uint32_t ulRevs = TheMachine.GetWorkUnits ();
+
+	noInterrupts ();
+	TCNT1 = 0;
+	OCR1A = uiPeriod - 1;
+	OCR1B = uiPeriod / 2 - 1;
+	TCCR1A = _BV ( COM1A0 ) | ( bSpindle ? _BV ( COM1B0 ) : 0 );
+	uint32_t ulStartus = micros ();
+	TCCR1B = _BV ( WGM12 ) | _BV ( CS11 );
+	interrupts ();
+
+	delay ( TRIAL_MS );
+
+	// stop between the drip pin's toggle at the end of a period and the spindle pin's half way through it. This waits up to a period with
+	// interrupts disabled, so micros() is read first and the ticks waited are added to it, each pin toggles at most once whilst waiting
+	noInterrupts ();
+	uint32_t ulElapsed = ( micros () - ulStartus ) * 2;
+	uint16_t uiFirst = TCNT1;
+	uint16_t uiCount;
+	do
+	{
+		uiCount = TCNT1;
+	} while ( uiCount < uiPeriod / 4 || uiCount >= uiPeriod / 2 - 1 );
+	TCCR1B = 0;
+	uiCount = TCNT1;
+	ulElapsed += uiCount >= uiFirst ? uiCount - uiFirst : uiCount + uiPeriod - uiFirst;
+
+	// each pin toggled once in every whole period, an odd number leaves it HIGH so it is forced LOW, making one more falling edge
+	uint32_t ulToggles = ( ulElapsed - uiCount + uiPeriod / 2 ) / uiPeriod;
+	if ( digitalRead ( DRIP_PIN ) == HIGH )
+	{
+		TCCR1C = _BV ( FOC1A );
+	}
+	if ( bSpindle && digitalRead ( SPINDLE_PIN ) == HIGH )
+	{
+		TCCR1C = _BV ( FOC1B );
+	}
+	interrupts ();
+	delay ( 2 );
+
+	uint32_t ulExpected = ( ulToggles + 1 ) / 2;
+	*pulEdges = bSpindle ? ulExpected * 2 : ulExpected;
+	return TheOiler.GetMotorWorkCount ( 0 ) - ulDrips == ulExpected && TheMachine.GetWorkUnits () - ulRevs == ( bSpindle ? ulExpected : 0 );
+}
+
+/// <summary>
+/// Binary search for the shortest interval between falling edges at which every edge is counted
+/// </summary>
+/// <param name="bSpindle">true to also make edges on the spindle pin</param>
+/// <param name="pulEdges">set to the falling edges made at the interval found</param>
+/// <returns>interval in us, NO_INTERVAL_US if edges are lost even at MAX_INTERVAL_US</returns>
+static uint16_t FindShortestInterval ( bool bSpindle, uint32_t* pulEdges )
+{
+	uint16_t uiResult = NO_INTERVAL_US;
+	uint32_t ulEdges = 0;
+	*pulEdges = 0;
+	if ( RunTrial ( MAX_INTERVAL_US, bSpindle, pulEdges ) )
+	{
+		// in units of 2us so the half period is whole ticks
+		uint16_t uiLow = MIN_INTERVAL_US / 2;
+		uint16_t uiHigh = MAX_INTERVAL_US / 2;
+		while ( uiLow < uiHigh )
+		{
+			uint16_t uiMid = ( uiLow + uiHigh ) / 2;
+			if ( RunTrial ( uiMid * 2, bSpindle, &ulEdges ) )
+			{
+				uiHigh = uiMid;
+				*pulEdges = ulEdges;
+			}
+			else
+			{
+				uiLow = uiMid + 1;
+			}
+		}
+		uiResult = uiHigh * 2;
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// Finds and prints the shortest interval for one combination
+/// </summary>
+/// <param name="bSpindle">true to also make edges on the spindle pin</param>
+/// <param name="uiSteppers">steppers running</param>
+/// <param name="uiStepus">us between steps, ignored if no steppers</param>
+static void BenchCombination ( bool bSpindle, uint8_t uiSteppers, uint16_t uiStepus )
+{
+	SetSteppers ( uiSteppers, uiStepus );
+	uint32_t ulEdges;
+	uint16_t uiIntervalus = FindShortestInterval ( bSpindle, &ulEdges );
+
+	Serial.print ( F ( "bench,edge_interval_us.pins" ) );
+	Serial.print ( bSpindle ? 2 : 1 );
+	Serial.print ( F ( ".steppers" ) );
+	Serial.print ( uiSteppers );
+	if ( uiSteppers > 0 )
+	{
+		Serial.print ( F ( ".step" ) );
+		Serial.print ( uiStepus );
+		Serial.print ( F ( "us" ) );
+	}
+	Serial.print ( ',' );
+	Serial.print ( ulEdges );
+	for ( uint8_t i = 0; i < 3; i++ )
+	{
+		Serial.print ( ',' );
+		Serial.print ( uiIntervalus );
+	}
+	Serial.println ( F ( ".0" ) );
+
+	Serial.print ( F ( "  every edge counted " ) );
+	if ( uiIntervalus == NO_INTERVAL_US )
+	{
+		Serial.println ( F ( "at no rate tried" ) );
+	}
+	else
+	{
+		Serial.print ( uiIntervalus == MIN_INTERVAL_US ? F ( "at the fastest rate tried, " ) : F ( "up to " ) );
+		Serial.print ( 1000000UL / uiIntervalus );
+		Serial.println ( F ( " falling edges/s per pin" ) );
+	}
+}
+
+void setup ()
+{
+	Serial.begin ( 115200 );
+
+	if ( TheOiler.AddMotor ( RELAY_PIN, DRIP_PIN, DRIPS_TO_STOP ) == false || TheMachine.AddFeatures ( MACHINE_ACTIVE_PIN, SPINDLE_PIN ) == false )
+	{
+		Serial.println ( F ( "Unable to set up oiler, stopped" ) );
+		while ( 1 );
+	}
+	TheOiler.SetMotorSensorDebounce ( 0, 0 );				// every drip is counted
+	TheOiler.On ();
+
+	// Timer1 drives the signal pins, starting LOW
+	TCCR1B = 0;
+	TCCR1A = 0;
+	TIMSK1 = 0;
+	digitalWrite ( DRIP_PIN, LOW );
+	digitalWrite ( SPINDLE_PIN, LOW );
+	pinMode ( DRIP_PIN, OUTPUT );
+	pinMode ( SPINDLE_PIN, OUTPUT );
+
+	for ( uint8_t uiPins = 1; uiPins <= 2; uiPins++ )
+	{
+		BenchCombination ( uiPins == 2, 0, 0 );
+		for ( uint8_t uiSteppers = 1; uiSteppers <= MAX_STEPPERS; uiSteppers++ )
+		{
+			for ( uint8_t i = 0; i < sizeof ( StepIntervals ) / sizeof ( StepIntervals [ 0 ] ); i++ )
+			{
+				BenchCombination ( uiPins == 2, uiSteppers, StepIntervals [ i ] );
+			}
+		}
+	}
+	SetSteppers ( 0, 0 );
+	Serial.println ( F ( "bench done" ) );
+	Serial.flush ();
+
+	// simavr stops when the cpu sleeps with interrupts disabled
+	noInterrupts ();
+	set_sleep_mode ( SLEEP_MODE_PWR_DOWN );
+	sleep_enable ();
+	sleep_cpu ();
+}
+
+void loop ()
+{
+}
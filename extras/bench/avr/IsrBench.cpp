@@ -0,0 +1,348 @@
+// IsrBench.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// Firmware that measures, in cpu cycles on an ATmega328P, the interrupt routines and hot functions of the library. Built by extras/bench/avr
+// and run under simavr by the avr_bench target, see readme.txt. It would run the same on an Uno, the results are sent over Serial.
+//
+// Timer1 counts every cpu cycle. An interrupt is measured by letting it become pending with interrupts disabled and every other interrupt
+// source masked, then reading Timer1 either side of a sei / nop / cli window in which it is taken, less the cycles of the same window with
+// nothing pending. The count therefore includes the jump to the vector, the registers the routine saves and restores and the reti, i.e.
+// all the time the interrupt takes from the sketch. Functions are measured by reading Timer1 either side of the call with interrupts
+// disabled, less the cycles of two back to back reads.
+//
+// Each result is one line, bench,name,samples,min,max,mean, printed once every measurement is done so printing does not disturb them.
+// The firmware then sleeps with interrupts disabled, which ends simavr.
+//
+// The oiler is set up as a typical 3 pump system, two relay motors and a stepper, all moving for the whole run. Drips are made by driving
+// the first relay motor's sensor pin as an output, a pin change interrupt fires when an output pin changes just as for an input.
+//
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "OilerLib.h"
+#include "FourPinStepperMotor.h"
+
+#define RELAY_PIN_1					4
+#define RELAY_PIN_2					5
+#define SENSOR_PIN_1				8					// all sensors on port B, so all are checked by PCINT0_vect
+#define SENSOR_PIN_2				9
+#define STEPPER_SENSOR_PIN			10
+#define STEPPER_PIN_1				14
+#define STEPPER_PIN_2				15
+#define STEPPER_PIN_3				16
+#define STEPPER_PIN_4				17
+#define STEPPER_STEP_US				2000UL
+#define DRIPS_TO_STOP				60000UL				// motors keep moving for the whole run
+#define SAMPLES						64
+#define TIMER_SAMPLES				256					// enough ticks that the stepper steps several times
+
+#define CYCLE_BARRIER()				__asm__ __volatile__ ( "" ::: "memory" )
+
+// cycles taken by Code, interrupts must be disabled
+#define CYCLES_OF(uiCycles, Code)	{ uint16_t uiStart = TCNT1; CYCLE_BARRIER (); Code; CYCLE_BARRIER (); uiCycles = TCNT1 - uiStart - s_uiReadOverhead; }
+
+/// <summary>
+/// min, max and mean of cycle counts of one benchmark
+/// </summary>
+class CycleStatsClass
+{
+public:
+	CycleStatsClass ( const char* pName )
+	{
+		m_pName		= pName;
+		m_uiSamples	= 0;
+		m_uiMin		= 0xFFFF;
+		m_uiMax		= 0;
+		m_ulSum		= 0;
+	}
+
+	void Add ( uint16_t uiCycles )
+	{
+		m_uiMin = uiCycles < m_uiMin ? uiCycles : m_uiMin;
+		m_uiMax = uiCycles > m_uiMax ? uiCycles : m_uiMax;
+		m_ulSum += uiCycles;
+		m_uiSamples++;
+	}
+
+	// bench,name,samples,min,max,mean with the mean to 1 decimal place
+	void Print ( void )
+	{
+		uint32_t ulMean10 = m_uiSamples == 0 ? 0 : ( m_ulSum * 10 + m_uiSamples / 2 ) / m_uiSamples;
+		Serial.print ( F ( "bench," ) );
+		Serial.print ( reinterpret_cast<const __FlashStringHelper*> ( m_pName ) );
+		Serial.print ( ',' );
+		Serial.print ( m_uiSamples );
+		Serial.print ( ',' );
+		Serial.print ( m_uiSamples == 0 ? 0 : m_uiMin );
+		Serial.print ( ',' );
+		Serial.print ( m_uiMax );
+		Serial.print ( ',' );
+		Serial.print ( ulMean10 / 10 );
+		Serial.print ( '.' );
+		Serial.println ( (uint8_t)( ulMean10 % 10 ) );
+	}
+
+protected:
+	const char*					m_pName;			// in flash
+	uint16_t					m_uiSamples;
+	uint16_t					m_uiMin;
+	uint16_t					m_uiMax;
+	uint32_t					m_ulSum;
+};
+
+/// <summary>
+/// Stepper of the oiler, exposes the state machine so its events can be timed without the oiler around them
+/// </summary>
+class BenchStepperMotorClass : public StaticFourPinStepperMotorClass
+{
+public:
+	BenchStepperMotorClass ( void ) : StaticFourPinStepperMotorClass ( STEPPER_PIN_1, STEPPER_PIN_2, STEPPER_PIN_3, STEPPER_PIN_4, STEPPER_SENSOR_PIN, DRIPS_TO_STOP, 0, STEPPER_STEP_US, 0 )
+	{
+	}
+
+	uint8_t BenchProcessEvent ( uint8_t uiEventId, uint32_t ulParam )
+	{
+		return ProcessEvent ( uiEventId, ulParam );
+	}
+
+	void SetOilerMotorState ( eOilerMotorState eState )
+	{
+		m_eOilerState = eState;
+	}
+};
+
+/// <summary>
+/// Drives the stepper's pins, exposes MoveStepper so it can be timed
+/// </summary>
+class BenchStepperDriverClass : public FourPinStepperDriverClass
+{
+public:
+	BenchStepperDriverClass ( MotorClass* pMotor ) : FourPinStepperDriverClass ( STEPPER_PIN_1, STEPPER_PIN_2, STEPPER_PIN_3, STEPPER_PIN_4, STEPPER_STEP_US, pMotor )
+	{
+	}
+
+	using FourPinStepperDriverClass::MoveStepper;
+};
+
+BenchStepperMotorClass BenchStepper;
+
+// names of the benchmarks, in flash. F () is a statement expression so it can only be used inside a function
+const char Timer2EmptyName [] PROGMEM			= "TIMER2_COMPA_vect.no_callbacks";
+const char Timer2OilingName [] PROGMEM			= "TIMER2_COMPA_vect.oiling_3_motors";
+const char PinChangeRisingName [] PROGMEM		= "PCINT0_vect.rising_no_callback";
+const char PinChangeFallingName [] PROGMEM		= "PCINT0_vect.falling_work_seen";
+const char StepperMoveName [] PROGMEM			= "MoveStepper";
+const char ProcessMovingTimerName [] PROGMEM	= "ProcessEvent.MOVING.TIMER";
+const char ProcessMovingWorkName [] PROGMEM		= "ProcessEvent.MOVING.WORK_SEEN";
+const char ProcessIdleTimerName [] PROGMEM		= "ProcessEvent.IDLE.TIMER";
+const char ProcessOffTimerName [] PROGMEM		= "ProcessEvent.OFF.TIMER";
+
+CycleStatsClass Timer2Empty ( Timer2EmptyName );
+CycleStatsClass Timer2Oiling ( Timer2OilingName );
+CycleStatsClass PinChangeRising ( PinChangeRisingName );
+CycleStatsClass PinChangeFalling ( PinChangeFallingName );
+CycleStatsClass StepperMove ( StepperMoveName );
+CycleStatsClass ProcessMovingTimer ( ProcessMovingTimerName );
+CycleStatsClass ProcessMovingWork ( ProcessMovingWorkName );
+CycleStatsClass ProcessIdleTimer ( ProcessIdleTimerName );
+CycleStatsClass ProcessOffTimer ( ProcessOffTimerName );
+
+static uint16_t s_uiReadOverhead;						// cycles of CYCLES_OF with no code
+static uint16_t s_uiWindowOverhead;						// cycles of CyclesOfWindow with no interrupt pending
+static uint8_t s_uiTIMSK0, s_uiTIMSK2, s_uiPCICR;		// interrupt enables while one interrupt is measured on its own
+
+/// <summary>
+/// Cycles of enabling interrupts and disabling them again, a pending interrupt is taken after the nop
+/// </summary>
+/// <returns>cycles including any interrupt taken</returns>
+static uint16_t __attribute__ ( ( noinline ) ) CyclesOfWindow ( void )
+{
+	uint16_t uiStart = TCNT1;
+	sei ();
+	__asm__ __volatile__ ( "nop" );
+	cli ();
+	return TCNT1 - uiStart;
+}
+
+/// <summary>
+/// Disables interrupts and masks all interrupt sources except those given, the USART is idle as results are printed at the end
+/// </summary>
+/// <param name="uiTIMSK2">timer 2 interrupts to leave enabled</param>
+/// <param name="uiPCICR">pin change interrupts to leave enabled</param>
+static void OnlyInterrupts ( uint8_t uiTIMSK2, uint8_t uiPCICR )
+{
+	cli ();
+	s_uiTIMSK0	= TIMSK0;
+	s_uiTIMSK2	= TIMSK2;
+	s_uiPCICR	= PCICR;
+	TIMSK0		= 0;
+	TIMSK2		&= uiTIMSK2;
+	PCICR		&= uiPCICR;
+}
+
+/// <summary>
+/// Restores interrupt sources masked by OnlyInterrupts and enables interrupts, so millis and anything pending catch up
+/// </summary>
+static void AllInterrupts ( void )
+{
+	TIMSK0	= s_uiTIMSK0;
+	TIMSK2	= s_uiTIMSK2;
+	PCICR	= s_uiPCICR;
+	sei ();
+}
+
+/// <summary>
+/// Measures the overheads subtracted from each measurement, the least of several is kept
+/// </summary>
+static void Calibrate ( void )
+{
+	uint16_t uiCycles;
+	s_uiReadOverhead = 0;
+	s_uiWindowOverhead = 0xFFFF;
+	uint16_t uiReadOverhead = 0xFFFF;
+	OnlyInterrupts ( 0, 0 );
+	for ( uint8_t i = 0; i < 8; i++ )
+	{
+		CYCLES_OF ( uiCycles, ; );
+		uiReadOverhead = uiCycles < uiReadOverhead ? uiCycles : uiReadOverhead;
+		uiCycles = CyclesOfWindow ();
+		s_uiWindowOverhead = uiCycles < s_uiWindowOverhead ? uiCycles : s_uiWindowOverhead;
+	}
+	s_uiReadOverhead = uiReadOverhead;
+	AllInterrupts ();
+}
+
+/// <summary>
+/// Measures the timer 2 interrupt, each sample waits for the next compare match. The timer is clocked by the Arduino core's init()
+/// </summary>
+/// <param name="pStats">results</param>
+/// <param name="uiSamples">ticks to measure</param>
+static void BenchTimerInterrupt ( CycleStatsClass* pStats, uint16_t uiSamples )
+{
+	for ( uint16_t i = 0; i < uiSamples; i++ )
+	{
+		OnlyInterrupts ( _BV ( OCIE2A ), 0 );
+		TIFR2 = _BV ( OCF2A );
+		while ( !( TIFR2 & _BV ( OCF2A ) ) );
+		pStats->Add ( CyclesOfWindow () - s_uiWindowOverhead );
+		AllInterrupts ();
+	}
+}
+
+/// <summary>
+/// Measures the port B pin change interrupt for rising edges, which no callback is waiting for, and falling edges, which are drips
+/// </summary>
+/// <param name="pRising">results for rising edges</param>
+/// <param name="pFalling">results for falling edges</param>
+/// <param name="uiSamples">edges of each direction to measure</param>
+static void BenchPinChangeInterrupt ( CycleStatsClass* pRising, CycleStatsClass* pFalling, uint16_t uiSamples )
+{
+	for ( uint16_t i = 0; i < uiSamples; i++ )
+	{
+		OnlyInterrupts ( 0, _BV ( PCIE0 ) );
+		PCIFR = _BV ( PCIF0 );
+		digitalWrite ( SENSOR_PIN_1, HIGH );
+		while ( !( PCIFR & _BV ( PCIF0 ) ) );
+		pRising->Add ( CyclesOfWindow () - s_uiWindowOverhead );
+
+		digitalWrite ( SENSOR_PIN_1, LOW );
+		while ( !( PCIFR & _BV ( PCIF0 ) ) );
+		pFalling->Add ( CyclesOfWindow () - s_uiWindowOverhead );
+		AllInterrupts ();
+	}
+}
+
+/// <summary>
+/// Measures the stepper's state machine for one event in one state, the state is restored afterwards
+/// </summary>
+/// <param name="pStats">results</param>
+/// <param name="eState">state to process event in</param>
+/// <param name="uiEventId">event</param>
+/// <param name="ulParam">value of the start mode metric passed with event</param>
+static void BenchProcessEvent ( CycleStatsClass* pStats, OilerMotorBaseClass::eOilerMotorState eState, uint8_t uiEventId, uint32_t ulParam )
+{
+	uint16_t uiCycles;
+	OilerMotorBaseClass::eOilerMotorState eSavedState = BenchStepper.GetOilerMotorState ();
+	noInterrupts ();
+	BenchStepper.SetOilerMotorState ( eState );
+	for ( uint16_t i = 0; i < SAMPLES; i++ )
+	{
+		CYCLES_OF ( uiCycles, BenchStepper.BenchProcessEvent ( uiEventId, ulParam ) );
+		pStats->Add ( uiCycles );
+	}
+	BenchStepper.SetOilerMotorState ( eSavedState );
+	interrupts ();
+}
+
+void setup ()
+{
+	Serial.begin ( 115200 );
+
+	// Timer1 counts cpu cycles
+	TCCR1A = 0;
+	TCCR1B = _BV ( CS10 );
+	TIMSK1 = 0;
+	Calibrate ();
+
+	// nothing has added a timer callback yet
+	BenchTimerInterrupt ( &Timer2Empty, SAMPLES );
+
+	if ( TheOiler.AddMotor ( RELAY_PIN_1, SENSOR_PIN_1, DRIPS_TO_STOP ) == false || TheOiler.AddMotor ( RELAY_PIN_2, SENSOR_PIN_2, DRIPS_TO_STOP ) == false ||
+		TheOiler.AddMotor ( &BenchStepper ) == false )
+	{
+		Serial.println ( F ( "Unable to set up oiler, stopped" ) );
+		while ( 1 );
+	}
+	TheOiler.SetMotorSensorDebounce ( 0, 0 );				// every drip is processed
+	TheOiler.On ();
+
+	BenchTimerInterrupt ( &Timer2Oiling, TIMER_SAMPLES );
+
+	pinMode ( SENSOR_PIN_1, OUTPUT );
+	digitalWrite ( SENSOR_PIN_1, LOW );
+	BenchPinChangeInterrupt ( &PinChangeRising, &PinChangeFalling, SAMPLES );
+
+	BenchProcessEvent ( &ProcessMovingTimer, OilerMotorBaseClass::MOVING, OilerMotorBaseClass::TIMER, millis () );
+	BenchProcessEvent ( &ProcessMovingWork, OilerMotorBaseClass::MOVING, OilerMotorBaseClass::WORK_SEEN, millis () );
+	BenchProcessEvent ( &ProcessIdleTimer, OilerMotorBaseClass::IDLE, OilerMotorBaseClass::TIMER, BenchStepper.GetModeMetricAtStart () );
+	BenchProcessEvent ( &ProcessOffTimer, OilerMotorBaseClass::OFF, OilerMotorBaseClass::TIMER, millis () );
+
+	// the driver joins the list of steppers the timer callback steps until it goes out of scope, so interrupts are disabled whilst it exists
+	noInterrupts ();
+	{
+		BenchStepperDriverClass Driver ( &BenchStepper );
+		uint16_t uiCycles;
+		for ( uint16_t i = 0; i < SAMPLES; i++ )
+		{
+			CYCLES_OF ( uiCycles, Driver.MoveStepper ( i % NUM_PHASES ) );
+			StepperMove.Add ( uiCycles );
+		}
+	}
+
+	// print with only the USART interrupt enabled
+	TIMSK0 = 0;
+	TIMSK2 = 0;
+	PCICR = 0;
+	interrupts ();
+	Timer2Empty.Print ();
+	Timer2Oiling.Print ();
+	PinChangeRising.Print ();
+	PinChangeFalling.Print ();
+	StepperMove.Print ();
+	ProcessMovingTimer.Print ();
+	ProcessMovingWork.Print ();
+	ProcessIdleTimer.Print ();
+	ProcessOffTimer.Print ();
+	Serial.println ( F ( "bench done" ) );
+	Serial.flush ();
+
+	// simavr stops when the cpu sleeps with interrupts disabled
+	noInterrupts ();
+	set_sleep_mode ( SLEEP_MODE_PWR_DOWN );
+	sleep_enable ();
+	sleep_cpu ();
+}
+
+void loop ()
+{
+}
@@ -0,0 +1,269 @@
+// HostBench.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// oiler_host_bench, microbenchmarks of the functions the library runs in its interrupts, built against the simulated Uno in extras/host so
+// changes to dispatch and scheduling can be compared in seconds without a board. Times are of the host cpu, use them to compare two
+// versions of the library on the same machine, extras/bench/avr gives cycle counts on the ATmega328P itself.
+//
+//	oiler_host_bench [--benchmark_filter=ProcessTimerEvent]
+//
+// Built only if CMake finds Google Benchmark.
+// Benchmarks taking a number of motors run an oiler of that many relay motors, all moving. Each oiler's drip sensors are inputs of its own
+// on the input expander, except those of the oiler used to time pin change dispatch, which are on port C. Virtual time does not pass whilst
+// a benchmark runs, so the oiler and timer do the checks they do on every interrupt with nothing falling due.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <benchmark/benchmark.h>
+#include "OilerLib.h"
+#include "InputExpander.h"
+#include "HostSim.h"
+
+#define BENCH_FIRST_RELAY_PIN		2				// relays on pins 2 - 7, shared by all oilers
+#define BENCH_RELAY_PINS			6
+#define BENCH_FIRST_SENSOR_PIN		14				// drip sensors of the pin change oiler on pins 14 - 19 (A0 - A5), all on port C
+#define BENCH_PORT_SENSORS			6
+#define BENCH_EXPANDER_LOAD_PIN		8				// input expander on the SPI pins 10 - 13
+#define BENCH_DRIPS_TO_STOP			0xFFFFFFFFUL	// motors keep moving whilst benchmarks run
+
+/// <summary>
+/// Largest oiler that can be timed, oilers of 1 - n motors together need n * ( n + 1 ) / 2 expander inputs with callbacks
+/// </summary>
+static constexpr uint8_t BenchMaxMotors ( uint8_t uiMotors )
+{
+	return uiMotors * ( uiMotors + 1 ) / 2 <= MAX_INPUT_EXPANDER_PINS ? uiMotors : BenchMaxMotors ( uiMotors - 1 );
+}
+
+#define BENCH_MAX_MOTORS			BenchMaxMotors ( OILER_MAX_MOTORS )
+
+/// <summary>
+/// Relay motor on its own, exposes the state machine so its events can be timed without the oiler around them
+/// </summary>
+class BenchRelayMotorClass : public StaticRelayMotorClass
+{
+public:
+	BenchRelayMotorClass ( void ) : StaticRelayMotorClass ( BENCH_FIRST_RELAY_PIN, NOT_A_PIN, BENCH_DRIPS_TO_STOP, 0, 0 )
+	{
+	}
+
+	uint8_t BenchProcessEvent ( uint8_t uiEventId, uint32_t ulParam )
+	{
+		return ProcessEvent ( uiEventId, ulParam );
+	}
+
+	void SetOilerMotorState ( eOilerMotorState eState )
+	{
+		m_eOilerState = eState;
+	}
+};
+
+/// <summary>
+/// Adds relay motors to an oiler and turns it on, stops the benchmarks if a motor cannot be added
+/// </summary>
+/// <param name="pOiler">oiler to set up</param>
+/// <param name="uiMotors">number of motors</param>
+/// <param name="pSensorPin">gets the drip sensor pin of each motor</param>
+static void MakeOiler ( OilerClass* pOiler, uint8_t uiMotors, uint8_t ( *pSensorPin )( uint8_t uiMotors, uint8_t uiMotor ) )
+{
+	for ( uint8_t i = 0; i < uiMotors; i++ )
+	{
+		if ( !pOiler->AddMotor ( BENCH_FIRST_RELAY_PIN + i % BENCH_RELAY_PINS, pSensorPin ( uiMotors, i ), BENCH_DRIPS_TO_STOP ) )
+		{
+			fprintf ( stderr, "unable to add motor %u of oiler of %u motors\n", i, uiMotors );
+			exit ( 1 );
+		}
+		pOiler->SetMotorSensorDebounce ( i, 0 );
+	}
+	pOiler->On ();
+}
+
+static uint8_t PortSensorPin ( uint8_t uiMotors, uint8_t uiMotor )
+{
+	return BENCH_FIRST_SENSOR_PIN + uiMotor;
+}
+
+static uint8_t ExpanderSensorPin ( uint8_t uiMotors, uint8_t uiMotor )
+{
+	// oilers of fewer motors have the inputs before
+	return EXPANDER_INPUT ( uiMotors * ( uiMotors - 1 ) / 2 + uiMotor );
+}
+
+/// <summary>
+/// Oiler of BENCH_PORT_SENSORS motors whose drip sensors are on port C, made and turned on the first time it is asked for
+/// </summary>
+static OilerClass* GetPortOiler ( void )
+{
+	static OilerGroupClass<BENCH_PORT_SENSORS> Oiler;
+	static bool bMade = false;
+	if ( !bMade )
+	{
+		MakeOiler ( &Oiler, BENCH_PORT_SENSORS, PortSensorPin );
+		bMade = true;
+	}
+	return &Oiler;
+}
+
+/// <summary>
+/// Starts the input expander the first time it is called, with enough registers for MAX_INPUT_EXPANDER_PINS inputs
+/// </summary>
+static void StartExpander ( void )
+{
+	static bool bStarted = false;
+	if ( !bStarted )
+	{
+		if ( !TheInputExpander.Begin ( BENCH_EXPANDER_LOAD_PIN, ( MAX_INPUT_EXPANDER_PINS + 7 ) / 8 ) )
+		{
+			fprintf ( stderr, "unable to start input expander\n" );
+			exit ( 1 );
+		}
+		bStarted = true;
+	}
+}
+
+/// <summary>
+/// Oiler of uiMotors motors with drip sensors on the input expander, made and turned on the first time it is asked for
+/// </summary>
+template <uint8_t uiMotors>
+static OilerClass* GetExpanderOiler ( void )
+{
+	static OilerGroupClass<uiMotors> Oiler;
+	static bool bMade = false;
+	if ( !bMade )
+	{
+		StartExpander ();
+		MakeOiler ( &Oiler, uiMotors, ExpanderSensorPin );
+		bMade = true;
+	}
+	return &Oiler;
+}
+
+/// <summary>
+/// Oiler of the given number of motors, one of those of 1 - uiMaxMotors motors
+/// </summary>
+/// <param name="llMotors">1 - uiMaxMotors</param>
+/// <returns>oiler, NULL if llMotors is out of range</returns>
+template <uint8_t uiMaxMotors>
+static OilerClass* GetOiler ( int64_t llMotors )
+{
+	return llMotors == uiMaxMotors ? GetExpanderOiler<uiMaxMotors> () : GetOiler<uiMaxMotors - 1> ( llMotors );
+}
+
+template <>
+OilerClass* GetOiler<0> ( int64_t llMotors )
+{
+	return NULL;
+}
+
+/// <summary>
+/// Times the state machine of a motor for one event in one state
+/// </summary>
+static void ProcessEvent ( benchmark::State& state, OilerMotorBaseClass::eOilerMotorState eState, OilerMotorBaseClass::eOilerMotorEvents eEvent )
+{
+	static BenchRelayMotorClass Motor;
+	Motor.SetOilerMotorState ( eState );
+	uint32_t ulParam = eState == OilerMotorBaseClass::IDLE ? Motor.GetModeMetricAtStart () : millis ();
+	for ( auto _ : state )
+	{
+		benchmark::DoNotOptimize ( Motor.BenchProcessEvent ( eEvent, ulParam ) );
+	}
+	Motor.SetOilerMotorState ( OilerMotorBaseClass::OFF );
+}
+
+static void BM_ProcessEvent_Moving_Timer ( benchmark::State& state )
+{
+	ProcessEvent ( state, OilerMotorBaseClass::MOVING, OilerMotorBaseClass::TIMER );
+}
+BENCHMARK ( BM_ProcessEvent_Moving_Timer );
+
+static void BM_ProcessEvent_Moving_WorkSeen ( benchmark::State& state )
+{
+	ProcessEvent ( state, OilerMotorBaseClass::MOVING, OilerMotorBaseClass::WORK_SEEN );
+}
+BENCHMARK ( BM_ProcessEvent_Moving_WorkSeen );
+
+static void BM_ProcessEvent_Idle_Timer ( benchmark::State& state )
+{
+	ProcessEvent ( state, OilerMotorBaseClass::IDLE, OilerMotorBaseClass::TIMER );
+}
+BENCHMARK ( BM_ProcessEvent_Idle_Timer );
+
+static void BM_ProcessEvent_Off_Timer ( benchmark::State& state )
+{
+	ProcessEvent ( state, OilerMotorBaseClass::OFF, OilerMotorBaseClass::TIMER );
+}
+BENCHMARK ( BM_ProcessEvent_Off_Timer );
+
+/// <summary>
+/// Times the pin change dispatch with the given number of drip sensors changing at once, alternately rising, which no callback waits for,
+/// and falling, which are drips processed by their motors
+/// </summary>
+static void BM_InvokeCallback ( benchmark::State& state )
+{
+	GetPortOiler ();
+	uint8_t uiPort = digitalPinToPort ( BENCH_FIRST_SENSOR_PIN );
+	uint8_t uiMask = 0;
+	for ( int64_t i = 0; i < state.range ( 0 ); i++ )
+	{
+		uiMask |= digitalPinToBitMask ( BENCH_FIRST_SENSOR_PIN + i );
+	}
+	uint8_t uiLevels = 0;
+	for ( auto _ : state )
+	{
+		uiLevels ^= uiMask;
+		PCIHandlerClass::InvokeCallback ( uiMask, uiLevels, uiPort );
+	}
+}
+BENCHMARK ( BM_InvokeCallback )->DenseRange ( 1, BENCH_PORT_SENSORS );
+
+static void CountTick ( void* pContext )
+{
+	( *(uint32_t*)pContext )++;
+}
+
+/// <summary>
+/// Times the body of the timer 2 interrupt with the given number of callbacks, due every 10, 20, 30 ... ticks so most ticks only count down
+/// </summary>
+static void BM_TimerTick ( benchmark::State& state )
+{
+	static uint32_t ulCounts [ MAX_CALLBACKS ];
+	TimerClass Timer;
+	for ( int64_t i = 0; i < state.range ( 0 ); i++ )
+	{
+		Timer.AddCallBack ( CountTick, &ulCounts [ i ], 10 * ( i + 1 ) );
+	}
+	for ( auto _ : state )
+	{
+		Timer.Tick ();
+	}
+	benchmark::DoNotOptimize ( ulCounts );
+}
+BENCHMARK ( BM_TimerTick )->DenseRange ( 1, MAX_CALLBACKS );
+
+/// <summary>
+/// Times the deadline check the oiler makes when its timer is due
+/// </summary>
+static void BM_ProcessTimerEvent ( benchmark::State& state )
+{
+	OilerClass* pOiler = GetOiler<BENCH_MAX_MOTORS> ( state.range ( 0 ) );
+	for ( auto _ : state )
+	{
+		pOiler->ProcessTimerEvent ();
+	}
+}
+BENCHMARK ( BM_ProcessTimerEvent )->DenseRange ( 1, BENCH_MAX_MOTORS );
+
+/// <summary>
+/// Times the check of whether all motors have stopped made after a motor changes state
+/// </summary>
+static void BM_CheckMotors ( benchmark::State& state )
+{
+	OilerClass* pOiler = GetOiler<BENCH_MAX_MOTORS> ( state.range ( 0 ) );
+	for ( auto _ : state )
+	{
+		pOiler->CheckMotors ();
+	}
+}
+BENCHMARK ( BM_CheckMotors )->DenseRange ( 1, BENCH_MAX_MOTORS );
+
+BENCHMARK_MAIN ();
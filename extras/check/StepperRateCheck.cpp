@@ -0,0 +1,65 @@
+// StepperRateCheck.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// oiler_stepper_rate_check, checks on the simulated Uno that a stepper's drive level sets its step rate. A stepper configured to step every
+// CHECK_STEP_US runs for a second at each level and the changes of its first coil pin are counted, at DRIVE_LEVEL_NOMINAL it must step at the
+// configured rate and other levels must scale the rate by level / DRIVE_LEVEL_NOMINAL, so DRIVE_LEVEL_MAX about doubles it.
+//
+//	oiler_stepper_rate_check
+//
+// Prints the pin changes counted at each level. Exits 0 if every rate is within CHECK_TOLERANCE_PCT of that expected, else 1. Run by ctest.
+//
+#include <stdio.h>
+#include <OilerLib.h>
+#include <FourPinStepperMotor.h>
+#include "HostSim.h"
+
+#define CHECK_FIRST_PIN			2				// coils on pins 2 - 5
+#define CHECK_STEP_US			2000			// step interval at DRIVE_LEVEL_NOMINAL
+#define CHECK_RUN_MS			1000
+#define CHECK_TOLERANCE_PCT		5
+
+// the first coil is HIGH for 3 of the NUM_PHASES half steps, so it changes twice every NUM_PHASES steps
+#define CHECK_CHANGES_PER_CYCLE	2
+
+StaticFourPinStepperMotorClass Stepper ( CHECK_FIRST_PIN, CHECK_FIRST_PIN + 1, CHECK_FIRST_PIN + 2, CHECK_FIRST_PIN + 3, NOT_A_PIN, 0xFFFFFFFFUL, 0, CHECK_STEP_US, 0 );
+
+static uint32_t ulPinChanges = 0;
+
+static void CountPinChange ( uint8_t uiPin, uint8_t uiLevel )
+{
+	if ( uiPin == CHECK_FIRST_PIN )
+	{
+		ulPinChanges++;
+	}
+}
+
+/// <summary>
+/// Runs the stepper at a drive level and compares the changes of its first coil pin with those expected
+/// </summary>
+/// <param name="uiLevel">drive level</param>
+/// <returns>true if within CHECK_TOLERANCE_PCT</returns>
+static bool CheckLevel ( uint8_t uiLevel )
+{
+	Stepper.SetDriveLevel ( uiLevel );
+	Stepper.On ();
+	ulPinChanges = 0;
+	HostSim.Advance ( CHECK_RUN_MS * 1000UL );
+	Stepper.Off ();
+
+	uint32_t ulExpected = (uint32_t)( (uint64_t)CHECK_RUN_MS * 1000UL * uiLevel * CHECK_CHANGES_PER_CYCLE / ( (uint64_t)CHECK_STEP_US * DRIVE_LEVEL_NOMINAL * NUM_PHASES ) );
+	uint32_t ulDiff = ulPinChanges > ulExpected ? ulPinChanges - ulExpected : ulExpected - ulPinChanges;
+	bool bResult = ulDiff * 100 <= ulExpected * CHECK_TOLERANCE_PCT;
+	printf ( "level %3u: %5lu pin changes/s, expected %5lu %s\n", uiLevel, (unsigned long)ulPinChanges, (unsigned long)ulExpected, bResult ? "ok" : "FAILED" );
+	return bResult;
+}
+
+int main ( void )
+{
+	HostSim.SetPinWriteWatch ( CountPinChange );
+	bool bResult = CheckLevel ( DRIVE_LEVEL_NOMINAL );
+	bResult = CheckLevel ( DRIVE_LEVEL_MAX ) && bResult;
+	bResult = CheckLevel ( DRIVE_LEVEL_NOMINAL / 2 ) && bResult;
+	return bResult ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Arduino.h
+//
+// (c) 2021 Mark Naylor
+//
+// Host (Linux) replacement for the Arduino core header so the library in src can be built and run as a native library. Only what the library uses is
+// provided: digital pins of an Uno, millis / micros from a simulated clock, and the Uno registers used by TimerClass, PCIHandlerClass and the expanders.
+// The simulated hardware is driven by HostSim, see HostSim.h.
+//
+#ifndef _HOST_ARDUINO_h
+#define _HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HIGH				1
+#define LOW					0
+
+#define INPUT				0
+#define OUTPUT				1
+#define INPUT_PULLUP		2
+
+#define CHANGE				1
+#define FALLING				2
+#define RISING				3
+
+#define NOT_A_PIN			0
+#define NUM_DIGITAL_PINS	20
+
+#define SS					10
+#define MOSI				11
+#define MISO				12
+#define SCK					13
+
+#define F(x)				x
+#define _BV(b)				( 1 << ( b ) )
+
+// interrupt routines are plain functions called by HostSim when the simulated hardware raises the interrupt
+#define ISR(vector)			extern "C" void vector ( void )
+
+// status register, only the global interrupt enable bit is simulated. Writing it, as done to restore interrupts after a critical section,
+// runs any interrupt raised whilst interrupts were disabled
+#define SREG_I				7
+
+class HostSregClass
+{
+public:
+	operator uint8_t () const	{ return m_uiValue; }
+	HostSregClass& operator= ( uint8_t uiValue );
+
+	uint8_t		m_uiValue;
+};
+
+extern HostSregClass SREG;
+
+// timer 2
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2;
+#define WGM21				1
+#define CS20				0
+#define CS21				1
+#define CS22				2
+#define OCIE2A				1
+#define OCF2A				1
+
+// timers driving the PWM pins, as numbered by the Arduino core
+#define NOT_ON_TIMER		0
+#define TIMER0A				1
+#define TIMER0B				2
+#define TIMER1A				3
+#define TIMER1B				4
+#define TIMER2A				7
+#define TIMER2B				8
+
+// pin change interrupts
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+#define PCIE0				0
+#define PCIE1				1
+#define PCIE2				2
+
+// ports, Arduino numbers them B = 2, C = 3, D = 4
+extern volatile uint8_t PINB, PINC, PIND, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+
+// SPI, transfers complete at once so SPIF always reads as set
+extern volatile uint8_t SPCR, SPSR, SPDR;
+#define SPR0				0
+#define SPR1				1
+#define CPHA				2
+#define CPOL				3
+#define MSTR				4
+#define DORD				5
+#define SPE					6
+#define SPIE				7
+#define SPI2X				0
+#define SPIF				7
+
+// output stream as used by Serial, derive to write elsewhere e.g. a file
+class Print
+{
+public:
+	virtual size_t		write ( uint8_t uiByte ) = 0;
+	virtual size_t		write ( const uint8_t* pBuffer, size_t Size )
+	{
+		size_t Written = 0;
+		while ( Written < Size && write ( pBuffer [ Written ] ) == 1 )
+		{
+			Written++;
+		}
+		return Written;
+	}
+};
+
+void				pinMode ( uint8_t uiPin, uint8_t uiMode );
+void				digitalWrite ( uint8_t uiPin, uint8_t uiLevel );
+int					digitalRead ( uint8_t uiPin );
+void				analogWrite ( uint8_t uiPin, int iValue );
+unsigned long		millis ( void );
+unsigned long		micros ( void );
+void				delay ( unsigned long ulms );
+void				delayMicroseconds ( unsigned int uius );
+void				noInterrupts ( void );
+void				interrupts ( void );
+void				cli ( void );
+void				sei ( void );
+
+uint8_t				digitalPinToPort ( uint8_t uiPin );
+uint8_t				digitalPinToBitMask ( uint8_t uiPin );
+volatile uint8_t*	portInputRegister ( uint8_t uiPort );
+volatile uint8_t*	portOutputRegister ( uint8_t uiPort );
+volatile uint8_t*	portModeRegister ( uint8_t uiPort );
+volatile uint8_t*	digitalPinToPCICR ( uint8_t uiPin );
+uint8_t				digitalPinToPCICRbit ( uint8_t uiPin );
+volatile uint8_t*	digitalPinToPCMSK ( uint8_t uiPin );
+uint8_t				digitalPinToPCMSKbit ( uint8_t uiPin );
+bool				digitalPinHasPWM ( uint8_t uiPin );
+uint8_t				digitalPinToTimer ( uint8_t uiPin );
+
+#endif
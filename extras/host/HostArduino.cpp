@@ -0,0 +1,410 @@
+// HostArduino.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements the host Arduino functions and the simulated Uno they run on
+//
+#include "HostSim.h"
+
+// interrupt routines of the library, defaults do nothing if the library part that handles them is not linked
+extern "C" void __attribute__ ( ( weak ) ) TIMER2_COMPA_vect ( void ) {}
+extern "C" void __attribute__ ( ( weak ) ) PCINT0_vect ( void ) {}
+extern "C" void __attribute__ ( ( weak ) ) PCINT1_vect ( void ) {}
+extern "C" void __attribute__ ( ( weak ) ) PCINT2_vect ( void ) {}
+
+HostSregClass SREG = { _BV ( SREG_I ) };			// Arduino core enables interrupts before setup ()
+
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, TIMSK2, TIFR2;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t PINB, PINC, PIND, PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+volatile uint8_t SPCR, SPSR = _BV ( SPIF ), SPDR;
+
+HostSimClass HostSim;
+
+/// <summary>
+/// Sets the status register, if this enables interrupts any that were raised whilst they were disabled are run
+/// </summary>
+/// <param name="uiValue">new value</param>
+/// <returns>register</returns>
+HostSregClass& HostSregClass::operator= ( uint8_t uiValue )
+{
+	m_uiValue = uiValue;
+	if ( uiValue & _BV ( SREG_I ) )
+	{
+		HostSim.RunPendingInterrupts ();
+	}
+	return *this;
+}
+
+// Uno pin mapping, pins 0 - 7 are port D, 8 - 13 port B and 14 - 19 (A0 - A5) port C
+uint8_t digitalPinToPort ( uint8_t uiPin )
+{
+	return uiPin < 8 ? 4 : uiPin < 14 ? 2 : uiPin < NUM_DIGITAL_PINS ? 3 : NOT_A_PIN;
+}
+
+uint8_t digitalPinToBitMask ( uint8_t uiPin )
+{
+	return uiPin < 8 ? _BV ( uiPin ) : uiPin < 14 ? _BV ( uiPin - 8 ) : _BV ( ( uiPin - 14 ) & 7 );
+}
+
+volatile uint8_t* portInputRegister ( uint8_t uiPort )
+{
+	return uiPort == 2 ? &PINB : uiPort == 3 ? &PINC : uiPort == 4 ? &PIND : NULL;
+}
+
+volatile uint8_t* portOutputRegister ( uint8_t uiPort )
+{
+	return uiPort == 2 ? &PORTB : uiPort == 3 ? &PORTC : uiPort == 4 ? &PORTD : NULL;
+}
+
+volatile uint8_t* portModeRegister ( uint8_t uiPort )
+{
+	return uiPort == 2 ? &DDRB : uiPort == 3 ? &DDRC : uiPort == 4 ? &DDRD : NULL;
+}
+
+volatile uint8_t* digitalPinToPCICR ( uint8_t uiPin )
+{
+	return uiPin < NUM_DIGITAL_PINS ? &PCICR : NULL;
+}
+
+uint8_t digitalPinToPCICRbit ( uint8_t uiPin )
+{
+	return uiPin < 8 ? PCIE2 : uiPin < 14 ? PCIE0 : PCIE1;
+}
+
+volatile uint8_t* digitalPinToPCMSK ( uint8_t uiPin )
+{
+	return uiPin < 8 ? &PCMSK2 : uiPin < 14 ? &PCMSK0 : uiPin < NUM_DIGITAL_PINS ? &PCMSK1 : NULL;
+}
+
+uint8_t digitalPinToPCMSKbit ( uint8_t uiPin )
+{
+	return uiPin < 8 ? uiPin : uiPin < 14 ? uiPin - 8 : uiPin - 14;
+}
+
+bool digitalPinHasPWM ( uint8_t uiPin )
+{
+	return uiPin == 3 || uiPin == 5 || uiPin == 6 || uiPin == 9 || uiPin == 10 || uiPin == 11;
+}
+
+uint8_t digitalPinToTimer ( uint8_t uiPin )
+{
+	switch ( uiPin )
+	{
+	case 3:		return TIMER2B;
+	case 5:		return TIMER0B;
+	case 6:		return TIMER0A;
+	case 9:		return TIMER1A;
+	case 10:	return TIMER1B;
+	case 11:	return TIMER2A;
+	default:	return NOT_ON_TIMER;
+	}
+}
+
+void pinMode ( uint8_t uiPin, uint8_t uiMode )
+{
+	HostSim.SetPinMode ( uiPin, uiMode );
+}
+
+void digitalWrite ( uint8_t uiPin, uint8_t uiLevel )
+{
+	HostSim.WritePin ( uiPin, uiLevel );
+}
+
+int digitalRead ( uint8_t uiPin )
+{
+	return HostSim.GetPin ( uiPin );
+}
+
+void analogWrite ( uint8_t uiPin, int iValue )
+{
+	HostSim.SetAnalogWrite ( uiPin, iValue );
+}
+
+unsigned long millis ( void )
+{
+	return (unsigned long)( (uint32_t)( HostSim.GetMicros () / 1000ULL ) );
+}
+
+unsigned long micros ( void )
+{
+	return (unsigned long)( (uint32_t)HostSim.GetMicros () );
+}
+
+void delay ( unsigned long ulms )
+{
+	HostSim.Advance ( ulms * 1000UL );
+}
+
+void delayMicroseconds ( unsigned int uius )
+{
+	HostSim.Advance ( uius );
+}
+
+void noInterrupts ( void )
+{
+	SREG = SREG & ~_BV ( SREG_I );
+}
+
+void interrupts ( void )
+{
+	SREG = SREG | _BV ( SREG_I );
+}
+
+void cli ( void )
+{
+	noInterrupts ();
+}
+
+void sei ( void )
+{
+	interrupts ();
+}
+
+/// <summary>
+/// Lets time pass, timer 2 interrupts are raised each time one falls due so the library sees time pass tick by tick
+/// </summary>
+/// <param name="ulMicros">micros to pass</param>
+void HostSimClass::Advance ( uint32_t ulMicros )
+{
+	AdvanceTo ( m_ullMicros + ulMicros );
+}
+
+/// <summary>
+/// Lets time pass until the given time, does nothing if already past it
+/// </summary>
+/// <param name="ullMicros">micros since start</param>
+void HostSimClass::AdvanceTo ( uint64_t ullMicros )
+{
+	const uint64_t ullPeriod = 1000000ULL / HOST_TIMER2_HZ;
+	GetNextTickMicros ();
+	while ( m_ullNextTimer2 <= ullMicros )
+	{
+		uint64_t ullSkip = 0;
+		if ( m_pfnTicksDue != NULL && ( TIMSK2 & _BV ( OCIE2A ) ) && ( SREG & _BV ( SREG_I ) ) && !m_bInInterrupt )
+		{
+			// ticks before the next one with a callback due do nothing but count down, so do them in one go
+			uint64_t ullTicks	= ( ullMicros - m_ullNextTimer2 ) / ullPeriod + 1;
+			uint32_t ulDue		= m_pfnTicksDue ();
+			ullSkip = ulDue == 0 ? ullTicks : ulDue - 1 < ullTicks ? ulDue - 1 : ullTicks;
+			if ( ullSkip > 0xFFFFFFFFULL )
+			{
+				ullSkip = 0xFFFFFFFFULL;
+			}
+		}
+		if ( ullSkip > 0 )
+		{
+			m_pfnSkipTicks ( (uint32_t)ullSkip );
+			m_ullSkippedTicks	+= ullSkip;
+			m_ullMicros			= m_ullNextTimer2 + ( ullSkip - 1 ) * ullPeriod;
+			m_ullNextTimer2		+= ullSkip * ullPeriod;
+		}
+		else
+		{
+			m_ullMicros		= m_ullNextTimer2;
+			m_ullNextTimer2	+= ullPeriod;
+			if ( TIMSK2 & _BV ( OCIE2A ) )
+			{
+				TIFR2 |= _BV ( OCF2A );
+				RunPendingInterrupts ();
+			}
+		}
+	}
+	if ( ullMicros > m_ullMicros )
+	{
+		m_ullMicros = ullMicros;
+	}
+}
+
+uint64_t HostSimClass::GetMicros ( void )
+{
+	return m_ullMicros;
+}
+
+uint64_t HostSimClass::GetNextTickMicros ( void )
+{
+	const uint64_t ullPeriod = 1000000ULL / HOST_TIMER2_HZ;
+	if ( m_ullNextTimer2 <= m_ullMicros )
+	{
+		m_ullNextTimer2 = ( m_ullMicros / ullPeriod + 1 ) * ullPeriod;
+	}
+	return m_ullNextTimer2;
+}
+
+/// <summary>
+/// Drives an input pin, if its level changes and its pin change interrupt is enabled the interrupt is raised
+/// </summary>
+/// <param name="uiPin">digital pin</param>
+/// <param name="uiLevel">HIGH or LOW</param>
+void HostSimClass::SetPin ( uint8_t uiPin, uint8_t uiLevel )
+{
+	volatile uint8_t* pPort = portInputRegister ( digitalPinToPort ( uiPin ) );
+	if ( pPort != NULL )
+	{
+		uint8_t uiMask	= digitalPinToBitMask ( uiPin );
+		uint8_t uiOld	= *pPort;
+		*pPort = uiLevel == LOW ? uiOld & ~uiMask : uiOld | uiMask;
+		if ( *pPort != uiOld )
+		{
+			RaisePinChange ( uiPin );
+		}
+	}
+}
+
+/// <summary>
+/// Gets the level of a pin, an output reads back the level written to it
+/// </summary>
+/// <param name="uiPin">digital pin</param>
+/// <returns>HIGH or LOW</returns>
+uint8_t HostSimClass::GetPin ( uint8_t uiPin )
+{
+	uint8_t uiResult = LOW;
+	uint8_t uiPort = digitalPinToPort ( uiPin );
+	if ( uiPort != NOT_A_PIN )
+	{
+		volatile uint8_t* pPort = m_uiPinMode [ uiPin ] == OUTPUT ? portOutputRegister ( uiPort ) : portInputRegister ( uiPort );
+		uiResult = ( *pPort & digitalPinToBitMask ( uiPin ) ) ? HIGH : LOW;
+	}
+	return uiResult;
+}
+
+uint8_t HostSimClass::GetPinMode ( uint8_t uiPin )
+{
+	return uiPin < NUM_DIGITAL_PINS ? m_uiPinMode [ uiPin ] : INPUT;
+}
+
+/// <summary>
+/// Sets the mode of a pin, a pulled up input reads HIGH until driven LOW
+/// </summary>
+/// <param name="uiPin">digital pin</param>
+/// <param name="uiMode">INPUT, OUTPUT or INPUT_PULLUP</param>
+void HostSimClass::SetPinMode ( uint8_t uiPin, uint8_t uiMode )
+{
+	if ( uiPin < NUM_DIGITAL_PINS )
+	{
+		bool bWasPullup = m_uiPinMode [ uiPin ] == INPUT_PULLUP;
+		m_uiPinMode [ uiPin ] = uiMode;
+		if ( uiMode == INPUT_PULLUP && !bWasPullup )
+		{
+			SetPin ( uiPin, HIGH );
+		}
+	}
+}
+
+int HostSimClass::GetAnalogWrite ( uint8_t uiPin )
+{
+	return uiPin < NUM_DIGITAL_PINS ? m_iAnalog [ uiPin ] : 0;
+}
+
+void HostSimClass::SetAnalogWrite ( uint8_t uiPin, int iValue )
+{
+	if ( uiPin < NUM_DIGITAL_PINS )
+	{
+		m_iAnalog [ uiPin ] = iValue;
+	}
+}
+
+uint32_t HostSimClass::GetTimerInterrupts ( void )
+{
+	return m_ulTimerInterrupts;
+}
+
+uint32_t HostSimClass::GetPinChangeInterrupts ( void )
+{
+	return m_ulPinChangeInterrupts;
+}
+
+uint64_t HostSimClass::GetSkippedTicks ( void )
+{
+	return m_ullSkippedTicks;
+}
+
+/// <summary>
+/// Lets Advance skip timer ticks in which nothing is due, e.g. pass TimerClass GetTicksToNextCallback and SkipTicks of TheTimer
+/// </summary>
+/// <param name="pfnTicksDue">gets ticks until a callback is due, 0 if none</param>
+/// <param name="pfnSkip">counts down ticks in one go</param>
+void HostSimClass::SetTickSkip ( HostTicksDueFn pfnTicksDue, HostSkipTicksFn pfnSkip )
+{
+	m_pfnTicksDue	= pfnSkip != NULL ? pfnTicksDue : NULL;
+	m_pfnSkipTicks	= pfnSkip;
+}
+
+void HostSimClass::SetPinWriteWatch ( HostPinWriteFn pfnWatch )
+{
+	m_pfnPinWriteWatch = pfnWatch;
+}
+
+/// <summary>
+/// Writes an output pin, the watch set by SetPinWriteWatch is called if its level changes
+/// </summary>
+/// <param name="uiPin">digital pin</param>
+/// <param name="uiLevel">HIGH or LOW</param>
+void HostSimClass::WritePin ( uint8_t uiPin, uint8_t uiLevel )
+{
+	volatile uint8_t* pPort = portOutputRegister ( digitalPinToPort ( uiPin ) );
+	if ( pPort != NULL )
+	{
+		uint8_t uiMask	= digitalPinToBitMask ( uiPin );
+		uint8_t uiOld	= *pPort;
+		*pPort = uiLevel == LOW ? uiOld & ~uiMask : uiOld | uiMask;
+		if ( *pPort != uiOld && m_pfnPinWriteWatch != NULL )
+		{
+			m_pfnPinWriteWatch ( uiPin, uiLevel == LOW ? LOW : HIGH );
+		}
+	}
+}
+
+/// <summary>
+/// Flags the pin change interrupt of a pin's port if the pin is enabled in the port's mask, and runs it if interrupts are enabled
+/// </summary>
+/// <param name="uiPin">digital pin that changed</param>
+void HostSimClass::RaisePinChange ( uint8_t uiPin )
+{
+	volatile uint8_t* pMask = digitalPinToPCMSK ( uiPin );
+	uint8_t uiPCIE = digitalPinToPCICRbit ( uiPin );
+	if ( pMask != NULL && ( *pMask & _BV ( digitalPinToPCMSKbit ( uiPin ) ) ) && ( PCICR & _BV ( uiPCIE ) ) )
+	{
+		PCIFR |= _BV ( uiPCIE );
+		RunPendingInterrupts ();
+	}
+}
+
+/// <summary>
+/// Runs interrupt routines whose flags are set, in mcu priority order, with interrupts disabled whilst each runs as the mcu does
+/// </summary>
+/// <param name="">none</param>
+void HostSimClass::RunPendingInterrupts ( void )
+{
+	while ( !m_bInInterrupt && ( SREG & _BV ( SREG_I ) ) && ( ( TIFR2 & _BV ( OCF2A ) ) || ( PCIFR & 0x07 ) ) )
+	{
+		m_bInInterrupt = true;
+		SREG.m_uiValue &= ~_BV ( SREG_I );
+		if ( TIFR2 & _BV ( OCF2A ) )
+		{
+			TIFR2 &= ~_BV ( OCF2A );
+			m_ulTimerInterrupts++;
+			TIMER2_COMPA_vect ();
+		}
+		else
+		{
+			uint8_t uiPCIE = ( PCIFR & _BV ( PCIE0 ) ) ? PCIE0 : ( PCIFR & _BV ( PCIE1 ) ) ? PCIE1 : PCIE2;
+			PCIFR &= ~_BV ( uiPCIE );
+			m_ulPinChangeInterrupts++;
+			if ( uiPCIE == PCIE0 )
+			{
+				PCINT0_vect ();
+			}
+			else if ( uiPCIE == PCIE1 )
+			{
+				PCINT1_vect ();
+			}
+			else
+			{
+				PCINT2_vect ();
+			}
+		}
+		SREG.m_uiValue |= _BV ( SREG_I );
+		m_bInInterrupt = false;
+	}
+}
@@ -0,0 +1,64 @@
+// HostSim.h
+//
+// (c) 2021 Mark Naylor
+//
+// Simulated Arduino Uno used by the host build. Time only passes when Advance() is called, timer 2 interrupts are raised at HOST_TIMER2_HZ whilst
+// enabled and pin levels set with SetPin() raise pin change interrupts the same as the mcu. Interrupt routines run at once if interrupts are enabled,
+// else when they are next enabled, so code runs as it would on the board with interrupts at the points time passes or inputs change.
+// HostSim has no constructor, its zero initialised state is valid before any global constructor of the library runs.
+// For long runs SetTickSkip() lets Advance() jump over timer ticks in which the timer has nothing due, these are counted down in one go with the
+// same result as running them one by one. SetPinWriteWatch() reports each change of an output pin so a model of the hardware can respond to it.
+//
+#ifndef _HOSTSIM_h
+#define _HOSTSIM_h
+
+#include <Arduino.h>
+
+#define HOST_TIMER2_HZ		2000			// rate TimerClass sets timer 2 to, must match RESOLUTION in Timer.h
+
+typedef uint32_t ( *HostTicksDueFn )( void );						// ticks until timer next has a callback due, 0 if none
+typedef void ( *HostSkipTicksFn )( uint32_t ulTicks );			// count down ticks with no callback due
+typedef void ( *HostPinWriteFn )( uint8_t uiPin, uint8_t uiLevel );	// output pin written with new level
+
+class HostSimClass
+{
+public:
+	void		Advance ( uint32_t ulMicros );					// let time pass, raising timer interrupts as they fall due
+	void		AdvanceTo ( uint64_t ullMicros );				// let time pass until given micros since start
+	uint64_t	GetMicros ( void );								// simulated time since start, does not wrap
+	uint64_t	GetNextTickMicros ( void );						// time next timer 2 interrupt is due
+	void		SetPin ( uint8_t uiPin, uint8_t uiLevel );		// drive input pin to level, raises pin change interrupt if enabled
+	uint8_t		GetPin ( uint8_t uiPin );						// level of pin as written by library or set by SetPin
+	uint8_t		GetPinMode ( uint8_t uiPin );
+	int			GetAnalogWrite ( uint8_t uiPin );				// last value given to analogWrite
+	uint32_t	GetTimerInterrupts ( void );					// number of timer 2 interrupts run
+	uint32_t	GetPinChangeInterrupts ( void );				// number of pin change interrupts run
+	uint64_t	GetSkippedTicks ( void );						// number of timer 2 ticks skipped as nothing was due
+	void		SetTickSkip ( HostTicksDueFn pfnTicksDue, HostSkipTicksFn pfnSkip );	// skip ticks with nothing due, NULL to run every tick
+	void		SetPinWriteWatch ( HostPinWriteFn pfnWatch );	// called when an output pin changes level, NULL for none
+
+	// used by the Arduino.h functions
+	void		SetPinMode ( uint8_t uiPin, uint8_t uiMode );
+	void		WritePin ( uint8_t uiPin, uint8_t uiLevel );
+	void		SetAnalogWrite ( uint8_t uiPin, int iValue );
+	void		RunPendingInterrupts ( void );
+
+protected:
+	void		RaisePinChange ( uint8_t uiPin );
+
+	uint64_t	m_ullMicros;
+	uint64_t	m_ullNextTimer2;								// micros next timer 2 interrupt is due
+	uint8_t		m_uiPinMode [ NUM_DIGITAL_PINS ];
+	int			m_iAnalog [ NUM_DIGITAL_PINS ];
+	uint32_t	m_ulTimerInterrupts;
+	uint32_t	m_ulPinChangeInterrupts;
+	uint64_t	m_ullSkippedTicks;
+	HostTicksDueFn	m_pfnTicksDue;
+	HostSkipTicksFn	m_pfnSkipTicks;
+	HostPinWriteFn	m_pfnPinWriteWatch;
+	bool		m_bInInterrupt;									// true whilst an interrupt routine runs, interrupts do not nest
+};
+
+extern HostSimClass HostSim;
+
+#endif
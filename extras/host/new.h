@@ -0,0 +1,12 @@
+// new.h
+//
+// (c) 2021 Mark Naylor
+//
+// Host replacement for the Arduino core new.h, placement new comes from the standard library
+//
+#ifndef _HOST_NEW_h
+#define _HOST_NEW_h
+
+#include <new>
+
+#endif
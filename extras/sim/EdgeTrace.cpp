@@ -0,0 +1,197 @@
+// EdgeTrace.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// reads and writes pin edge traces, see EdgeTrace.h for the format
+//
+#include "EdgeTrace.h"
+#include <string.h>
+
+EdgeTraceWriterClass::EdgeTraceWriterClass ( void )
+{
+	m_pFile			= NULL;
+	m_ullLastTicks	= 0;
+	m_ulRecords		= 0;
+	m_bError		= false;
+}
+
+EdgeTraceWriterClass::~EdgeTraceWriterClass ( void )
+{
+	Close ();
+}
+
+/// <summary>
+/// Creates trace file and writes its header
+/// </summary>
+/// <param name="pFileName">file to create</param>
+/// <param name="ulTicksPerSec">units of the times passed to Write</param>
+/// <returns>true if created</returns>
+bool EdgeTraceWriterClass::Open ( const char* pFileName, uint32_t ulTicksPerSec )
+{
+	bool bResult = false;
+	Close ();
+	m_pFile = fopen ( pFileName, "wb" );
+	if ( m_pFile != NULL && ulTicksPerSec != 0 )
+	{
+		uint8_t Header [ EDGE_TRACE_HEADER_SIZE ] = { 0 };
+		memcpy ( Header, EDGE_TRACE_MAGIC, 4 );
+		Header [ 4 ] = EDGE_TRACE_VERSION;
+		for ( uint8_t i = 0; i < 4; i++ )
+		{
+			Header [ 8 + i ] = (uint8_t)( ulTicksPerSec >> ( 8 * i ) );
+		}
+		m_ullLastTicks	= 0;
+		m_ulRecords		= 0;
+		m_bError		= fwrite ( Header, sizeof ( Header ), 1, m_pFile ) != 1;
+		bResult			= !m_bError;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Appends an edge
+/// </summary>
+/// <param name="ullTicks">time of edge since start of trace</param>
+/// <param name="uiPin">pin that changed</param>
+/// <param name="uiLevel">level it changed to</param>
+/// <returns>true if written</returns>
+bool EdgeTraceWriterClass::Write ( uint64_t ullTicks, uint8_t uiPin, uint8_t uiLevel )
+{
+	bool bResult = false;
+	if ( m_pFile != NULL && ullTicks >= m_ullLastTicks && uiPin <= EDGE_TRACE_PIN_MASK )
+	{
+		uint8_t Record [ 11 ];
+		uint8_t uiLength = 0;
+		uint64_t ullDelta = ullTicks - m_ullLastTicks;
+		do
+		{
+			Record [ uiLength++ ] = (uint8_t)( ( ullDelta & 0x7F ) | ( ullDelta > 0x7F ? 0x80 : 0 ) );
+			ullDelta >>= 7;
+		} while ( ullDelta != 0 );
+		Record [ uiLength++ ] = uiPin | ( uiLevel ? EDGE_TRACE_LEVEL_BIT : 0 );
+		bResult = fwrite ( Record, uiLength, 1, m_pFile ) == 1;
+		m_bError |= !bResult;
+		m_ullLastTicks = ullTicks;
+		m_ulRecords++;
+	}
+	return bResult;
+}
+
+bool EdgeTraceWriterClass::Close ( void )
+{
+	bool bResult = !m_bError;
+	if ( m_pFile != NULL )
+	{
+		bResult = fclose ( m_pFile ) == 0 && bResult;
+		m_pFile = NULL;
+	}
+	return bResult;
+}
+
+uint32_t EdgeTraceWriterClass::GetRecordCount ( void )
+{
+	return m_ulRecords;
+}
+
+EdgeTraceReaderClass::EdgeTraceReaderClass ( void )
+{
+	m_Pos			= 0;
+	m_ullTicks		= 0;
+	m_ulTicksPerSec	= 0;
+	m_ullEndTicks	= 0;
+	m_ulRecords		= 0;
+}
+
+/// <summary>
+/// Reads a trace into memory so that replaying it does no file access
+/// </summary>
+/// <param name="pFileName">trace file</param>
+/// <returns>true if file is a trace of a version that can be read</returns>
+bool EdgeTraceReaderClass::Load ( const char* pFileName )
+{
+	bool bResult = false;
+	FILE* pFile = fopen ( pFileName, "rb" );
+	m_Data.clear ();
+	if ( pFile != NULL )
+	{
+		uint8_t Buffer [ 4096 ];
+		size_t Read;
+		while ( ( Read = fread ( Buffer, 1, sizeof ( Buffer ), pFile ) ) > 0 )
+		{
+			m_Data.insert ( m_Data.end (), Buffer, Buffer + Read );
+		}
+		fclose ( pFile );
+		if ( m_Data.size () >= EDGE_TRACE_HEADER_SIZE && memcmp ( &m_Data [ 0 ], EDGE_TRACE_MAGIC, 4 ) == 0 && m_Data [ 4 ] == EDGE_TRACE_VERSION )
+		{
+			m_ulTicksPerSec = (uint32_t)m_Data [ 8 ] | (uint32_t)m_Data [ 9 ] << 8 | (uint32_t)m_Data [ 10 ] << 16 | (uint32_t)m_Data [ 11 ] << 24;
+			bResult = m_ulTicksPerSec != 0;
+		}
+	}
+	// scan once for length of trace
+	EDGE_RECORD Record;
+	m_ullEndTicks	= 0;
+	m_ulRecords		= 0;
+	Rewind ();
+	while ( bResult && Next ( &Record ) )
+	{
+		m_ullEndTicks = Record.ullTicks;
+		m_ulRecords++;
+	}
+	Rewind ();
+	return bResult;
+}
+
+/// <summary>
+/// Gets the next edge
+/// </summary>
+/// <param name="pRecord">filled with edge</param>
+/// <returns>false at end of trace or if the last record is cut short</returns>
+bool EdgeTraceReaderClass::Next ( EDGE_RECORD* pRecord )
+{
+	bool bResult = false;
+	uint64_t ullDelta = 0;
+	uint8_t uiShift = 0;
+	size_t Pos = m_Pos;
+	while ( Pos < m_Data.size () && uiShift < 64 && ( m_Data [ Pos ] & 0x80 ) )
+	{
+		ullDelta |= (uint64_t)( m_Data [ Pos++ ] & 0x7F ) << uiShift;
+		uiShift += 7;
+	}
+	if ( Pos + 1 < m_Data.size () && uiShift < 64 )
+	{
+		ullDelta |= (uint64_t)m_Data [ Pos++ ] << uiShift;
+		m_ullTicks			+= ullDelta;
+		pRecord->ullTicks	= m_ullTicks;
+		pRecord->uiPin		= m_Data [ Pos ] & EDGE_TRACE_PIN_MASK;
+		pRecord->uiLevel	= ( m_Data [ Pos ] & EDGE_TRACE_LEVEL_BIT ) ? 1 : 0;
+		m_Pos				= Pos + 1;
+		bResult				= true;
+	}
+	return bResult;
+}
+
+void EdgeTraceReaderClass::Rewind ( void )
+{
+	m_Pos		= m_Data.size () >= EDGE_TRACE_HEADER_SIZE ? EDGE_TRACE_HEADER_SIZE : m_Data.size ();
+	m_ullTicks	= 0;
+}
+
+uint32_t EdgeTraceReaderClass::GetTicksPerSec ( void )
+{
+	return m_ulTicksPerSec;
+}
+
+uint64_t EdgeTraceReaderClass::GetEndTicks ( void )
+{
+	return m_ullEndTicks;
+}
+
+uint32_t EdgeTraceReaderClass::GetRecordCount ( void )
+{
+	return m_ulRecords;
+}
+
+uint64_t EdgeTraceReaderClass::TicksToMicros ( uint64_t ullTicks )
+{
+	return m_ulTicksPerSec == 1000000UL ? ullTicks : ullTicks / m_ulTicksPerSec * 1000000ULL + ullTicks % m_ulTicksPerSec * 1000000ULL / m_ulTicksPerSec;
+}
@@ -0,0 +1,78 @@
+// EdgeTrace.h
+//
+// (c) 2021 Mark Naylor
+//
+// Binary trace of timestamped pin edges, written by oiler_sim --record or captured on the board by EdgeCaptureClass (src/EdgeCapture.h), and fed
+// back into the library by oiler_sim --replay.
+//
+// Format, all values little endian:
+//		header	char [ 4 ]	"OTRC"
+//				uint8_t		version, EDGE_TRACE_VERSION
+//				uint8_t		reserved, 0
+//				uint16_t	reserved, 0
+//				uint32_t	ticks per second of the timestamps, e.g. 1000000 for micros or RESOLUTION for timer ticks
+//		records	varint		ticks since previous record (since start for the first), 7 bits per byte low first, top bit set if more follow
+//				uint8_t		pin in bits 0 - 6, level in bit 7
+//
+// A record is 2 bytes for edges under 128 ticks apart, an edge with the same time as the one before has a delta of 0. Levels of inputs at the
+// start are recorded as edges at time 0.
+//
+#ifndef _EDGETRACE_h
+#define _EDGETRACE_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#define EDGE_TRACE_MAGIC		"OTRC"
+#define EDGE_TRACE_VERSION		1
+#define EDGE_TRACE_HEADER_SIZE	12
+#define EDGE_TRACE_LEVEL_BIT	0x80
+#define EDGE_TRACE_PIN_MASK		0x7F
+
+typedef struct
+{
+	uint64_t	ullTicks;					// ticks since start of trace
+	uint8_t		uiPin;
+	uint8_t		uiLevel;					// HIGH or LOW
+} EDGE_RECORD;
+
+class EdgeTraceWriterClass
+{
+public:
+	EdgeTraceWriterClass ( void );
+	~EdgeTraceWriterClass ( void );
+	bool		Open ( const char* pFileName, uint32_t ulTicksPerSec );
+	bool		Write ( uint64_t ullTicks, uint8_t uiPin, uint8_t uiLevel );	// times must not go backwards
+	bool		Close ( void );													// false if any write failed
+	uint32_t	GetRecordCount ( void );
+
+protected:
+	FILE*		m_pFile;
+	uint64_t	m_ullLastTicks;
+	uint32_t	m_ulRecords;
+	bool		m_bError;
+};
+
+class EdgeTraceReaderClass
+{
+public:
+	EdgeTraceReaderClass ( void );
+	bool		Load ( const char* pFileName );								// reads whole trace, false if not a valid trace
+	bool		Next ( EDGE_RECORD* pRecord );								// false at end of trace
+	void		Rewind ( void );
+	uint32_t	GetTicksPerSec ( void );
+	uint64_t	TicksToMicros ( uint64_t ullTicks );
+	uint64_t	GetEndTicks ( void );										// time of last edge
+	uint32_t	GetRecordCount ( void );
+
+protected:
+	std::vector<uint8_t>	m_Data;
+	size_t		m_Pos;
+	uint64_t	m_ullTicks;
+	uint32_t	m_ulTicksPerSec;
+	uint64_t	m_ullEndTicks;
+	uint32_t	m_ulRecords;
+};
+
+#endif
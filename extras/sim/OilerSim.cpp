@@ -0,0 +1,527 @@
+// OilerSim.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements the discrete event simulator and the models of the hardware around the oiler
+//
+#include "OilerSim.h"
+#include <Timer.h>
+#include <TargetMachine.h>
+
+OilerSimClass OilerSim;
+
+OilerSimClass::OilerSimClass ( void )
+{
+	m_ullSeq		= 0;
+	m_ullEventsRun	= 0;
+	m_pTrace		= NULL;
+	m_pTimeline		= NULL;
+	m_pRecorder		= NULL;
+}
+
+/// <summary>
+/// Hooks into HostSim so timer ticks with nothing due are skipped and output changes reach the models watching them
+/// </summary>
+/// <param name="">none</param>
+void OilerSimClass::Begin ( void )
+{
+	HostSim.SetTickSkip ( TicksDue, SkipTicks );
+	HostSim.SetPinWriteWatch ( PinWritten );
+}
+
+/// <summary>
+/// Schedules a callback to run at a time in the future
+/// </summary>
+/// <param name="ullDelayus">micros from now</param>
+/// <param name="pCallback">routine to call</param>
+/// <param name="pContext">passed to routine, usually the model</param>
+/// <param name="ulParam">passed to routine</param>
+void OilerSimClass::Schedule ( uint64_t ullDelayus, SimEventCallback pCallback, void* pContext, uint32_t ulParam )
+{
+	SIM_EVENT Event;
+	Event.ullAtus		= HostSim.GetMicros () + ullDelayus;
+	Event.ullSeq		= m_ullSeq++;
+	Event.pCallback		= pCallback;
+	Event.pContext		= pContext;
+	Event.ulParam		= ulParam;
+	m_Events.push ( Event );
+}
+
+/// <summary>
+/// Calls routine whenever the library changes the level of an output pin
+/// </summary>
+/// <param name="uiPin">output pin</param>
+/// <param name="pCallback">routine to call</param>
+/// <param name="pContext">passed to routine</param>
+/// <returns>true if pin is valid</returns>
+bool OilerSimClass::AddPinWatch ( uint8_t uiPin, SimPinCallback pCallback, void* pContext )
+{
+	bool bResult = false;
+	if ( uiPin < NUM_DIGITAL_PINS && pCallback != NULL )
+	{
+		PIN_WATCH Watch;
+		Watch.uiPin		= uiPin;
+		Watch.pCallback	= pCallback;
+		Watch.pContext	= pContext;
+		m_PinWatches.push_back ( Watch );
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Drives an input pin as the hardware would, and records the edge if recording
+/// </summary>
+/// <param name="uiPin">input pin</param>
+/// <param name="uiLevel">HIGH or LOW</param>
+void OilerSimClass::SetPin ( uint8_t uiPin, uint8_t uiLevel )
+{
+	if ( m_pRecorder != NULL && HostSim.GetPin ( uiPin ) != uiLevel )
+	{
+		m_pRecorder->Write ( HostSim.GetMicros (), uiPin, uiLevel );
+	}
+	HostSim.SetPin ( uiPin, uiLevel );
+}
+
+/// <summary>
+/// Records inputs from now, the levels of all inputs are recorded first so the trace starts from the same state
+/// </summary>
+/// <param name="pRecorder">open trace writer with ticks of micros</param>
+void OilerSimClass::SetRecorder ( EdgeTraceWriterClass* pRecorder )
+{
+	m_pRecorder = pRecorder;
+	for ( uint8_t uiPin = 0; uiPin < NUM_DIGITAL_PINS && m_pRecorder != NULL; uiPin++ )
+	{
+		if ( HostSim.GetPinMode ( uiPin ) != OUTPUT )
+		{
+			m_pRecorder->Write ( HostSim.GetMicros (), uiPin, HostSim.GetPin ( uiPin ) );
+		}
+	}
+}
+
+/// <summary>
+/// Runs events in time order for a duration. Between events the library runs in HostSim, which stops at each tick a timer callback is due
+/// so that outputs it changes are seen by the models at the time they change
+/// </summary>
+/// <param name="ullDurationus">virtual micros to run for</param>
+/// <returns>number of events run</returns>
+uint64_t OilerSimClass::Run ( uint64_t ullDurationus )
+{
+	uint64_t ullEventsAtStart = m_ullEventsRun;
+	uint64_t ullEndus = HostSim.GetMicros () + ullDurationus;
+	bool bDone = false;
+	while ( !bDone )
+	{
+		uint64_t ullNowus = HostSim.GetMicros ();
+		if ( !m_Events.empty () && m_Events.top ().ullAtus <= ullNowus )
+		{
+			SIM_EVENT Event = m_Events.top ();
+			m_Events.pop ();
+			Event.pCallback ( Event.pContext, Event.ulParam );
+			m_ullEventsRun++;
+		}
+		else if ( ullNowus < ullEndus )
+		{
+			uint64_t ullNextus = !m_Events.empty () && m_Events.top ().ullAtus < ullEndus ? m_Events.top ().ullAtus : ullEndus;
+			HostSim.AdvanceTo ( GetStepEnd ( ullNextus ) );
+		}
+		else
+		{
+			bDone = true;
+		}
+	}
+	return m_ullEventsRun - ullEventsAtStart;
+}
+
+/// <summary>
+/// Gets how far HostSim can run towards a time, stopping at the tick a timer callback is due
+/// </summary>
+/// <param name="ullEndus">time of next event</param>
+/// <returns>time to run to</returns>
+uint64_t OilerSimClass::GetStepEnd ( uint64_t ullEndus )
+{
+	uint64_t ullResult = ullEndus;
+	uint32_t ulDue = TheTimer.GetTicksToNextCallback ();
+	if ( ulDue != 0 && ( TIMSK2 & _BV ( OCIE2A ) ) )
+	{
+		uint64_t ullDueus = HostSim.GetNextTickMicros () + ( ulDue - 1 ) * ( SIM_US_PER_SEC / HOST_TIMER2_HZ );
+		if ( ullDueus < ullResult )
+		{
+			ullResult = ullDueus;
+		}
+	}
+	return ullResult;
+}
+
+uint64_t OilerSimClass::GetMicros ( void )
+{
+	return HostSim.GetMicros ();
+}
+
+uint64_t OilerSimClass::GetEventsRun ( void )
+{
+	return m_ullEventsRun;
+}
+
+void OilerSimClass::SetTrace ( FILE* pTrace )
+{
+	m_pTrace = pTrace;
+}
+
+FILE* OilerSimClass::GetTrace ( void )
+{
+	return m_pTrace;
+}
+
+void OilerSimClass::SetTimeline ( FILE* pTimeline )
+{
+	m_pTimeline = pTimeline;
+}
+
+FILE* OilerSimClass::GetTimeline ( void )
+{
+	return m_pTimeline;
+}
+
+void OilerSimClass::PrintTime ( FILE* pFile, uint64_t ullMicros )
+{
+	uint64_t ullms = ullMicros / SIM_US_PER_MS;
+	fprintf ( pFile, "%4llud %02u:%02u:%02u.%03u", (unsigned long long)( ullms / 86400000ULL ), (unsigned)( ullms / 3600000ULL % 24 ),
+		(unsigned)( ullms / 60000ULL % 60 ), (unsigned)( ullms / 1000ULL % 60 ), (unsigned)( ullms % 1000 ) );
+}
+
+/// <summary>
+/// Called by HostSim when the library changes an output, passes it to the models watching the pin
+/// </summary>
+/// <param name="uiPin">output pin</param>
+/// <param name="uiLevel">new level</param>
+void OilerSimClass::PinWritten ( uint8_t uiPin, uint8_t uiLevel )
+{
+	for ( size_t i = 0; i < OilerSim.m_PinWatches.size (); i++ )
+	{
+		if ( OilerSim.m_PinWatches [ i ].uiPin == uiPin )
+		{
+			OilerSim.m_PinWatches [ i ].pCallback ( OilerSim.m_PinWatches [ i ].pContext, uiPin, uiLevel );
+		}
+	}
+}
+
+uint32_t OilerSimClass::TicksDue ( void )
+{
+	return TheTimer.GetTicksToNextCallback ();
+}
+
+void OilerSimClass::SkipTicks ( uint32_t ulTicks )
+{
+	TheTimer.SkipTicks ( ulTicks );
+}
+
+/*---------------------- DripSensorModelClass -----------------------------------*/
+
+DripSensorModelClass::DripSensorModelClass ( uint8_t uiDrivePin, uint8_t uiSensorPin, uint32_t ulDripIntervalms, uint32_t ulLatencyms )
+{
+	m_uiDrivePin		= uiDrivePin;
+	m_uiSensorPin		= uiSensorPin;
+	m_ulDripIntervalms	= ulDripIntervalms;
+	m_ulLatencyms		= ulLatencyms;
+	m_uiMissPercent		= 0;
+	m_ulGeneration		= 0;
+	m_ulRandom			= 12345UL + uiSensorPin;						// each pump misses different drips
+	m_ulDripsFormed		= 0;
+	m_ulDripsSensed		= 0;
+}
+
+void DripSensorModelClass::Begin ( void )
+{
+	OilerSim.SetPin ( m_uiSensorPin, LOW );
+	OilerSim.AddPinWatch ( m_uiDrivePin, DriveChanged, this );
+}
+
+void DripSensorModelClass::SetMissPercent ( uint8_t uiPercent )
+{
+	m_uiMissPercent = uiPercent > 100 ? 100 : uiPercent;
+}
+
+uint32_t DripSensorModelClass::GetDripsFormed ( void )
+{
+	return m_ulDripsFormed;
+}
+
+uint32_t DripSensorModelClass::GetDripsSensed ( void )
+{
+	return m_ulDripsSensed;
+}
+
+/// <summary>
+/// Pump started or stopped, a started pump forms its first drip after the drip interval
+/// </summary>
+void DripSensorModelClass::DriveChanged ( void* pContext, uint8_t uiPin, uint8_t uiLevel )
+{
+	DripSensorModelClass* pModel = (DripSensorModelClass*)pContext;
+	pModel->m_ulGeneration++;
+	if ( uiLevel == HIGH )
+	{
+		OilerSim.Schedule ( pModel->m_ulDripIntervalms * SIM_US_PER_MS, DripFormed, pModel, pModel->m_ulGeneration );
+	}
+}
+
+/// <summary>
+/// Drip has formed if the pump has run since it was scheduled, it falls past the sensor after the latency even if the pump stops meanwhile
+/// </summary>
+void DripSensorModelClass::DripFormed ( void* pContext, uint32_t ulGeneration )
+{
+	DripSensorModelClass* pModel = (DripSensorModelClass*)pContext;
+	if ( ulGeneration == pModel->m_ulGeneration )
+	{
+		pModel->m_ulDripsFormed++;
+		if ( !pModel->IsMissed () )
+		{
+			OilerSim.Schedule ( pModel->m_ulLatencyms * SIM_US_PER_MS, SensorOn, pModel );
+		}
+		OilerSim.Schedule ( pModel->m_ulDripIntervalms * SIM_US_PER_MS, DripFormed, pModel, ulGeneration );
+	}
+}
+
+void DripSensorModelClass::SensorOn ( void* pContext, uint32_t ulParam )
+{
+	DripSensorModelClass* pModel = (DripSensorModelClass*)pContext;
+	OilerSim.SetPin ( pModel->m_uiSensorPin, HIGH );
+	OilerSim.Schedule ( DRIP_SENSOR_PULSEMS * SIM_US_PER_MS, SensorOff, pModel );
+}
+
+/// <summary>
+/// Drip has passed the sensor, its output falls which is the edge the oiler counts
+/// </summary>
+void DripSensorModelClass::SensorOff ( void* pContext, uint32_t ulParam )
+{
+	DripSensorModelClass* pModel = (DripSensorModelClass*)pContext;
+	OilerSim.SetPin ( pModel->m_uiSensorPin, LOW );
+	pModel->m_ulDripsSensed++;
+}
+
+/// <summary>
+/// Decides if sensor misses a drip, from a fixed seed linear congruential generator so a run can be repeated
+/// </summary>
+/// <returns>true if missed</returns>
+bool DripSensorModelClass::IsMissed ( void )
+{
+	m_ulRandom = m_ulRandom * 1664525UL + 1013904223UL;
+	return ( m_ulRandom >> 16 ) % 100 < m_uiMissPercent;
+}
+
+/*---------------------- MachineModelClass -----------------------------------*/
+
+MachineModelClass::MachineModelClass ( uint8_t uiActivePin, uint8_t uiWorkPin )
+{
+	m_uiActivePin		= uiActivePin;
+	m_uiWorkPin			= uiWorkPin;
+	m_ulOnSecs			= 3600;
+	m_ulOffSecs			= 0;
+	m_uiRPM				= 0;
+	m_bActive			= false;
+	m_ulGeneration		= 0;
+	m_ullActiveStartus	= 0;
+	m_ullActiveus		= 0;
+	m_ullRevolutions	= 0;
+}
+
+/// <summary>
+/// Starts machine idle with the work signal at rest, then powers it on
+/// </summary>
+void MachineModelClass::Begin ( void )
+{
+	OilerSim.SetPin ( m_uiWorkPin, MACHINE_WORK_PIN_SIGNAL == FALLING ? HIGH : LOW );
+	OilerSim.SetPin ( m_uiActivePin, MACHINE_ACTIVE_STATE == HIGH ? LOW : HIGH );
+	OilerSim.Schedule ( 0, PowerOn, this );
+}
+
+void MachineModelClass::SetDutyCycle ( uint32_t ulOnSecs, uint32_t ulOffSecs )
+{
+	m_ulOnSecs	= ulOnSecs;
+	m_ulOffSecs	= ulOffSecs;
+}
+
+void MachineModelClass::SetRPM ( uint16_t uiRPM )
+{
+	m_uiRPM = uiRPM;
+}
+
+uint64_t MachineModelClass::GetActivems ( void )
+{
+	return ( m_ullActiveus + ( m_bActive ? OilerSim.GetMicros () - m_ullActiveStartus : 0 ) ) / SIM_US_PER_MS;
+}
+
+uint64_t MachineModelClass::GetRevolutions ( void )
+{
+	return m_ullRevolutions;
+}
+
+void MachineModelClass::PowerOn ( void* pContext, uint32_t ulParam )
+{
+	MachineModelClass* pModel = (MachineModelClass*)pContext;
+	pModel->m_bActive			= true;
+	pModel->m_ullActiveStartus	= OilerSim.GetMicros ();
+	pModel->m_ulGeneration++;
+	OilerSim.SetPin ( pModel->m_uiActivePin, MACHINE_ACTIVE_STATE );
+	if ( pModel->m_uiRPM != 0 )
+	{
+		OilerSim.Schedule ( 60ULL * SIM_US_PER_SEC / pModel->m_uiRPM, Revolution, pModel, pModel->m_ulGeneration );
+	}
+	if ( pModel->m_ulOffSecs != 0 )
+	{
+		OilerSim.Schedule ( pModel->m_ulOnSecs * SIM_US_PER_SEC, PowerOff, pModel );
+	}
+}
+
+void MachineModelClass::PowerOff ( void* pContext, uint32_t ulParam )
+{
+	MachineModelClass* pModel = (MachineModelClass*)pContext;
+	pModel->m_bActive		= false;
+	pModel->m_ullActiveus	+= OilerSim.GetMicros () - pModel->m_ullActiveStartus;
+	pModel->m_ulGeneration++;
+	OilerSim.SetPin ( pModel->m_uiActivePin, MACHINE_ACTIVE_STATE == HIGH ? LOW : HIGH );
+	OilerSim.Schedule ( pModel->m_ulOffSecs * SIM_US_PER_SEC, PowerOn, pModel );
+}
+
+/// <summary>
+/// Spindle completed a revolution, the work signal pulses and returns to rest at once as only its edge is counted
+/// </summary>
+void MachineModelClass::Revolution ( void* pContext, uint32_t ulGeneration )
+{
+	MachineModelClass* pModel = (MachineModelClass*)pContext;
+	if ( ulGeneration == pModel->m_ulGeneration )
+	{
+		uint8_t uiRest = MACHINE_WORK_PIN_SIGNAL == FALLING ? HIGH : LOW;
+		OilerSim.SetPin ( pModel->m_uiWorkPin, uiRest == HIGH ? LOW : HIGH );
+		OilerSim.SetPin ( pModel->m_uiWorkPin, uiRest );
+		pModel->m_ullRevolutions++;
+		OilerSim.Schedule ( 60ULL * SIM_US_PER_SEC / pModel->m_uiRPM, Revolution, pModel, ulGeneration );
+	}
+}
+
+/*---------------------- EdgeReplayClass -----------------------------------*/
+
+EdgeReplayClass::EdgeReplayClass ( void )
+{
+	m_pTrace		= NULL;
+	m_ullStartus	= 0;
+	m_ulEdges		= 0;
+}
+
+/// <summary>
+/// Starts replaying a trace, only the next edge is scheduled at any time so a trace of any length replays in constant memory
+/// </summary>
+/// <param name="pTrace">loaded trace</param>
+void EdgeReplayClass::Begin ( EdgeTraceReaderClass* pTrace )
+{
+	m_pTrace		= pTrace;
+	m_ullStartus	= OilerSim.GetMicros ();
+	m_ulEdges		= 0;
+	m_pTrace->Rewind ();
+	ScheduleNext ();
+}
+
+uint32_t EdgeReplayClass::GetEdgesReplayed ( void )
+{
+	return m_ulEdges;
+}
+
+void EdgeReplayClass::ScheduleNext ( void )
+{
+	if ( m_pTrace->Next ( &m_Next ) )
+	{
+		uint64_t ullAtus = m_ullStartus + m_pTrace->TicksToMicros ( m_Next.ullTicks );
+		uint64_t ullNowus = OilerSim.GetMicros ();
+		OilerSim.Schedule ( ullAtus > ullNowus ? ullAtus - ullNowus : 0, ReplayEdge, this );
+	}
+}
+
+void EdgeReplayClass::ReplayEdge ( void* pContext, uint32_t ulParam )
+{
+	EdgeReplayClass* pReplay = (EdgeReplayClass*)pContext;
+	OilerSim.SetPin ( pReplay->m_Next.uiPin, pReplay->m_Next.uiLevel );
+	pReplay->m_ulEdges++;
+	pReplay->ScheduleNext ();
+}
+
+/*---------------------- PinTimelineClass -----------------------------------*/
+
+PinTimelineClass::PinTimelineClass ( void )
+{
+	m_pLabel		= "";
+	m_uiOnLevel		= HIGH;
+	m_bOn			= false;
+	m_ullOnAtus		= 0;
+	m_ulOnCount		= 0;
+	m_ullOnTotalus	= 0;
+	m_ullMinOnus	= 0;
+	m_ullMaxOnus	= 0;
+	m_ullMinGapus	= 0;
+	m_ullMaxGapus	= 0;
+}
+
+void PinTimelineClass::Begin ( uint8_t uiPin, const char* pLabel, uint8_t uiOnLevel )
+{
+	m_pLabel	= pLabel;
+	m_uiOnLevel	= uiOnLevel;
+	OilerSim.AddPinWatch ( uiPin, PinChanged, this );
+}
+
+/// <summary>
+/// Records output turning on or off, and prints it if tracing
+/// </summary>
+void PinTimelineClass::PinChanged ( void* pContext, uint8_t uiPin, uint8_t uiLevel )
+{
+	PinTimelineClass* pTimeline = (PinTimelineClass*)pContext;
+	uint64_t ullNowus = OilerSim.GetMicros ();
+	bool bOn = uiLevel == pTimeline->m_uiOnLevel;
+	if ( bOn && !pTimeline->m_bOn )
+	{
+		if ( pTimeline->m_ulOnCount != 0 )
+		{
+			uint64_t ullGapus = ullNowus - pTimeline->m_ullOnAtus;
+			pTimeline->m_ullMinGapus = pTimeline->m_ulOnCount == 1 || ullGapus < pTimeline->m_ullMinGapus ? ullGapus : pTimeline->m_ullMinGapus;
+			pTimeline->m_ullMaxGapus = ullGapus > pTimeline->m_ullMaxGapus ? ullGapus : pTimeline->m_ullMaxGapus;
+		}
+		pTimeline->m_ullOnAtus = ullNowus;
+		pTimeline->m_ulOnCount++;
+	}
+	else if ( !bOn && pTimeline->m_bOn )
+	{
+		uint64_t ullOnus = ullNowus - pTimeline->m_ullOnAtus;
+		pTimeline->m_ullOnTotalus	+= ullOnus;
+		pTimeline->m_ullMinOnus		= pTimeline->m_ulOnCount == 1 || ullOnus < pTimeline->m_ullMinOnus ? ullOnus : pTimeline->m_ullMinOnus;
+		pTimeline->m_ullMaxOnus		= ullOnus > pTimeline->m_ullMaxOnus ? ullOnus : pTimeline->m_ullMaxOnus;
+	}
+	if ( bOn != pTimeline->m_bOn && OilerSim.GetTrace () != NULL )
+	{
+		OilerSim.PrintTime ( OilerSim.GetTrace (), ullNowus );
+		fprintf ( OilerSim.GetTrace (), "  %s %s\n", pTimeline->m_pLabel, bOn ? "on" : "off" );
+	}
+	if ( bOn != pTimeline->m_bOn && OilerSim.GetTimeline () != NULL )
+	{
+		fprintf ( OilerSim.GetTimeline (), "%llu %s %s\n", (unsigned long long)ullNowus, pTimeline->m_pLabel, bOn ? "on" : "off" );
+	}
+	pTimeline->m_bOn = bOn;
+}
+
+/// <summary>
+/// Prints number of times output turned on, time it was on and the gaps between it turning on
+/// </summary>
+/// <param name="pFile">where to print</param>
+void PinTimelineClass::Print ( FILE* pFile )
+{
+	uint64_t ullTotalus = m_ullOnTotalus + ( m_bOn ? OilerSim.GetMicros () - m_ullOnAtus : 0 );
+	uint32_t ulCompleted = m_ulOnCount - ( m_bOn ? 1 : 0 );
+	fprintf ( pFile, "%-10s on %8lu times, total %10.1f s", m_pLabel, (unsigned long)m_ulOnCount, ullTotalus / (double)SIM_US_PER_SEC );
+	if ( ulCompleted != 0 )
+	{
+		fprintf ( pFile, ", on min %8.3f avg %8.3f max %8.3f s", m_ullMinOnus / (double)SIM_US_PER_SEC,
+			m_ullOnTotalus / (double)SIM_US_PER_SEC / ulCompleted, m_ullMaxOnus / (double)SIM_US_PER_SEC );
+	}
+	if ( m_ulOnCount > 1 )
+	{
+		fprintf ( pFile, ", between starts min %9.1f max %9.1f s", m_ullMinGapus / (double)SIM_US_PER_SEC, m_ullMaxGapus / (double)SIM_US_PER_SEC );
+	}
+	fprintf ( pFile, "%s\n", m_bOn ? " (on now)" : "" );
+}
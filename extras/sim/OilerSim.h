@@ -0,0 +1,190 @@
+// OilerSim.h
+//
+// (c) 2021 Mark Naylor
+//
+// Discrete event simulator for the host build. Models of the hardware around the oiler schedule events at times in the future and OilerSim runs them in
+// time order, letting the simulated Uno (HostSim) run up to each one. Between events HostSim skips timer ticks in which TheTimer has nothing due, and
+// OilerSim never lets time run past a tick in which it has, so a model always sees an output change at the tick it happened. As the library mostly waits
+// for alarms and input edges, months of oiler operation run in seconds.
+//
+// Models provided:
+//		DripSensorModelClass	relay driven pump whose drips are seen by a sensor some time after they form, optionally missing some
+//		MachineModelClass		target machine whose active pin follows a duty cycle and whose spindle pulses the work pin at a set RPM while active
+//		PinTimelineClass		records when an output (motor relay, alert) is on, for timeline statistics
+//		EdgeReplayClass			drives inputs from a recorded trace of pin edges (EdgeTrace.h) in place of the models
+//
+// Inputs driven with OilerSim.SetPin() can be recorded to a trace, and the timeline of outputs written to a file, so that a trace replayed
+// against two versions of the library gives two timelines that oiler_timeline_diff can compare.
+//
+// OilerSim uses the HostSim hooks so there is a single instance, OilerSim.
+//
+#ifndef _OILERSIM_h
+#define _OILERSIM_h
+
+#include <stdio.h>
+#include <queue>
+#include <vector>
+#include <HostSim.h>
+#include "EdgeTrace.h"
+
+#define SIM_US_PER_MS			1000ULL
+#define SIM_US_PER_SEC			1000000ULL
+#define SIM_US_PER_DAY			( 86400ULL * SIM_US_PER_SEC )
+#define DRIP_SENSOR_PULSEMS		5UL				// time drip sensor output is on as a drip passes it
+
+typedef void ( *SimEventCallback )( void* pContext, uint32_t ulParam );
+typedef void ( *SimPinCallback )( void* pContext, uint8_t uiPin, uint8_t uiLevel );
+
+class OilerSimClass
+{
+public:
+	OilerSimClass ( void );
+	void		Begin ( void );																	// hook into HostSim, call before the library writes pins that are watched
+	void		Schedule ( uint64_t ullDelayus, SimEventCallback pCallback, void* pContext, uint32_t ulParam = 0 );	// run callback after delay, from now
+	bool		AddPinWatch ( uint8_t uiPin, SimPinCallback pCallback, void* pContext );	// called when library changes output pin
+	void		SetPin ( uint8_t uiPin, uint8_t uiLevel );									// drive input pin, recorded if recording
+	void		SetRecorder ( EdgeTraceWriterClass* pRecorder );							// record inputs driven from now, NULL to stop
+	uint64_t	Run ( uint64_t ullDurationus );												// run events and library for duration, returns events run
+	uint64_t	GetMicros ( void );															// virtual time since start
+	uint64_t	GetEventsRun ( void );
+	void		SetTrace ( FILE* pTrace );													// print timeline of watched outputs, NULL for none
+	FILE*		GetTrace ( void );
+	void		SetTimeline ( FILE* pTimeline );											// write each output change as micros label on|off, NULL for none
+	FILE*		GetTimeline ( void );
+	static void	PrintTime ( FILE* pFile, uint64_t ullMicros );								// print virtual time as days hh:mm:ss.mmm
+
+protected:
+	typedef struct
+	{
+		uint64_t			ullAtus;														// virtual time event is due
+		uint64_t			ullSeq;															// events due at the same time run in order scheduled
+		SimEventCallback	pCallback;
+		void*				pContext;
+		uint32_t			ulParam;
+	} SIM_EVENT;
+
+	struct LaterEvent
+	{
+		bool operator() ( const SIM_EVENT& Lhs, const SIM_EVENT& Rhs ) const
+		{
+			return Lhs.ullAtus != Rhs.ullAtus ? Lhs.ullAtus > Rhs.ullAtus : Lhs.ullSeq > Rhs.ullSeq;
+		}
+	};
+
+	typedef struct
+	{
+		uint8_t				uiPin;
+		SimPinCallback		pCallback;
+		void*				pContext;
+	} PIN_WATCH;
+
+	static void		PinWritten ( uint8_t uiPin, uint8_t uiLevel );
+	static uint32_t	TicksDue ( void );
+	static void		SkipTicks ( uint32_t ulTicks );
+	uint64_t		GetStepEnd ( uint64_t ullEndus );										// furthest HostSim can run before a timer callback or event is due
+
+	std::priority_queue<SIM_EVENT, std::vector<SIM_EVENT>, LaterEvent>	m_Events;
+	std::vector<PIN_WATCH>	m_PinWatches;
+	uint64_t		m_ullSeq;
+	uint64_t		m_ullEventsRun;
+	FILE*			m_pTrace;
+	FILE*			m_pTimeline;
+	EdgeTraceWriterClass*	m_pRecorder;
+};
+
+extern OilerSimClass OilerSim;
+
+class DripSensorModelClass
+{
+public:
+	DripSensorModelClass ( uint8_t uiDrivePin, uint8_t uiSensorPin, uint32_t ulDripIntervalms, uint32_t ulLatencyms );
+	void		Begin ( void );																// call after the oiler has set up the sensor pin
+	void		SetMissPercent ( uint8_t uiPercent );										// percentage of drips sensor does not see
+	uint32_t	GetDripsFormed ( void );
+	uint32_t	GetDripsSensed ( void );
+
+protected:
+	static void	DriveChanged ( void* pContext, uint8_t uiPin, uint8_t uiLevel );
+	static void	DripFormed ( void* pContext, uint32_t ulGeneration );
+	static void	SensorOn ( void* pContext, uint32_t ulParam );
+	static void	SensorOff ( void* pContext, uint32_t ulParam );
+	bool		IsMissed ( void );
+
+	uint8_t		m_uiDrivePin;																// relay pin, pump runs while HIGH
+	uint8_t		m_uiSensorPin;																// idles LOW, pulses HIGH as each drip passes
+	uint32_t	m_ulDripIntervalms;															// time pump takes to form a drip
+	uint32_t	m_ulLatencyms;																// time from drip forming to sensor seeing it
+	uint8_t		m_uiMissPercent;
+	uint32_t	m_ulGeneration;																// changed each time pump starts or stops, drips forming from before are dropped
+	uint32_t	m_ulRandom;																	// state of generator for missed drips, fixed seed so runs repeat
+	uint32_t	m_ulDripsFormed;
+	uint32_t	m_ulDripsSensed;
+};
+
+class MachineModelClass
+{
+public:
+	MachineModelClass ( uint8_t uiActivePin, uint8_t uiWorkPin );
+	void		Begin ( void );																// call after TargetMachine has set up its pins
+	void		SetDutyCycle ( uint32_t ulOnSecs, uint32_t ulOffSecs );						// active for on then idle for off, repeating, off 0 => always active
+	void		SetRPM ( uint16_t uiRPM );													// spindle speed whilst active, 0 => no work signals
+	uint64_t	GetActivems ( void );														// time machine was active
+	uint64_t	GetRevolutions ( void );
+
+protected:
+	static void	PowerOn ( void* pContext, uint32_t ulParam );
+	static void	PowerOff ( void* pContext, uint32_t ulParam );
+	static void	Revolution ( void* pContext, uint32_t ulGeneration );
+
+	uint8_t		m_uiActivePin;
+	uint8_t		m_uiWorkPin;
+	uint32_t	m_ulOnSecs;
+	uint32_t	m_ulOffSecs;
+	uint16_t	m_uiRPM;
+	bool		m_bActive;
+	uint32_t	m_ulGeneration;																// changed each time machine powers on or off, revolutions from before are dropped
+	uint64_t	m_ullActiveStartus;
+	uint64_t	m_ullActiveus;
+	uint64_t	m_ullRevolutions;
+};
+
+class EdgeReplayClass
+{
+public:
+	EdgeReplayClass ( void );
+	void		Begin ( EdgeTraceReaderClass* pTrace );										// drive inputs from trace, its time 0 is now
+	uint32_t	GetEdgesReplayed ( void );
+
+protected:
+	static void	ReplayEdge ( void* pContext, uint32_t ulParam );
+	void		ScheduleNext ( void );
+
+	EdgeTraceReaderClass*	m_pTrace;
+	EDGE_RECORD	m_Next;																		// edge scheduled to be replayed next
+	uint64_t	m_ullStartus;
+	uint32_t	m_ulEdges;
+};
+
+class PinTimelineClass
+{
+public:
+	PinTimelineClass ( void );
+	void		Begin ( uint8_t uiPin, const char* pLabel, uint8_t uiOnLevel = HIGH );		// watch output pin, on when at given level
+	void		Print ( FILE* pFile );														// statistics up to now
+
+protected:
+	static void	PinChanged ( void* pContext, uint8_t uiPin, uint8_t uiLevel );
+
+	const char*	m_pLabel;
+	uint8_t		m_uiOnLevel;
+	bool		m_bOn;
+	uint64_t	m_ullOnAtus;																// time last turned on
+	uint32_t	m_ulOnCount;
+	uint64_t	m_ullOnTotalus;
+	uint64_t	m_ullMinOnus;
+	uint64_t	m_ullMaxOnus;
+	uint64_t	m_ullMinGapus;																// between successive turn ons
+	uint64_t	m_ullMaxGapus;
+};
+
+#endif
@@ -0,0 +1,243 @@
+// OilerSimMain.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// oiler_sim, runs TheOiler with relay pumps and TheMachine for days of virtual time and prints timeline statistics.
+//
+//	oiler_sim [--days n] [--motors n] [--mode time|power|work] [--target n] [--drips n] [--alert n] [--drip-ms n] [--latency-ms n] [--miss-pct n]
+//			  [--rpm n] [--on-mins n] [--off-mins n] [--secs n] [--trace] [--record file] [--replay file] [--timeline file]
+//
+//	--target is the restart target in seconds for time and power modes and in revolutions for work mode, --alert is the alert threshold
+//	as a multiple of the target. The machine is active for --on-mins then idle for --off-mins, repeating, turning at --rpm whilst active.
+//	--trace prints each motor and alert change as it happens. --secs runs for a number of seconds in place of days.
+//
+//	--record writes the edges driven on the inputs to a trace file, see EdgeTrace.h. --replay drives the inputs from a trace in place of the
+//	models, running to the last edge unless --days or --secs is given, so the oiler must be set up with the same options it was recorded with.
+//	--timeline writes each motor and alert change to a file, comparing the timelines of a trace replayed against two versions of the library
+//	with oiler_timeline_diff shows where they differ.
+//
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <OilerLib.h>
+#include "OilerSim.h"
+
+#define SIM_MAX_MOTORS			3
+#define SIM_MACHINE_ACTIVE_PIN	2
+#define SIM_MACHINE_WORK_PIN	3
+#define SIM_FIRST_RELAY_PIN		4			// relays on 4, 5, 6
+#define SIM_FIRST_SENSOR_PIN	8			// drip sensors on 8, 9, 10
+#define SIM_ALERT_PIN			13
+
+typedef struct
+{
+	uint8_t		uiMotors;
+	const char*	pMode;
+	uint32_t	ulTarget;
+	uint32_t	ulDrips;
+	uint32_t	ulAlertMultiple;
+	uint32_t	ulDripIntervalms;
+	uint32_t	ulLatencyms;
+	uint8_t		uiMissPercent;
+	uint16_t	uiRPM;
+	uint32_t	ulOnMins;
+	uint32_t	ulOffMins;
+	bool		bTrace;
+	uint64_t	ullDurationus;			// from --days or --secs, 0 => not given
+	const char*	pRecordFile;
+	const char*	pReplayFile;
+	const char*	pTimelineFile;
+} SIM_OPTIONS;
+
+static bool ParseOptions ( int iArgc, char** ppArgv, SIM_OPTIONS* pOptions )
+{
+	bool bResult = true;
+	for ( int i = 1; i < iArgc && bResult; i++ )
+	{
+		const char* pArg = ppArgv [ i ];
+		const char* pValue = i + 1 < iArgc ? ppArgv [ i + 1 ] : NULL;
+		if ( strcmp ( pArg, "--trace" ) == 0 )
+		{
+			pOptions->bTrace = true;
+		}
+		else if ( pValue == NULL )
+		{
+			bResult = false;
+		}
+		else
+		{
+			uint32_t ulValue = strtoul ( pValue, NULL, 10 );
+			i++;
+			if ( strcmp ( pArg, "--days" ) == 0 )				pOptions->ullDurationus = ulValue * SIM_US_PER_DAY;
+			else if ( strcmp ( pArg, "--secs" ) == 0 )			pOptions->ullDurationus = ulValue * SIM_US_PER_SEC;
+			else if ( strcmp ( pArg, "--record" ) == 0 )		pOptions->pRecordFile = pValue;
+			else if ( strcmp ( pArg, "--replay" ) == 0 )		pOptions->pReplayFile = pValue;
+			else if ( strcmp ( pArg, "--timeline" ) == 0 )		pOptions->pTimelineFile = pValue;
+			else if ( strcmp ( pArg, "--motors" ) == 0 )		pOptions->uiMotors = (uint8_t)ulValue;
+			else if ( strcmp ( pArg, "--mode" ) == 0 )			pOptions->pMode = pValue;
+			else if ( strcmp ( pArg, "--target" ) == 0 )		pOptions->ulTarget = ulValue;
+			else if ( strcmp ( pArg, "--drips" ) == 0 )			pOptions->ulDrips = ulValue;
+			else if ( strcmp ( pArg, "--alert" ) == 0 )			pOptions->ulAlertMultiple = ulValue;
+			else if ( strcmp ( pArg, "--drip-ms" ) == 0 )		pOptions->ulDripIntervalms = ulValue;
+			else if ( strcmp ( pArg, "--latency-ms" ) == 0 )	pOptions->ulLatencyms = ulValue;
+			else if ( strcmp ( pArg, "--miss-pct" ) == 0 )		pOptions->uiMissPercent = (uint8_t)ulValue;
+			else if ( strcmp ( pArg, "--rpm" ) == 0 )			pOptions->uiRPM = (uint16_t)ulValue;
+			else if ( strcmp ( pArg, "--on-mins" ) == 0 )		pOptions->ulOnMins = ulValue;
+			else if ( strcmp ( pArg, "--off-mins" ) == 0 )		pOptions->ulOffMins = ulValue;
+			else												bResult = false;
+		}
+	}
+	if ( pOptions->uiMotors == 0 || pOptions->uiMotors > SIM_MAX_MOTORS || pOptions->ulTarget == 0 || pOptions->ulDripIntervalms == 0 )
+	{
+		bResult = false;
+	}
+	return bResult;
+}
+
+int main ( int iArgc, char** ppArgv )
+{
+	SIM_OPTIONS Options = { 2, "time", 1800, 1, 2, 2000, 300, 0, 300, 480, 960, false, 0, NULL, NULL, NULL };
+	if ( !ParseOptions ( iArgc, ppArgv, &Options ) )
+	{
+		fprintf ( stderr, "usage: oiler_sim [--days n] [--motors 1-%d] [--mode time|power|work] [--target n] [--drips n] [--alert n]\n"
+			"                 [--drip-ms n] [--latency-ms n] [--miss-pct n] [--rpm n] [--on-mins n] [--off-mins n] [--secs n] [--trace]\n"
+			"                 [--record file] [--replay file] [--timeline file]\n", SIM_MAX_MOTORS );
+		return 2;
+	}
+	EdgeTraceReaderClass Replay;
+	if ( Options.pReplayFile != NULL && !Replay.Load ( Options.pReplayFile ) )
+	{
+		fprintf ( stderr, "oiler_sim: %s is not an edge trace\n", Options.pReplayFile );
+		return 1;
+	}
+	if ( Options.ullDurationus == 0 )
+	{
+		Options.ullDurationus = Options.pReplayFile != NULL ? Replay.TicksToMicros ( Replay.GetEndTicks () ) : 30 * SIM_US_PER_DAY;
+	}
+	EdgeTraceWriterClass Recorder;
+	if ( Options.pRecordFile != NULL && !Recorder.Open ( Options.pRecordFile, (uint32_t)SIM_US_PER_SEC ) )
+	{
+		fprintf ( stderr, "oiler_sim: unable to create %s\n", Options.pRecordFile );
+		return 1;
+	}
+	FILE* pTimeline = Options.pTimelineFile != NULL ? fopen ( Options.pTimelineFile, "w" ) : NULL;
+	if ( Options.pTimelineFile != NULL && pTimeline == NULL )
+	{
+		fprintf ( stderr, "oiler_sim: unable to create %s\n", Options.pTimelineFile );
+		return 1;
+	}
+
+	static DripSensorModelClass* pPumps [ SIM_MAX_MOTORS ];
+	static PinTimelineClass Motors [ SIM_MAX_MOTORS ];
+	static PinTimelineClass Alert;
+	static const char* pLabels [ SIM_MAX_MOTORS ] = { "motor0", "motor1", "motor2" };
+	MachineModelClass Machine ( SIM_MACHINE_ACTIVE_PIN, SIM_MACHINE_WORK_PIN );
+	EdgeReplayClass Replayer;
+
+	OilerSim.Begin ();
+	OilerSim.SetTrace ( Options.bTrace ? stdout : NULL );
+	OilerSim.SetTimeline ( pTimeline );
+
+	// set up as a sketch would
+	TheMachine.AddFeatures ( SIM_MACHINE_ACTIVE_PIN, SIM_MACHINE_WORK_PIN );
+	for ( uint8_t i = 0; i < Options.uiMotors; i++ )
+	{
+		TheOiler.AddMotor ( SIM_FIRST_RELAY_PIN + i, SIM_FIRST_SENSOR_PIN + i, Options.ulDrips );
+	}
+	TheOiler.AddMachine ( &TheMachine );
+	bool bModeSet = false;
+	if ( strcmp ( Options.pMode, "power" ) == 0 )
+	{
+		bModeSet = TheOiler.SetStartEventToTargetActiveTime ( Options.ulTarget );
+	}
+	else if ( strcmp ( Options.pMode, "work" ) == 0 )
+	{
+		bModeSet = TheOiler.SetStartEventToTargetWork ( Options.ulTarget );
+	}
+	else
+	{
+		bModeSet = TheOiler.SetStartEventToTime ( Options.ulTarget );
+	}
+	if ( !bModeSet )
+	{
+		fprintf ( stderr, "oiler_sim: unable to set mode %s\n", Options.pMode );
+		return 1;
+	}
+	TheOiler.SetAlert ( SIM_ALERT_PIN, Options.ulAlertMultiple * Options.ulTarget );
+
+	if ( Options.pRecordFile != NULL )
+	{
+		OilerSim.SetRecorder ( &Recorder );
+	}
+
+	// models of the hardware, or a trace of it
+	for ( uint8_t i = 0; i < Options.uiMotors; i++ )
+	{
+		pPumps [ i ] = new DripSensorModelClass ( SIM_FIRST_RELAY_PIN + i, SIM_FIRST_SENSOR_PIN + i, Options.ulDripIntervalms, Options.ulLatencyms );
+		pPumps [ i ]->SetMissPercent ( Options.uiMissPercent );
+		if ( Options.pReplayFile == NULL )
+		{
+			pPumps [ i ]->Begin ();
+		}
+		Motors [ i ].Begin ( SIM_FIRST_RELAY_PIN + i, pLabels [ i ] );
+	}
+	Alert.Begin ( SIM_ALERT_PIN, "alert", ALERT_PIN_ERROR_STATE );
+	Machine.SetDutyCycle ( Options.ulOnMins * 60, Options.ulOffMins * 60 );
+	Machine.SetRPM ( Options.uiRPM );
+	if ( Options.pReplayFile == NULL )
+	{
+		Machine.Begin ();
+	}
+	else
+	{
+		Replayer.Begin ( &Replay );
+	}
+
+	TheOiler.On ();
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now ();
+	OilerSim.Run ( Options.ullDurationus );
+	double dWallSecs = std::chrono::duration<double> ( std::chrono::steady_clock::now () - Start ).count ();
+	double dSimSecs = Options.ullDurationus / (double)SIM_US_PER_SEC;
+	OilerSim.SetRecorder ( NULL );
+	if ( Options.pRecordFile != NULL && !Recorder.Close () )
+	{
+		fprintf ( stderr, "oiler_sim: error writing %s\n", Options.pRecordFile );
+	}
+	if ( pTimeline != NULL )
+	{
+		fclose ( pTimeline );
+		OilerSim.SetTimeline ( NULL );
+	}
+
+	OilerClass::SNAPSHOT Snapshot;
+	TheOiler.GetSnapshot ( &Snapshot );
+	printf ( "\nsimulated %.3f days, mode %s target %lu, %lu drips per start, alert at %lu x target\n", dSimSecs / 86400.0, Options.pMode,
+		(unsigned long)Options.ulTarget, (unsigned long)Options.ulDrips, (unsigned long)Options.ulAlertMultiple );
+	for ( uint8_t i = 0; i < Options.uiMotors; i++ )
+	{
+		Motors [ i ].Print ( stdout );
+	}
+	Alert.Print ( stdout );
+	if ( Options.pReplayFile == NULL )
+	{
+		for ( uint8_t i = 0; i < Options.uiMotors; i++ )
+		{
+			printf ( "pump %u     drips formed %lu, sensed %lu\n", i, (unsigned long)pPumps [ i ]->GetDripsFormed (), (unsigned long)pPumps [ i ]->GetDripsSensed () );
+		}
+		printf ( "machine    active %.1f h, %llu revolutions\n", Machine.GetActivems () / 3600000.0, (unsigned long long)Machine.GetRevolutions () );
+	}
+	else
+	{
+		printf ( "replay     %lu of %lu edges from %s\n", (unsigned long)Replayer.GetEdgesReplayed (), (unsigned long)Replay.GetRecordCount (), Options.pReplayFile );
+	}
+	if ( Options.pRecordFile != NULL )
+	{
+		printf ( "record     %lu edges to %s\n", (unsigned long)Recorder.GetRecordCount (), Options.pRecordFile );
+	}
+	printf ( "oiler      status %d, alert %d, %lu ms idle at end\n", (int)Snapshot.Status, (int)Snapshot.bAlert, (unsigned long)Snapshot.ulIdlems );
+	printf ( "host       %llu events, %lu timer interrupts run, %llu ticks skipped, %lu pin change interrupts\n",
+		(unsigned long long)OilerSim.GetEventsRun (), (unsigned long)HostSim.GetTimerInterrupts (), (unsigned long long)HostSim.GetSkippedTicks (),
+		(unsigned long)HostSim.GetPinChangeInterrupts () );
+	printf ( "wall time  %.2f s, %.0f x real time\n", dWallSecs, dWallSecs > 0 ? dSimSecs / dWallSecs : 0.0 );
+	return 0;
+}
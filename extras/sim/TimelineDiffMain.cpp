@@ -0,0 +1,121 @@
+// TimelineDiffMain.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// oiler_timeline_diff, compares two timelines written by oiler_sim --timeline, e.g. from replaying one trace against two versions of the library.
+//
+//	oiler_timeline_diff old.txt new.txt [tolerance ms]
+//
+// Changes of each output are paired in order, nth change of motor0 in old with nth in new. Prints the changes each timeline has per output,
+// the largest time difference of a pair and the first pair that differs in state or by more than the tolerance (default 0).
+// Exits 0 if the timelines match within the tolerance, 1 if not and 2 on error.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef struct
+{
+	uint64_t	ullTimeus;
+	bool		bOn;
+} TIMELINE_CHANGE;
+
+typedef std::map<std::string, std::vector<TIMELINE_CHANGE> > TIMELINE;
+
+/// <summary>
+/// Reads timeline, lines of micros label on|off
+/// </summary>
+/// <param name="pFileName">timeline file</param>
+/// <param name="pTimeline">filled with changes of each output in time order</param>
+/// <returns>true if read</returns>
+static bool LoadTimeline ( const char* pFileName, TIMELINE* pTimeline )
+{
+	bool bResult = false;
+	FILE* pFile = fopen ( pFileName, "r" );
+	if ( pFile != NULL )
+	{
+		char Line [ 256 ];
+		bResult = true;
+		while ( bResult && fgets ( Line, sizeof ( Line ), pFile ) != NULL )
+		{
+			unsigned long long ullTimeus;
+			char Label [ 64 ];
+			char State [ 8 ];
+			if ( sscanf ( Line, "%llu %63s %7s", &ullTimeus, Label, State ) == 3 )
+			{
+				TIMELINE_CHANGE Change = { ullTimeus, strcmp ( State, "on" ) == 0 };
+				( *pTimeline ) [ Label ].push_back ( Change );
+			}
+			else
+			{
+				bResult = Line [ 0 ] == '\n' || Line [ 0 ] == '#';
+			}
+		}
+		fclose ( pFile );
+	}
+	if ( !bResult )
+	{
+		fprintf ( stderr, "oiler_timeline_diff: unable to read %s\n", pFileName );
+	}
+	return bResult;
+}
+
+int main ( int iArgc, char** ppArgv )
+{
+	if ( iArgc < 3 || iArgc > 4 )
+	{
+		fprintf ( stderr, "usage: oiler_timeline_diff old new [tolerance ms]\n" );
+		return 2;
+	}
+	uint64_t ullToleranceus = iArgc == 4 ? strtoull ( ppArgv [ 3 ], NULL, 10 ) * 1000ULL : 0;
+	TIMELINE Old, New;
+	if ( !LoadTimeline ( ppArgv [ 1 ], &Old ) || !LoadTimeline ( ppArgv [ 2 ], &New ) )
+	{
+		return 2;
+	}
+
+	// every output in either timeline
+	TIMELINE Outputs = Old;
+	Outputs.insert ( New.begin (), New.end () );
+	bool bSame = true;
+	for ( TIMELINE::iterator it = Outputs.begin (); it != Outputs.end (); ++it )
+	{
+		const std::vector<TIMELINE_CHANGE>& OldChanges = Old [ it->first ];
+		const std::vector<TIMELINE_CHANGE>& NewChanges = New [ it->first ];
+		size_t Pairs = OldChanges.size () < NewChanges.size () ? OldChanges.size () : NewChanges.size ();
+		uint64_t ullMaxDiffus = 0;
+		size_t FirstDiff = Pairs;
+		for ( size_t i = 0; i < Pairs; i++ )
+		{
+			uint64_t ullOldus = OldChanges [ i ].ullTimeus;
+			uint64_t ullNewus = NewChanges [ i ].ullTimeus;
+			uint64_t ullDiffus = ullOldus > ullNewus ? ullOldus - ullNewus : ullNewus - ullOldus;
+			ullMaxDiffus = ullDiffus > ullMaxDiffus ? ullDiffus : ullMaxDiffus;
+			if ( FirstDiff == Pairs && ( ullDiffus > ullToleranceus || OldChanges [ i ].bOn != NewChanges [ i ].bOn ) )
+			{
+				FirstDiff = i;
+			}
+		}
+		bool bOutputSame = FirstDiff == Pairs && OldChanges.size () == NewChanges.size ();
+		printf ( "%-10s %8lu / %8lu changes, max time difference %.3f ms%s\n", it->first.c_str (), (unsigned long)OldChanges.size (),
+			(unsigned long)NewChanges.size (), ullMaxDiffus / 1000.0, bOutputSame ? "" : ", DIFFERS" );
+		if ( FirstDiff != Pairs )
+		{
+			printf ( "           first at change %lu: old %llu us %s, new %llu us %s\n", (unsigned long)FirstDiff,
+				(unsigned long long)OldChanges [ FirstDiff ].ullTimeus, OldChanges [ FirstDiff ].bOn ? "on" : "off",
+				(unsigned long long)NewChanges [ FirstDiff ].ullTimeus, NewChanges [ FirstDiff ].bOn ? "on" : "off" );
+		}
+		else if ( !bOutputSame )
+		{
+			const std::vector<TIMELINE_CHANGE>& Longer = OldChanges.size () > NewChanges.size () ? OldChanges : NewChanges;
+			printf ( "           %s has extra changes from %llu us\n", &Longer == &OldChanges ? "old" : "new", (unsigned long long)Longer [ Pairs ].ullTimeus );
+		}
+		bSame &= bOutputSame;
+	}
+	printf ( "%s\n", bSame ? "timelines match" : "timelines differ" );
+	return bSame ? 0 : 1;
+}
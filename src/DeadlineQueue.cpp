@@ -0,0 +1,190 @@
+// DeadlineQueue.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements binary min heap of deadlines indexed by id
+//
+#include "DeadlineQueue.h"
+
+/// <summary>
+/// initialises a queue with no storage, Begin() must be called before it is used
+/// </summary>
+/// <param name="">none</param>
+DeadlineQueueClass::DeadlineQueueClass ( void )
+{
+	Begin ( NULL, NULL, 0 );
+}
+
+/// <summary>
+/// initialises an empty queue
+/// </summary>
+/// <param name="pHeap">array of uiCapacity deadlines</param>
+/// <param name="pPosition">array of uiCapacity positions, one per id</param>
+/// <param name="uiCapacity">number of ids, ids are 0 to uiCapacity - 1</param>
+DeadlineQueueClass::DeadlineQueueClass ( DEADLINE* pHeap, uint8_t* pPosition, uint8_t uiCapacity )
+{
+	Begin ( pHeap, pPosition, uiCapacity );
+}
+
+/// <summary>
+/// Sets the storage of the queue and empties it, used when queues are in an array so cannot be given storage by the constructor
+/// </summary>
+/// <param name="pHeap">array of uiCapacity deadlines</param>
+/// <param name="pPosition">array of uiCapacity positions, one per id</param>
+/// <param name="uiCapacity">number of ids, ids are 0 to uiCapacity - 1</param>
+void DeadlineQueueClass::Begin ( DEADLINE* pHeap, uint8_t* pPosition, uint8_t uiCapacity )
+{
+	m_pHeap			= pHeap;
+	m_pPosition		= pPosition;
+	m_uiCapacity	= uiCapacity;
+	Clear ();
+}
+
+/// <summary>
+/// Removes all deadlines
+/// </summary>
+/// <param name="">none</param>
+void DeadlineQueueClass::Clear ( void )
+{
+	m_uiCount = 0;
+	memset ( m_pPosition, NO_DEADLINE, m_uiCapacity );
+}
+
+/// <summary>
+/// Sets the deadline of an id, replacing any deadline it already has
+/// </summary>
+/// <param name="uiId">id of owner</param>
+/// <param name="ulDeadline">value at which deadline is due</param>
+void DeadlineQueueClass::Set ( uint8_t uiId, uint32_t ulDeadline )
+{
+	if ( uiId < m_uiCapacity )
+	{
+		uint8_t uiPos = m_pPosition [ uiId ];
+		if ( uiPos == NO_DEADLINE )
+		{
+			// add to end of heap
+			uiPos = m_uiCount++;
+			m_pHeap [ uiPos ].uiId = uiId;
+			m_pPosition [ uiId ] = uiPos;
+		}
+		m_pHeap [ uiPos ].ulDeadline = ulDeadline;
+		// deadline may have moved either way
+		SiftUp ( uiPos );
+		SiftDown ( m_pPosition [ uiId ] );
+	}
+}
+
+/// <summary>
+/// Removes the deadline of an id
+/// </summary>
+/// <param name="uiId">id of owner</param>
+void DeadlineQueueClass::Remove ( uint8_t uiId )
+{
+	if ( uiId < m_uiCapacity && m_pPosition [ uiId ] != NO_DEADLINE )
+	{
+		uint8_t uiPos = m_pPosition [ uiId ];
+		m_uiCount--;
+		if ( uiPos != m_uiCount )
+		{
+			// move last deadline into the gap and restore heap order
+			Swap ( uiPos, m_uiCount );
+			SiftUp ( uiPos );
+			SiftDown ( m_pPosition [ m_pHeap [ uiPos ].uiId ] );
+		}
+		m_pPosition [ uiId ] = NO_DEADLINE;
+	}
+}
+
+/// <summary>
+/// Checks if queue has no deadlines
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if empty, else false</returns>
+bool DeadlineQueueClass::IsEmpty ( void )
+{
+	return m_uiCount == 0;
+}
+
+/// <summary>
+/// Checks if the nearest deadline is due
+/// </summary>
+/// <param name="ulNow">current value of what deadlines measure</param>
+/// <returns>true if there is a deadline at or before ulNow, else false</returns>
+bool DeadlineQueueClass::IsDue ( uint32_t ulNow )
+{
+	return m_uiCount > 0 && (int32_t)( ulNow - m_pHeap [ 0 ].ulDeadline ) >= 0;
+}
+
+/// <summary>
+/// Gets the id with the nearest deadline, only valid if queue not empty
+/// </summary>
+/// <param name="">none</param>
+/// <returns>id</returns>
+uint8_t DeadlineQueueClass::GetFirstId ( void )
+{
+	return m_pHeap [ 0 ].uiId;
+}
+
+/// <summary>
+/// Gets the nearest deadline, only valid if queue not empty
+/// </summary>
+/// <param name="">none</param>
+/// <returns>deadline</returns>
+uint32_t DeadlineQueueClass::GetFirstDeadline ( void )
+{
+	return m_pHeap [ 0 ].ulDeadline;
+}
+
+bool DeadlineQueueClass::IsBefore ( uint8_t uiPos1, uint8_t uiPos2 )
+{
+	return (int32_t)( m_pHeap [ uiPos1 ].ulDeadline - m_pHeap [ uiPos2 ].ulDeadline ) < 0;
+}
+
+void DeadlineQueueClass::Swap ( uint8_t uiPos1, uint8_t uiPos2 )
+{
+	DEADLINE Temp = m_pHeap [ uiPos1 ];
+	m_pHeap [ uiPos1 ] = m_pHeap [ uiPos2 ];
+	m_pHeap [ uiPos2 ] = Temp;
+	m_pPosition [ m_pHeap [ uiPos1 ].uiId ] = uiPos1;
+	m_pPosition [ m_pHeap [ uiPos2 ].uiId ] = uiPos2;
+}
+
+// moves deadline towards front of heap until its parent is not later
+void DeadlineQueueClass::SiftUp ( uint8_t uiPos )
+{
+	while ( uiPos > 0 )
+	{
+		uint8_t uiParent = ( uiPos - 1 ) >> 1;
+		if ( !IsBefore ( uiPos, uiParent ) )
+		{
+			break;
+		}
+		Swap ( uiPos, uiParent );
+		uiPos = uiParent;
+	}
+}
+
+// moves deadline towards back of heap until neither child is earlier
+void DeadlineQueueClass::SiftDown ( uint8_t uiPos )
+{
+	for ( ;; )
+	{
+		uint8_t uiFirst = uiPos;
+		uint8_t uiChild = ( uiPos << 1 ) + 1;
+		if ( uiChild < m_uiCount && IsBefore ( uiChild, uiFirst ) )
+		{
+			uiFirst = uiChild;
+		}
+		uiChild++;
+		if ( uiChild < m_uiCount && IsBefore ( uiChild, uiFirst ) )
+		{
+			uiFirst = uiChild;
+		}
+		if ( uiFirst == uiPos )
+		{
+			break;
+		}
+		Swap ( uiPos, uiFirst );
+		uiPos = uiFirst;
+	}
+}
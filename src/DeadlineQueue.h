@@ -0,0 +1,51 @@
+// DeadlineQueue.h
+//
+// (c) 2021 Mark Naylor
+//
+// defines a small priority queue of deadlines, each deadline belongs to an id (e.g. motor index) and an id has at most one deadline.
+// The queue is a binary min heap so the nearest deadline is always at the front, setting or removing a deadline is O(log n).
+// A position table maps each id to its place in the heap so a deadline can be changed or removed without searching.
+//
+// Deadlines are compared as differences so that they work across a wrap of the value being measured (e.g. millis)
+// Storage is provided by the owner so the size is fixed at compile time.
+//
+#ifndef _DEADLINEQUEUE_h
+#define _DEADLINEQUEUE_h
+
+#include <Arduino.h>
+
+#define		NO_DEADLINE		0xFF						// position of id that has no deadline
+
+class DeadlineQueueClass
+{
+public:
+	typedef struct
+	{
+		uint32_t		ulDeadline;						// value at which deadline is due
+		uint8_t			uiId;							// owner of deadline
+	} DEADLINE;
+
+	DeadlineQueueClass ( void );
+	DeadlineQueueClass ( DEADLINE* pHeap, uint8_t* pPosition, uint8_t uiCapacity );
+	void		Begin ( DEADLINE* pHeap, uint8_t* pPosition, uint8_t uiCapacity );	// set storage, empties queue
+	void		Clear ( void );
+	void		Set ( uint8_t uiId, uint32_t ulDeadline );	// add or change deadline of id
+	void		Remove ( uint8_t uiId );					// remove deadline of id if it has one
+	bool		IsEmpty ( void );
+	bool		IsDue ( uint32_t ulNow );					// true if nearest deadline is at or before ulNow
+	uint8_t		GetFirstId ( void );						// id with nearest deadline
+	uint32_t	GetFirstDeadline ( void );					// nearest deadline
+
+protected:
+	bool		IsBefore ( uint8_t uiPos1, uint8_t uiPos2 );
+	void		Swap ( uint8_t uiPos1, uint8_t uiPos2 );
+	void		SiftUp ( uint8_t uiPos );
+	void		SiftDown ( uint8_t uiPos );
+
+	DEADLINE*	m_pHeap;								// heap of deadlines, nearest at index 0
+	uint8_t*	m_pPosition;							// index in heap of each id's deadline, NO_DEADLINE if none
+	uint8_t		m_uiCapacity;							// max number of ids
+	uint8_t		m_uiCount;								// number of deadlines in heap
+};
+
+#endif
@@ -0,0 +1,117 @@
+// DripRateController.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements fixed point PI controller used to hold a target interval between work units (oil drips) by adjusting motor drive level
+//
+#include "DripRateController.h"
+
+DripRateControllerClass::DripRateControllerClass ( void )
+{
+	m_uiTargetIntervalms	= 0;
+	m_uiKp					= DRIP_CONTROL_KP;
+	m_uiKi					= DRIP_CONTROL_KI;
+	m_uiBaseLevel			= DRIVE_LEVEL_NOMINAL;
+	m_uiLevel				= DRIVE_LEVEL_NOMINAL;
+	m_lIntegral				= 0L;
+}
+
+/// <summary>
+/// Starts controlling the drive level to achieve the target interval between work units
+/// </summary>
+/// <param name="uiTargetIntervalms">required milliseconds between work units, 0 disables controller</param>
+/// <param name="uiKp">proportional gain in 1/256 drive level per ms of error</param>
+/// <param name="uiKi">integral gain in 1/256 drive level per ms of error per work unit</param>
+/// <param name="uiStartLevel">drive level motor is currently using</param>
+void DripRateControllerClass::Enable ( uint16_t uiTargetIntervalms, uint8_t uiKp, uint8_t uiKi, uint8_t uiStartLevel )
+{
+	m_uiTargetIntervalms	= uiTargetIntervalms;
+	m_uiKp					= uiKp;
+	m_uiKi					= uiKi;
+	m_uiBaseLevel			= uiStartLevel < DRIVE_LEVEL_MIN ? DRIVE_LEVEL_MIN : uiStartLevel;
+	m_uiLevel				= m_uiBaseLevel;
+	m_lIntegral				= 0L;
+}
+
+/// <summary>
+/// Stops the controller, motor is left at last drive level
+/// </summary>
+/// <param name="">none</param>
+void DripRateControllerClass::Disable ( void )
+{
+	m_uiTargetIntervalms = 0;
+}
+
+/// <summary>
+/// Checks if the controller is active
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if a target interval is set, else false</returns>
+bool DripRateControllerClass::IsEnabled ( void )
+{
+	return m_uiTargetIntervalms != 0;
+}
+
+/// <summary>
+/// Gets the target interval between work units
+/// </summary>
+/// <param name="">none</param>
+/// <returns>milliseconds, 0 if disabled</returns>
+uint16_t DripRateControllerClass::GetTargetInterval ( void )
+{
+	return m_uiTargetIntervalms;
+}
+
+/// <summary>
+/// Gets the drive level last output by the controller
+/// </summary>
+/// <param name="">none</param>
+/// <returns>drive level DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX</returns>
+uint8_t DripRateControllerClass::GetLevel ( void )
+{
+	return m_uiLevel;
+}
+
+/// <summary>
+/// Called with the measured interval between work units, calculates new drive level. Called from interrupt so uses shifts not division.
+/// <para>A positive error (drips too slow) raises the drive level, a negative error lowers it. The integral term is clamped so the output
+/// stays in range, this prevents wind up when the motor cannot go any faster (e.g. oil tank empty)</para>
+/// </summary>
+/// <param name="ulIntervalms">milliseconds since previous work unit</param>
+/// <returns>new drive level</returns>
+uint8_t DripRateControllerClass::Update ( uint32_t ulIntervalms )
+{
+	if ( IsEnabled () )
+	{
+		const int32_t lMaxIntegral = (int32_t)( DRIVE_LEVEL_MAX - m_uiBaseLevel ) << DRIP_CONTROL_GAIN_SHIFT;
+		const int32_t lMinIntegral = (int32_t)( DRIVE_LEVEL_MIN - m_uiBaseLevel ) << DRIP_CONTROL_GAIN_SHIFT;
+
+		int32_t lError = ulIntervalms > (uint32_t)( m_uiTargetIntervalms + DRIP_CONTROL_MAX_ERROR ) ? DRIP_CONTROL_MAX_ERROR : (int32_t)ulIntervalms - m_uiTargetIntervalms;
+		if ( lError < -DRIP_CONTROL_MAX_ERROR )
+		{
+			lError = -DRIP_CONTROL_MAX_ERROR;
+		}
+
+		m_lIntegral += lError * m_uiKi;
+		if ( m_lIntegral > lMaxIntegral )
+		{
+			m_lIntegral = lMaxIntegral;
+		}
+		else if ( m_lIntegral < lMinIntegral )
+		{
+			m_lIntegral = lMinIntegral;
+		}
+
+		int32_t lLevel = (int32_t)m_uiBaseLevel + ( ( lError * m_uiKp + m_lIntegral ) >> DRIP_CONTROL_GAIN_SHIFT );
+		if ( lLevel > DRIVE_LEVEL_MAX )
+		{
+			lLevel = DRIVE_LEVEL_MAX;
+		}
+		else if ( lLevel < DRIVE_LEVEL_MIN )
+		{
+			lLevel = DRIVE_LEVEL_MIN;
+		}
+		m_uiLevel = (uint8_t)lLevel;
+	}
+	return m_uiLevel;
+}
@@ -0,0 +1,47 @@
+// DripRateController.h
+//
+// (c) 2021 Mark Naylor
+//
+// defines a fixed point PI controller used by an oiler motor to hold a target rate of work units (i.e. oil drips)
+//
+// The controller is fed the interval in milliseconds between consecutive valid work signals and returns a drive level (0 - 255) that the motor
+// maps onto its own actuator, e.g. step interval for a stepper motor or PWM duty for a dc motor. Cold (viscous) oil drips slowly so the interval
+// grows and the drive level is raised, warm oil drips quickly and the drive level is lowered. This bounds the time taken to complete an oiling cycle.
+//
+// All arithmetic is integer only, gains are scaled by 1 / 2^DRIP_CONTROL_GAIN_SHIFT, as Update is called from the work pin interrupt routine.
+//
+#ifndef _DRIPRATECONTROLLER_h
+#define _DRIPRATECONTROLLER_h
+
+#include <Arduino.h>
+
+#define		DRIVE_LEVEL_MIN				1				// lowest drive level a motor is asked to run at, 0 would stop the motor
+#define		DRIVE_LEVEL_NOMINAL			128				// drive level at which a stepper runs at its configured speed
+// a relay motor only runs below DRIVE_LEVEL_MAX on a PWM pin not driven by timer 2 (pins 3 and 11 on an Uno), as that timer makes the library's tick
+#define		DRIVE_LEVEL_MAX				255				// full drive, e.g. dc motor switched fully on
+#define		DRIP_CONTROL_GAIN_SHIFT		8				// gains are in units of 1/256 drive level per millisecond of error
+#define		DRIP_CONTROL_KP				4				// default proportional gain
+#define		DRIP_CONTROL_KI				1				// default integral gain
+#define		DRIP_CONTROL_MAX_ERROR		30000L			// milliseconds, error is clamped to this to avoid overflow of fixed point terms
+
+class DripRateControllerClass
+{
+public:
+	DripRateControllerClass ( void );
+	void		Enable ( uint16_t uiTargetIntervalms, uint8_t uiKp, uint8_t uiKi, uint8_t uiStartLevel );	// start controlling to target interval between work units
+	void		Disable ( void );
+	bool		IsEnabled ( void );
+	uint16_t	GetTargetInterval ( void );
+	uint8_t		GetLevel ( void );
+	uint8_t		Update ( uint32_t ulIntervalms );			// Process a newly measured interval and return new drive level
+
+protected:
+	uint16_t	m_uiTargetIntervalms;						// required time between work units in ms, 0 => controller disabled
+	uint8_t		m_uiKp;										// proportional gain, scaled by 1 / 2^DRIP_CONTROL_GAIN_SHIFT
+	uint8_t		m_uiKi;										// integral gain, scaled by 1 / 2^DRIP_CONTROL_GAIN_SHIFT
+	uint8_t		m_uiBaseLevel;								// drive level when controller was enabled, output is relative to this
+	uint8_t		m_uiLevel;									// last output drive level
+	int32_t		m_lIntegral;								// accumulated Ki * error, scaled by 2^DRIP_CONTROL_GAIN_SHIFT
+};
+
+#endif
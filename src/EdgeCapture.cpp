@@ -0,0 +1,200 @@
+// EdgeCapture.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements capture of pin edges to a ring buffer and writing them as an edge trace
+//
+#include "EdgeCapture.h"
+
+EdgeCaptureClass* EdgeCaptureClass::m_pCapturing = 0;
+
+/// <summary>
+/// initialises capture with no pins
+/// </summary>
+/// <param name="pEdges">array of uiSize port changes</param>
+/// <param name="uiSize">number of port changes, must be a power of 2 and no more than 128. Holds uiSize - 1 as one slot separates head from tail</param>
+EdgeCaptureClass::EdgeCaptureClass ( EDGE* pEdges, uint8_t uiSize ) : m_Edges ( pEdges, uiSize )
+{
+	m_uiPinCount		= 0;
+	m_ulLastTimeus		= 0;
+	m_ulStartus			= 0;
+	m_bHeaderWritten	= false;
+	for ( uint8_t i = 0; i < NUM_PCI_PORTS; i++ )
+	{
+		m_uiCaptureMask [ i ] = 0;
+		m_uiLastPins [ i ] = 0;
+	}
+}
+
+/// <summary>
+/// Adds a pin to capture, its pin change interrupt is enabled if it is not already. The pin's mode is left as set by its owner
+/// </summary>
+/// <param name="uiPin">digital pin number</param>
+/// <returns>true if added, false if not a pin change interrupt pin, already added or MAX_CAPTURE_PINS are captured</returns>
+bool EdgeCaptureClass::AddPin ( uint8_t uiPin )
+{
+	bool bResult = false;
+	uint8_t uiPort = digitalPinToPort ( uiPin );
+	volatile uint8_t* pPCMSK = digitalPinToPCMSK ( uiPin );
+	if ( uiPort >= 2 && uiPort < 2 + NUM_PCI_PORTS && pPCMSK != 0 && m_uiPinCount < MAX_CAPTURE_PINS && !( m_uiCaptureMask [ uiPort - 2 ] & digitalPinToBitMask ( uiPin ) ) )
+	{
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		m_Pins [ m_uiPinCount ].uiPin	= uiPin;
+		m_Pins [ m_uiPinCount ].uiPort	= uiPort;
+		m_Pins [ m_uiPinCount ].uiMask	= digitalPinToBitMask ( uiPin );
+		m_uiCaptureMask [ uiPort - 2 ] |= m_Pins [ m_uiPinCount ].uiMask;
+		m_uiPinCount++;
+		*pPCMSK |= ( 1 << digitalPinToPCMSKbit ( uiPin ) );
+		*digitalPinToPCICR ( uiPin ) |= ( 1 << digitalPinToPCICRbit ( uiPin ) );
+		SREG = uiSREG;
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Starts capturing, anything captured before is discarded. The levels of the pins now are the start of the trace
+/// </summary>
+/// <param name="">none</param>
+void EdgeCaptureClass::Start ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_Edges.Clear ();
+	m_bHeaderWritten	= false;
+	m_ulStartus			= micros ();
+	m_ulLastTimeus		= m_ulStartus;
+	for ( uint8_t i = 0; i < NUM_PCI_PORTS; i++ )
+	{
+		m_uiLastPins [ i ] = *portInputRegister ( i + 2 );
+	}
+	m_pCapturing = this;
+	PCIHandlerClass::SetPortChangeHook ( PortChanged );
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Stops capturing, edges already captured can still be written
+/// </summary>
+/// <param name="">none</param>
+void EdgeCaptureClass::Stop ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	if ( m_pCapturing == this )
+	{
+		m_pCapturing = 0;
+		PCIHandlerClass::SetPortChangeHook ( 0 );
+	}
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Checks if this is capturing, i.e. started and not since stopped or replaced by another started capture
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if capturing, else false</returns>
+bool EdgeCaptureClass::IsCapturing ( void )
+{
+	return m_pCapturing == this;
+}
+
+/// <summary>
+/// Called by the pin change interrupt with every port change, queues it only if a captured pin changed
+/// </summary>
+/// <param name="uiPort">port that changed, 2 - 4</param>
+/// <param name="uiPortPins">levels of pins on port</param>
+/// <param name="uiChangedPins">pins that changed</param>
+void EdgeCaptureClass::PortChanged ( uint8_t uiPort, uint8_t uiPortPins, uint8_t uiChangedPins )
+{
+	if ( uiChangedPins & m_pCapturing->m_uiCaptureMask [ uiPort - 2 ] )
+	{
+		EDGE Edge;
+		Edge.ulTimeus	= micros ();
+		Edge.uiPort		= uiPort;
+		Edge.uiPortPins	= uiPortPins;
+		m_pCapturing->m_Edges.Push ( Edge );
+	}
+}
+
+/// <summary>
+/// Writes the edges captured since last called, to be called from loop() e.g. when asked for over Serial. After Start the trace header and the
+/// starting level of each captured pin are written first. The bytes written by successive calls together form one trace
+/// </summary>
+/// <param name="Output">where to write, e.g. Serial</param>
+/// <returns>number of edges written</returns>
+uint16_t EdgeCaptureClass::WriteTrace ( Print& Output )
+{
+	uint16_t uiResult = 0;
+	if ( !m_bHeaderWritten )
+	{
+		const uint8_t Header [] = { 'O', 'T', 'R', 'C', CAPTURE_TRACE_VERSION, 0, 0, 0,
+			(uint8_t)CAPTURE_TICKS_PER_SEC, (uint8_t)( CAPTURE_TICKS_PER_SEC >> 8 ), (uint8_t)( CAPTURE_TICKS_PER_SEC >> 16 ), (uint8_t)( CAPTURE_TICKS_PER_SEC >> 24 ) };
+		Output.write ( Header, sizeof ( Header ) );
+		for ( uint8_t i = 0; i < m_uiPinCount; i++ )
+		{
+			WriteEdge ( Output, m_ulStartus, m_Pins [ i ].uiPin, ( m_uiLastPins [ m_Pins [ i ].uiPort - 2 ] & m_Pins [ i ].uiMask ) ? HIGH : LOW );
+		}
+		m_bHeaderWritten = true;
+	}
+
+	EDGE Edge;
+	while ( m_Edges.Pop ( &Edge ) )
+	{
+		// one edge for each captured pin that changed
+		uint8_t uiChanged = ( Edge.uiPortPins ^ m_uiLastPins [ Edge.uiPort - 2 ] ) & m_uiCaptureMask [ Edge.uiPort - 2 ];
+		for ( uint8_t i = 0; i < m_uiPinCount; i++ )
+		{
+			if ( m_Pins [ i ].uiPort == Edge.uiPort && ( uiChanged & m_Pins [ i ].uiMask ) )
+			{
+				WriteEdge ( Output, Edge.ulTimeus, m_Pins [ i ].uiPin, ( Edge.uiPortPins & m_Pins [ i ].uiMask ) ? HIGH : LOW );
+				uiResult++;
+			}
+		}
+		m_uiLastPins [ Edge.uiPort - 2 ] = Edge.uiPortPins;
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// Writes an edge record, the time since the previous edge as a varint then the pin and level
+/// </summary>
+/// <param name="Output">where to write</param>
+/// <param name="ulTimeus">micros of edge</param>
+/// <param name="uiPin">pin</param>
+/// <param name="uiLevel">level of pin after edge</param>
+void EdgeCaptureClass::WriteEdge ( Print& Output, uint32_t ulTimeus, uint8_t uiPin, uint8_t uiLevel )
+{
+	uint8_t Record [ 6 ];
+	uint8_t uiLength = 0;
+	uint32_t ulDelta = ulTimeus - m_ulLastTimeus;			// unsigned so correct across micros wrapping
+	do
+	{
+		Record [ uiLength++ ] = (uint8_t)( ( ulDelta & 0x7F ) | ( ulDelta > 0x7F ? 0x80 : 0 ) );
+		ulDelta >>= 7;
+	} while ( ulDelta != 0 );
+	Record [ uiLength++ ] = ( uiPin & 0x7F ) | ( uiLevel == HIGH ? 0x80 : 0 );
+	Output.write ( Record, uiLength );
+	m_ulLastTimeus = ulTimeus;
+}
+
+/// <summary>
+/// Gets the number of port changes dropped because the buffer was full since Start, stops at 0xFFFF
+/// </summary>
+/// <param name="">none</param>
+/// <returns>count of dropped port changes</returns>
+uint16_t EdgeCaptureClass::GetOverflowCount ( void )
+{
+	return m_Edges.GetOverflowCount ();
+}
+
+/// <summary>
+/// Gets the most port changes that have been waiting to be written at once since Start
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of port changes</returns>
+uint8_t EdgeCaptureClass::GetHighWater ( void )
+{
+	return m_Edges.GetHighWater ();
+}
@@ -0,0 +1,67 @@
+// EdgeCapture.h
+//
+// (c) 2021 Mark Naylor
+//
+// Records the timing of signals on chosen pins, e.g. drip sensors and the spindle, so that real shop floor timing can be replayed by the host
+// tools (extras/sim). The pin change interrupt routine only copies the time, port and port pins into a ring buffer when a captured pin changes,
+// and WriteTrace(), called from loop(), turns them into pin edges and writes them in the binary edge trace format of extras/sim/EdgeTrace.h
+// to e.g. Serial. The bytes written, saved to a file, can be given to oiler_sim --replay.
+//
+// The ring buffer is a RingBufferClass as used by EventQueueClass, the interrupt routine is the producer and loop() the consumer, if it is full the
+// edge is dropped and counted. Storage is provided by the owner so the size is fixed at compile time, the size must be a power of 2 and no more than 128.
+// Times are micros so edges must be no more than 71 minutes apart, and captured pins must have their pin change interrupt enabled, as pins
+// monitored by the oiler or TheMachine do, or AddPin enables it.
+//
+// This is in its own file so it is only linked into sketches that use it, PCIHandler only calls it through a function pointer set by Start().
+//
+#ifndef _EDGECAPTURE_h
+#define _EDGECAPTURE_h
+
+#include <Arduino.h>
+#include "PCIHandler.h"
+#include "RingBuffer.h"
+
+#define		MAX_CAPTURE_PINS		8								// pins that can be captured at once
+#define		CAPTURE_TRACE_VERSION	1								// trace format version written, see extras/sim/EdgeTrace.h
+#define		CAPTURE_TICKS_PER_SEC	1000000UL						// trace times are micros
+
+class EdgeCaptureClass
+{
+public:
+	typedef struct
+	{
+		uint32_t		ulTimeus;									// micros when port changed
+		uint8_t			uiPort;										// port that changed, 2 - 4
+		uint8_t			uiPortPins;									// levels of all pins on port after change
+	} EDGE;
+
+	EdgeCaptureClass ( EDGE* pEdges, uint8_t uiSize );
+	bool		AddPin ( uint8_t uiPin );							// capture signal on digital pin
+	void		Start ( void );										// start capturing, trace starts with level of each pin
+	void		Stop ( void );
+	bool		IsCapturing ( void );
+	uint16_t	WriteTrace ( Print& Output );						// write edges captured so far, the header first after Start, returns edges written
+	uint16_t	GetOverflowCount ( void );							// number of port changes dropped as buffer was full
+	uint8_t		GetHighWater ( void );								// most port changes that have been waiting at once
+
+protected:
+	static void	PortChanged ( uint8_t uiPort, uint8_t uiPortPins, uint8_t uiChangedPins );	// called by pin change interrupt
+	void		WriteEdge ( Print& Output, uint32_t ulTimeus, uint8_t uiPin, uint8_t uiLevel );
+
+	RingBufferClass<EDGE>	m_Edges;								// port changes, pushed by interrupt and popped by WriteTrace
+	uint8_t				m_uiCaptureMask [ NUM_PCI_PORTS ];			// pins captured on each port
+	struct
+	{
+		uint8_t			uiPin;
+		uint8_t			uiPort;
+		uint8_t			uiMask;
+	} m_Pins [ MAX_CAPTURE_PINS ];
+	uint8_t				m_uiPinCount;
+	uint8_t				m_uiLastPins [ NUM_PCI_PORTS ];				// port levels as of the last edge written
+	uint32_t			m_ulLastTimeus;								// time of the last edge written
+	uint32_t			m_ulStartus;
+	bool				m_bHeaderWritten;
+	static EdgeCaptureClass*	m_pCapturing;						// capture PortChanged records to, only one captures at a time
+};
+
+#endif
@@ -0,0 +1,31 @@
+// EventQueue.cpp
+//
+// (c) 2021 Mark Naylor
+//
+// implements single producer, single consumer ring buffer of events
+//
+#include "EventQueue.h"
+
+/// <summary>
+/// initialises an empty queue
+/// </summary>
+/// <param name="pEvents">array of uiSize events</param>
+/// <param name="uiSize">number of events, must be a power of 2 and no more than 128. Holds uiSize - 1 events as one slot separates head from tail</param>
+EventQueueClass::EventQueueClass ( EVENT* pEvents, uint8_t uiSize ) : RingBufferClass<QUEUED_EVENT> ( pEvents, uiSize )
+{
+}
+
+/// <summary>
+/// Adds event to queue stamped with the time now, must only be called from one context at a time e.g. interrupt routines
+/// </summary>
+/// <param name="uiEvent">type of event</param>
+/// <param name="uiIndex">e.g. motor the event is for</param>
+/// <returns>false if queue full and event dropped, else true</returns>
+bool EventQueueClass::Push ( uint8_t uiEvent, uint8_t uiIndex )
+{
+	EVENT Event;
+	Event.ulTime	= millis ();
+	Event.uiEvent	= uiEvent;
+	Event.uiIndex	= uiIndex;
+	return RingBufferClass<QUEUED_EVENT>::Push ( Event );
+}
@@ -0,0 +1,33 @@
+// EventQueue.h
+//
+// (c) 2021 Mark Naylor
+//
+// defines a ring buffer of small timestamped events passed from interrupt routines to loop(), the ring itself is RingBufferClass so interrupt
+// routines are the single producer, loop() the single consumer and the queue needs no locking.
+//
+// If the queue is full the event is dropped and counted so that the queue size can be tuned, as can the high water mark.
+// Storage is provided by the owner so the size is fixed at compile time, the size must be a power of 2 and no more than 128.
+//
+#ifndef _EVENTQUEUE_h
+#define _EVENTQUEUE_h
+
+#include <Arduino.h>
+#include "RingBuffer.h"
+
+typedef struct
+{
+	uint32_t		ulTime;							// millis when event happened
+	uint8_t			uiEvent;						// type of event, defined by owner
+	uint8_t			uiIndex;						// e.g. motor the event is for
+} QUEUED_EVENT;
+
+class EventQueueClass : public RingBufferClass<QUEUED_EVENT>
+{
+public:
+	typedef QUEUED_EVENT EVENT;
+
+	EventQueueClass ( EVENT* pEvents, uint8_t uiSize );
+	bool		Push ( uint8_t uiEvent, uint8_t uiIndex );	// called by producer, false if full and event dropped
+};
+
+#endif
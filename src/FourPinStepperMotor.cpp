@@ -23,19 +23,30 @@ uint8_t  PhaseSigs [ NUM_PHASES ][ NUM_PINS ] =
 };
 
 
-// List of 4 pin stepper motor instances used by timer callback interrupt routine
-MOTOR_INSTANCES MotorInstances = { 0, {0,0,0,0,0,0} };
+// List of 4 pin stepper instances used by timer callback interrupt routine
+FourPinStepperDriverClass* FourPinStepperDriverClass::m_pFirstInstance = 0;
 
-// The following function is called by the timer and is used to check if any 4 pin stepper motors need signals output to move to the next step
+// The following function is called by the timer every tick and is used to check if any 4 pin stepper motors need signals output to move to the
+// next step, each stepper steps at its own interval so drive levels can change the rate of any one of them
+// coil changes made to expander outputs are collected in its frame and sent in one burst once all motors are processed
 void MotorCallback ( void )
 {
-    for ( uint8_t i = 0; i < MotorInstances.uiCount; i++ )
+    for ( FourPinStepperDriverClass* pStepper = FourPinStepperDriverClass::m_pFirstInstance; pStepper != 0; pStepper = pStepper->m_pNextInstance )
     {
-        MotorInstances.pMotor [ i ]->NextStep ();
+        pStepper->NextStep ();
     }
+    TheOutputExpander.Flush ();
 }
 
-FourPinStepperMotorClass::FourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint16_t ulTimeThreshold ) : OilerMotorClass ( uiWorkPin, ulWorkThreshold, ulDebouncems, ulSpeed, ulTimeThreshold )
+FourPinStepperMotorClass::FourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold ) : FourPinStepperMotorImplClass<OilerMotorClass> ( uiPin1, uiPin2, uiPin3, uiPin4, uiWorkPin, ulWorkThreshold, ulDebouncems, ulSpeed, ulTimeThreshold )
+{
+}
+
+StaticFourPinStepperMotorClass::StaticFourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold ) : FourPinStepperMotorImplClass<OilerMotorLogicClass<StaticFourPinStepperMotorClass>> ( uiPin1, uiPin2, uiPin3, uiPin4, uiWorkPin, ulWorkThreshold, ulDebouncems, ulSpeed, ulTimeThreshold )
+{
+}
+
+FourPinStepperDriverClass::FourPinStepperDriverClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, MotorClass* pMotor )
 {
     m_uiPins [ 0 ] = uiPin1;
     m_uiPins [ 1 ] = uiPin2;
@@ -44,120 +55,135 @@ FourPinStepperMotorClass::FourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiP
     m_ulStepInterval = ulSpeed;
     m_uiPhase = 0;
     m_ulLastStepTime = 0;
-    m_eState = STOPPED;
-    MotorInstances.pMotor [ MotorInstances.uiCount++ ] = this;
-    // Set pins to output to driver
+    m_ulNextStepTime = 0;
+    m_pMotor = pMotor;
+    m_pNextInstance = m_pFirstInstance;
+    m_pFirstInstance = this;
+    // Set pins to output to driver, expander outputs need no configuration
     for ( uint8_t uiPin = 0; uiPin < NUM_PINS; uiPin++ )
     {
-        pinMode ( m_uiPins [ uiPin ], OUTPUT );
+        if ( !OutputExpanderClass::IsExpanderPin ( m_uiPins [ uiPin ] ) )
+        {
+            pinMode ( m_uiPins [ uiPin ], OUTPUT );
+        }
     }
 }
 
 /// <summary>
-/// Motor specific function to idle motor
+/// Removes the stepper from the list stepped by the timer callback, e.g. when a motor that could not be added to an oiler is destroyed
 /// </summary>
-void FourPinStepperMotorClass::Idle ()
+FourPinStepperDriverClass::~FourPinStepperDriverClass ( void )
 {
-    // Idle motor, same as power off
-    // PowerOff (); - not sure this is necessary, if state is not moving we won't change stepper pins so motor is then effectively idle
-}
-
-/// <summary>
-/// Motor specific function to Start motor
-/// </summary>
-void FourPinStepperMotorClass::Start ()
-{
-    // Start motor - for relay this means switch on
-    On ();
-}
-
-/// <summary>
-/// Motor specific function to power off
-/// </summary>
-void FourPinStepperMotorClass::PowerOff ()
-{
-    // power off motor - for 4 pin stepper this means drive all signals LOW
-    Off ();
+    uint8_t uiSREG = SREG;
+    noInterrupts ();
+    FourPinStepperDriverClass** ppInstance = &m_pFirstInstance;
+    while ( *ppInstance != 0 && *ppInstance != this )
+    {
+        ppInstance = &( *ppInstance )->m_pNextInstance;
+    }
+    if ( *ppInstance != 0 )
+    {
+        *ppInstance = m_pNextInstance;
+    }
+    SREG = uiSREG;
 }
 
-void FourPinStepperMotorClass::SetDirection ( eDirection Direction )
+// sets us between steps, may be called from main code (e.g. the drip rate controller run by Poll () in deferred mode) whilst the timer
+// interrupt steps the motor, so the 32 bit value is written with interrupts off
+void FourPinStepperDriverClass::SetStepInterval ( uint32_t ulInterval )
 {
-    MotorClass::SetDirection ( Direction );
+    uint8_t uiSREG = SREG;
+    noInterrupts ();
+    m_ulStepInterval = ulInterval;
+    SREG = uiSREG;
 }
 
 /// <summary>
-/// Turn stepper motor on. energise pins and ensure timer is set up to make next step
+/// energise pins and ensure timer is set up to make next step
 /// </summary>
 /// <param name="">none</param>
 /// <returns>true if new timer callback created</returns>
-bool FourPinStepperMotorClass::On ( void )
+bool FourPinStepperDriverClass::Start ( void )
 {
-    // Set up callback to increment motor steps
-    bool bResult = false;
-    if ( !IsMoving() )
-    {
-        PowerUp ();
-        OilerMotorClass::On ();
-
-        bResult = TheTimer.AddCallBack ( MotorCallback, ( m_ulStepInterval / ( 1000000 / RESOLUTION ) + 1 ) );
-    }
-    return bResult;
+    PowerUp ();
+    // Set up callback to increment motor steps, every tick as the one callback serves all steppers whatever their step interval
+    return TheTimer.AddCallBack ( MotorCallback, 1 );
 }
 
-bool FourPinStepperMotorClass::Off ( void )
+// de-energise all coils, in one critical section so a timer interrupt cannot flush the expander with only some coils changed
+void FourPinStepperDriverClass::Stop ( void )
 {
+    uint8_t uiSREG = SREG;
+    noInterrupts ();
     for ( uint8_t uiPin = 0; uiPin < NUM_PINS; uiPin++ )
     {
-        digitalWrite ( m_uiPins [ uiPin ], LOW );
+        WritePin ( m_uiPins [ uiPin ], LOW );
     }
+    TheOutputExpander.Flush ();
     m_ulLastStepTime = micros ();
-    m_eState = STOPPED;
-    
-    return OilerMotorClass::Off (); 
+    SREG = uiSREG;
 }
-
 // decrements phase and resets to NUM_PHASES - 1 when at 0
-void FourPinStepperMotorClass::StepCW ( void )
+void FourPinStepperDriverClass::StepCW ( void )
 {
     MoveStepper ( ( m_uiPhase + ( NUM_PHASES - 1 ) ) % NUM_PHASES );
 }
 
 // increments phase and resets to 0 when > 7
-void FourPinStepperMotorClass::StepCCW ( void )
+void FourPinStepperDriverClass::StepCCW ( void )
 {
     MoveStepper ( ( m_uiPhase + 1 ) % NUM_PHASES );
 }
 
-void FourPinStepperMotorClass::MoveStepper ( uint8_t uiPhase )
+void FourPinStepperDriverClass::MoveStepper ( uint8_t uiPhase )
 {
     for ( uint8_t uiPin = 0; uiPin < NUM_PINS; uiPin++ )
     {
-        digitalWrite ( m_uiPins [ uiPin ], PhaseSigs [ uiPhase ][ uiPin ] );
+        WritePin ( m_uiPins [ uiPin ], PhaseSigs [ uiPhase ][ uiPin ] );
     }
     m_uiPhase = uiPhase;
     m_ulLastStepTime = micros ();
-    m_ulNextStepTime = m_ulLastStepTime + m_ulStepInterval;
 }
 
-// powers pins at current step pin config to get ready for move
-void FourPinStepperMotorClass::PowerUp ( void )
+// sets a coil signal, expander outputs are only updated in the expander frame and sent when it is next flushed
+void FourPinStepperDriverClass::WritePin ( uint8_t uiPin, uint8_t uiLevel )
+{
+    if ( OutputExpanderClass::IsExpanderPin ( uiPin ) )
+    {
+        TheOutputExpander.WritePin ( uiPin, uiLevel );
+    }
+    else
+    {
+        digitalWrite ( uiPin, uiLevel );
+    }
+}
+
+// powers pins at current step pin config to get ready for move, in one critical section as Stop ()
+void FourPinStepperDriverClass::PowerUp ( void )
 {
+    uint8_t uiSREG = SREG;
+    noInterrupts ();
     MoveStepper ( m_uiPhase );
+    m_ulNextStepTime = m_ulLastStepTime + m_ulStepInterval;
+    TheOutputExpander.Flush ();
+    SREG = uiSREG;
 }
 
-uint32_t FourPinStepperMotorClass::GetNextStepTime ( void )
+uint32_t FourPinStepperDriverClass::GetNextStepTime ( void )
 {
     return m_ulNextStepTime;
 }
 
-// send signals for next step if time has elapsed
-void FourPinStepperMotorClass::NextStep ( void )
+// send signals for next step if time has elapsed. Steps are due a whole interval apart, not an interval after the tick that made the last
+// one, so the step rate is the configured one and not rounded down to whole ticks
+void FourPinStepperDriverClass::NextStep ( void )
 {
-    if ( IsMoving() )
+    if ( m_pMotor->GetMotorState () == MotorClass::RUNNING )
     {
-        if ( micros () > GetNextStepTime () )
+        uint32_t ulNow = micros ();
+        if ( (int32_t)( ulNow - GetNextStepTime () ) >= 0 )
         {
-            if ( m_eDir == FORWARD )
+            if ( m_pMotor->GetDirection () == MotorClass::FORWARD )
             {
                 StepCW ();
             }
@@ -165,6 +191,12 @@ void FourPinStepperMotorClass::NextStep ( void )
             {
                 StepCCW ();
             }
+            m_ulNextStepTime += m_ulStepInterval;
+            // if steps were held up, e.g. interrupts were off, carry on from now rather than catching up in a burst
+            if ( (int32_t)( ulNow - m_ulNextStepTime ) >= 0 )
+            {
+                m_ulNextStepTime = ulNow + m_ulStepInterval;
+            }
         }
     }
 }
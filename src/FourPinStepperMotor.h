@@ -3,6 +3,10 @@
 //
 //	Defines 4 pin stepper motor as derivative of Motor
 //
+//	FourPinStepperDriverClass outputs the coil signals, FourPinStepperMotorImplClass adds it to an oiler motor and is shared by
+//		FourPinStepperMotorClass		virtual version, can be used wherever an OilerMotorClass is expected
+//		StaticFourPinStepperMotorClass	static version, all calls are resolved at compile time
+//
 // (c) Mark Naylor 2021
 //
 
@@ -11,7 +15,8 @@
 
 #include <Arduino.h>
 #include "OilerMotor.h"
-#include "OilerLib.h"
+#include "OutputExpander.h"
+#include "Timer.h"
 
 #define NUM_PINS        4
 #define HALF_STEPS      2
@@ -19,42 +24,160 @@
 #define STEPPER_MODE    HALF_STEPS
 #define NUM_PHASES      ( NUM_PINS * STEPPER_MODE )
 
-class FourPinStepperMotorClass : public OilerMotorClass
+class FourPinStepperDriverClass
 {
 public:
 
-    FourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint16_t ulTimeThreshold );
-    void            SetDirection ( eDirection Direction );
+    FourPinStepperDriverClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, MotorClass* pMotor );
+    ~FourPinStepperDriverClass ( void );                    // removes stepper from those stepped by the timer
+    bool            Start ( void );                         // energise pins and ensure timer is stepping motor
+    void            Stop ( void );                          // drive all pins LOW
+    void            SetStepInterval ( uint32_t ulInterval );
     void            NextStep ( void );
 
-    // Machine specific implmentation of base virtual pure functions
-    void			Idle ();
-    void			Start ();
-    void			PowerOff ();
-
-    bool            On ( void );
-    bool            Off ( void );
-
 protected:
                     uint8_t         m_uiPins [ NUM_PINS ];  // Array of pins used to output signals to stepper driver
     volatile        uint8_t         m_uiPhase;              // The current phase of stepper (in half mode we have 8 phases numbered 0 - 7)
                     uint32_t        m_ulStepInterval;       // the delay time between micros
                     uint32_t        m_ulLastStepTime;       // the last step time in micros
                     uint32_t        m_ulNextStepTime;       // time next step due in micros
+                    MotorClass*     m_pMotor;               // motor being driven, gives running state and direction
 
     void            StepCW ( void );                        // Move motor 1 step in clockwise direction
     void            StepCCW ( void );                       // Move motor 1 step in conunter clock wise direction
     void            MoveStepper ( uint8_t uiPhase );        // Send stepper signals
+    void            WritePin ( uint8_t uiPin, uint8_t uiLevel );    // set level of native or expander output
     void            PowerUp ( void );                       // powers pins at current step pin config to get ready for move
     uint32_t        GetNextStepTime ( void );
 
+    // used by timer callback interrupt routine to find all instances of stepper, no limit on number of instances
+    static          FourPinStepperDriverClass*  m_pFirstInstance;   // most recently created instance
+                    FourPinStepperDriverClass*  m_pNextInstance;    // instance created before this one
+
+    friend void     MotorCallback ( void );
 };
 
-// used by interrupt routine to find all instances of motor
-typedef struct
+template <class TBase>
+class FourPinStepperMotorImplClass : public TBase
+{
+public:
+
+    FourPinStepperMotorImplClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold );
+    void            SetDirection ( MotorClass::eDirection Direction );
+    void            NextStep ( void );
+
+    // Machine specific implmentation of functions called by oiler motor state machine
+    void			Idle ();
+    void			Start ();
+    void			PowerOff ();
+    void            SetDriveLevel ( uint8_t uiLevel );      // scales step interval, DRIVE_LEVEL_NOMINAL runs at configured speed
+
+    bool            On ( void );
+    bool            Off ( void );
+
+protected:
+    FourPinStepperDriverClass   m_Stepper;                  // outputs coil signals
+};
+
+class FourPinStepperMotorClass : public FourPinStepperMotorImplClass<OilerMotorClass>
+{
+public:
+    FourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold );
+};
+
+class StaticFourPinStepperMotorClass : public FourPinStepperMotorImplClass<OilerMotorLogicClass<StaticFourPinStepperMotorClass>>
+{
+public:
+    StaticFourPinStepperMotorClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold );
+};
+
+template <class TBase>
+FourPinStepperMotorImplClass<TBase>::FourPinStepperMotorImplClass ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulTimeThreshold ) : TBase ( uiWorkPin, ulWorkThreshold, ulDebouncems, ulSpeed, ulTimeThreshold ), m_Stepper ( uiPin1, uiPin2, uiPin3, uiPin4, ulSpeed, this )
+{
+    this->m_uiDriveLevel = DRIVE_LEVEL_NOMINAL;
+}
+
+/// <summary>
+/// Motor specific function to idle motor
+/// </summary>
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::Idle ()
+{
+    // Idle motor, same as power off
+    // PowerOff (); - not sure this is necessary, if state is not moving we won't change stepper pins so motor is then effectively idle
+}
+
+/// <summary>
+/// Motor specific function to Start motor
+/// </summary>
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::Start ()
+{
+    On ();
+}
+
+/// <summary>
+/// Motor specific function to power off
+/// </summary>
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::PowerOff ()
+{
+    // power off motor - for 4 pin stepper this means drive all signals LOW
+    Off ();
+}
+
+/// <summary>
+/// Sets the drive level, step interval is scaled so that DRIVE_LEVEL_NOMINAL gives the configured speed, higher levels step faster
+/// </summary>
+/// <param name="uiLevel">DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX</param>
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::SetDriveLevel ( uint8_t uiLevel )
+{
+    OilerMotorBaseClass::SetDriveLevel ( uiLevel < DRIVE_LEVEL_MIN ? DRIVE_LEVEL_MIN : uiLevel );
+
+    uint32_t ulInterval = ( this->GetSpeed () * DRIVE_LEVEL_NOMINAL ) / this->GetDriveLevel ();
+    // cannot step faster than the timer callback, run every tick, checks the stepper
+    if ( ulInterval < ( 1000000UL / RESOLUTION ) )
+    {
+        ulInterval = 1000000UL / RESOLUTION;
+    }
+    m_Stepper.SetStepInterval ( ulInterval );
+}
+
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::SetDirection ( MotorClass::eDirection Direction )
+{
+    MotorClass::SetDirection ( Direction );
+}
+
+template <class TBase>
+void FourPinStepperMotorImplClass<TBase>::NextStep ( void )
+{
+    m_Stepper.NextStep ();
+}
+
+/// <summary>
+/// Turn stepper motor on. energise pins and ensure timer is set up to make next step
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if new timer callback created</returns>
+template <class TBase>
+bool FourPinStepperMotorImplClass<TBase>::On ( void )
+{
+    bool bResult = false;
+    if ( this->GetMotorState () != MotorClass::RUNNING )
+    {
+        bResult = m_Stepper.Start ();
+        TBase::On ();
+    }
+    return bResult;
+}
+
+template <class TBase>
+bool FourPinStepperMotorImplClass<TBase>::Off ( void )
 {
-    uint8_t                     uiCount;
-    FourPinStepperMotorClass* pMotor [ MAX_MOTORS ];
-} MOTOR_INSTANCES;
+    m_Stepper.Stop ();
+    return TBase::Off ();
+}
 
 #endif
@@ -0,0 +1,212 @@
+//
+//  InputExpander.cpp
+//
+// (c) Mark Naylor 2021
+//
+//	This class implements a chain of 74HC165 shift registers used as additional digital inputs, sampled by the hardware SPI from a timer callback
+//
+
+#include "InputExpander.h"
+#include "Timer.h"
+
+/// <summary>
+/// Routine called by timer to sample expander inputs - called by interrupt
+/// </summary>
+/// <param name="">none</param>
+void InputExpanderCallback ( void )
+{
+	TheInputExpander.Scan ();
+}
+
+InputExpanderClass::InputExpanderClass ( void )
+{
+	m_uiInputCount		= 0;
+	m_uiNumRegisters	= 0;
+	m_pLoadPort			= 0;
+	m_uiLoadMask		= 0;
+	memset ( m_uiFrame, 0, sizeof ( m_uiFrame ) );
+}
+
+/// <summary>
+/// Configures the SPI hardware and load pin, takes the initial sample and starts periodic sampling
+/// </summary>
+/// <param name="uiLoadPin">digital pin connected to SH/LD of all registers</param>
+/// <param name="uiNumRegisters">number of 74HC165 in chain, 1 - MAX_INPUT_EXPANDER_REGISTERS</param>
+/// <param name="uiScanTicks">number of timer ticks (1/RESOLUTION sec) between samples</param>
+/// <returns>false if parameters invalid or timer callback could not be added, else true</returns>
+bool InputExpanderClass::Begin ( uint8_t uiLoadPin, uint8_t uiNumRegisters, uint8_t uiScanTicks )
+{
+	bool bResult = false;
+	if ( uiNumRegisters > 0 && uiNumRegisters <= MAX_INPUT_EXPANDER_REGISTERS && uiLoadPin != NOT_A_PIN && uiScanTicks > 0 )
+	{
+		m_pLoadPort		= portOutputRegister ( digitalPinToPort ( uiLoadPin ) );
+		m_uiLoadMask	= digitalPinToBitMask ( uiLoadPin );
+		pinMode ( uiLoadPin, OUTPUT );
+		digitalWrite ( uiLoadPin, HIGH );
+
+		// SS must be an output to keep SPI hardware in master mode
+		pinMode ( SS, OUTPUT );
+		pinMode ( MOSI, OUTPUT );
+		pinMode ( SCK, OUTPUT );
+		pinMode ( MISO, INPUT );
+		SPCR = ( 1 << SPE ) | ( 1 << MSTR );		// enable, master, mode 0, MSB first
+		SPSR |= ( 1 << SPI2X );						// fosc/2
+
+		m_uiNumRegisters = uiNumRegisters;
+		PCIData::SetExpander ( AddExpanderPin );	// pins on expander can now be added via PCIHandler
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		ShiftIn ( m_uiFrame );						// initial levels, no callbacks
+		SREG = uiSREG;
+		bResult = TheTimer.AddCallBack ( InputExpanderCallback, uiScanTicks );
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Adds a callback to be invoked for specified expander input
+/// </summary>
+/// <param name="uiPin">expander pin number, see EXPANDER_INPUT(), must be on one of the registers given to Begin ()</param>
+/// <param name="Callback">callback to be invoked</param>
+/// <param name="uiState">change in state of interest, must be FALLING or RISING or CHANGE</param>
+/// <returns>true if added successfully else false</returns>
+bool InputExpanderClass::AddPin ( uint8_t uiPin, const PIN_CALLBACK& Callback, uint8_t uiState )
+{
+	bool bResult = false;
+	if ( IsExpanderPin ( uiPin ) && uiPin - INPUT_EXPANDER_PIN_BASE < m_uiNumRegisters * 8 && !IsPinPresent ( uiPin ) && m_uiInputCount < MAX_INPUT_EXPANDER_PINS && ( uiState == FALLING || uiState == RISING || uiState == CHANGE ) )
+	{
+		uint8_t uiInput = uiPin - INPUT_EXPANDER_PIN_BASE;
+		INPUTINFO Info;
+		Info.uiPinNum	= uiPin;
+		Info.uiRegister	= uiInput >> 3;
+		Info.uiMask		= 1 << ( uiInput & 7 );
+		Info.uiMode		= uiState;
+		Info.Callback	= Callback;
+
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		m_InputInfo [ m_uiInputCount++ ] = Info;
+		SREG = uiSREG;
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Gets level of an expander input when it was last sampled
+/// </summary>
+/// <param name="uiPin">expander pin number</param>
+/// <returns>HIGH or LOW</returns>
+uint8_t InputExpanderClass::ReadPin ( uint8_t uiPin )
+{
+	uint8_t uiInput = uiPin - INPUT_EXPANDER_PIN_BASE;
+	return ( m_uiFrame [ ( uiInput >> 3 ) % MAX_INPUT_EXPANDER_REGISTERS ] & ( 1 << ( uiInput & 7 ) ) ) ? HIGH : LOW;
+}
+
+/// <summary>
+/// Called by PCIHandler to add an expander input
+/// </summary>
+/// <param name="uiPin">expander pin number</param>
+/// <param name="Callback">callback to be invoked</param>
+/// <param name="uiState">change in state of interest, must be FALLING or RISING or CHANGE</param>
+/// <returns>true if added successfully else false</returns>
+bool InputExpanderClass::AddExpanderPin ( uint8_t uiPin, const PIN_CALLBACK& Callback, uint8_t uiState )
+{
+	return TheInputExpander.AddPin ( uiPin, Callback, uiState );
+}
+
+/// <summary>
+/// static function called by timer interrupt.
+/// <para>samples all registers and compares with previous sample to identify which inputs changed</para>
+/// <para>invokes the callback of any monitored input that changed as required by its mode</para>
+/// </summary>
+/// <param name="">none</param>
+void InputExpanderClass::Scan ( void )
+{
+	uint8_t uiNewFrame [ MAX_INPUT_EXPANDER_REGISTERS ];
+	uint8_t uiChanged [ MAX_INPUT_EXPANDER_REGISTERS ] = { 0 };		// registers not in the chain never change
+	uint8_t uiAnyChanged = 0;
+
+	ShiftIn ( uiNewFrame );
+	for ( uint8_t i = 0; i < m_uiNumRegisters; i++ )
+	{
+		uiChanged [ i ] = uiNewFrame [ i ] ^ m_uiFrame [ i ];
+		uiAnyChanged |= uiChanged [ i ];
+		m_uiFrame [ i ] = uiNewFrame [ i ];
+	}
+
+	if ( uiAnyChanged )
+	{
+		for ( uint8_t i = 0; i < m_uiInputCount; i++ )
+		{
+			// if this input has signalled
+			if ( uiChanged [ m_InputInfo [ i ].uiRegister ] & m_InputInfo [ i ].uiMask )
+			{
+				uint8_t uiState = ( uiNewFrame [ m_InputInfo [ i ].uiRegister ] & m_InputInfo [ i ].uiMask ) ? HIGH : LOW;
+				switch ( m_InputInfo [ i ].uiMode )
+				{
+					case RISING:
+						if ( uiState == HIGH )
+						{
+							m_InputInfo [ i ].Callback.Invoke ( uiState );
+						}
+						break;
+
+					case FALLING:
+						if ( uiState == LOW )
+						{
+							m_InputInfo [ i ].Callback.Invoke ( uiState );
+						}
+						break;
+
+					case CHANGE:
+						m_InputInfo [ i ].Callback.Invoke ( uiState );
+						break;
+
+					default:
+						// ignore
+						break;
+				}
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Latches all inputs into the registers and reads them, register nearest the mcu first
+/// </summary>
+/// <param name="pFrame">array of at least m_uiNumRegisters bytes to receive levels</param>
+void InputExpanderClass::ShiftIn ( uint8_t* pFrame )
+{
+	// pulse SH/LD low to load parallel inputs
+	*m_pLoadPort &= ~m_uiLoadMask;
+	*m_pLoadPort |= m_uiLoadMask;
+	for ( uint8_t i = 0; i < m_uiNumRegisters; i++ )
+	{
+		SPDR = 0;
+		while ( !( SPSR & ( 1 << SPIF ) ) );
+		pFrame [ i ] = SPDR;
+	}
+}
+
+/// <summary>
+/// Checks if expander input is already being handled
+/// </summary>
+/// <param name="uiPin">expander pin of interest</param>
+/// <returns>true if already being handled, else false</returns>
+bool InputExpanderClass::IsPinPresent ( uint8_t uiPin )
+{
+	bool bResult = false;
+
+	for ( uint8_t i = 0; i < m_uiInputCount; i++ )
+	{
+		if ( m_InputInfo [ i ].uiPinNum == uiPin )
+		{
+			bResult = true;
+			break;
+		}
+	}
+	return bResult;
+}
+
+InputExpanderClass TheInputExpander;
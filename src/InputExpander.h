@@ -0,0 +1,69 @@
+//
+//  InputExpander.h
+//
+// (c) Mark Naylor 2021
+//
+//	This class encapsulates a chain of 74HC165 parallel in / serial out shift registers read by the mcu hardware SPI
+//	Each register adds 8 digital inputs which are addressed with pin numbers starting at INPUT_EXPANDER_PIN_BASE, use EXPANDER_INPUT(n) to get the
+//	pin number of input n where input 0 is input A of the register nearest the mcu.
+//
+//	The whole chain is sampled at a fixed rate from the timer, changed inputs are found by XOR of the new frame with the previous one and the callbacks
+//	of inputs that changed as per their required mode (RISING, FALLING or CHANGE) are invoked, as PCIHandler does for pins on the mcu. Sampling cost is
+//	fixed by the number of registers not the number of inputs or how often they change.
+//
+//	Wiring (Uno): MISO (pin 12) to QH of register nearest mcu, SCK (pin 13) to CLK of all registers, load pin of choice to SH/LD of all registers,
+//	CLK INH of all registers to GND and QH of each register to SER of the one nearer the mcu. The SPI pins can be shared with the OutputExpander,
+//	as its outputs only change when latched.
+//
+//	Begin() must be called before expander inputs are used as work or machine pins, e.g. before TheOiler.AddMotor()
+//
+//	NB This is written and tested to work on the Arduino Uno
+//
+#ifndef _INPUTEXPANDER_h
+#define _INPUTEXPANDER_h
+
+#include <Arduino.h>
+#include "PCIHandler.h"
+
+#define		INPUT_EXPANDER_PIN_BASE				128									// first pin number used for expander inputs, above expander outputs
+#define		MAX_INPUT_EXPANDER_REGISTERS		8									// max number of 74HC165 in chain, gives 64 inputs
+#define		MAX_INPUT_EXPANDER_PINS				32									// max number of expander inputs that can have a callback
+#define		INPUT_EXPANDER_SCAN_TICKS			2									// default timer ticks between samples, 1 ms
+#define		EXPANDER_INPUT(n)					( INPUT_EXPANDER_PIN_BASE + (n) )	// pin number of expander input n
+
+class InputExpanderClass
+{
+public:
+	InputExpanderClass ( void );
+	bool			Begin ( uint8_t uiLoadPin, uint8_t uiNumRegisters, uint8_t uiScanTicks = INPUT_EXPANDER_SCAN_TICKS );	// configure SPI and load pin and start sampling
+	bool			AddPin ( uint8_t uiPin, const PIN_CALLBACK& Callback, uint8_t uiState );	// add expander input to be monitored, callback invoked if signal matches RISING, FALLING or CHANGE
+	uint8_t			ReadPin ( uint8_t uiPin );									// level of expander input at last sample
+	void			Scan ( void );												// sample all inputs and invoke callbacks of those that changed, called from timer
+	static inline bool IsExpanderPin ( uint8_t uiPin )							// true if pin number refers to an expander input
+	{
+		return uiPin >= INPUT_EXPANDER_PIN_BASE && uiPin < INPUT_EXPANDER_PIN_BASE + MAX_INPUT_EXPANDER_REGISTERS * 8;
+	}
+
+protected:
+	static bool		AddExpanderPin ( uint8_t uiPin, const PIN_CALLBACK& Callback, uint8_t uiState );
+	bool			IsPinPresent ( uint8_t uiPin );
+	void			ShiftIn ( uint8_t* pFrame );
+
+	struct INPUTINFO
+	{
+		uint8_t				uiPinNum;											// expander pin being monitored
+		uint8_t				uiRegister;											// index of register in chain
+		uint8_t				uiMask;												// bit of input in register
+		uint8_t				uiMode;												// RISING, FALLING or CHANGE
+		PIN_CALLBACK		Callback;											// function to call when input signals
+	} m_InputInfo [ MAX_INPUT_EXPANDER_PINS ];
+	uint8_t				m_uiInputCount;											// count of inputs being monitored
+	uint8_t				m_uiNumRegisters;										// number of registers in chain, 0 if not configured
+	volatile uint8_t*	m_pLoadPort;											// output register of port with load pin
+	uint8_t				m_uiLoadMask;											// bit of load pin on port
+	uint8_t				m_uiFrame [ MAX_INPUT_EXPANDER_REGISTERS ];				// input levels at last sample, one byte per register, bit n = input n
+};
+
+extern InputExpanderClass TheInputExpander;
+
+#endif
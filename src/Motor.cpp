@@ -37,11 +37,16 @@ uint32_t MotorClass::GetTimeMotorStarted ( void )
 }
 
 uint32_t MotorClass::GetTimeMotorRunning ( void )
+{
+	return GetTimeMotorRunningms () / 1000UL;
+}
+
+uint32_t MotorClass::GetTimeMotorRunningms ( void )
 {
 	uint32_t ulResult = 0UL;
 	if ( m_eState == RUNNING )
 	{
-		ulResult = ( millis () - m_ulTimeStartedms ) / 1000UL;
+		ulResult = millis () - m_ulTimeStartedms;
 	}
 	return ulResult;
 }
@@ -73,4 +78,8 @@ void MotorClass::SetDirection ( eDirection eDir )
 	m_eDir = eDir;
 }
 
+MotorClass::eDirection MotorClass::GetDirection ( void )
+{
+	return m_eDir;
+}
 
@@ -26,15 +26,17 @@ public:
 		STOPPED = 1, RUNNING
 	};
 
-	virtual bool	On ( void );						// Needs to be overriden to implement details of how motor is enabled
-	virtual bool	Off ( void );
+	bool			On ( void );						// records motor running, derived motors hide this to implement details of how motor is enabled
+	bool			Off ( void );
 	uint32_t		GetTimeMotorStarted ( void );		// returns millis that it started
 	uint32_t		GetTimeMotorRunning ( void );		// returns seconds it has been running, 0 if stopped
+	uint32_t		GetTimeMotorRunningms ( void );		// returns ms it has been running, 0 if stopped
 	uint32_t		GetTimeMotorStopped ( void );
 	eState			GetMotorState ( void );
 	uint32_t		GetSpeed ( void );
 	bool			SetSpeed ( uint32_t ulSpeed );
 	void			SetDirection ( eDirection eDir );
+	eDirection		GetDirection ( void );
 
 	MotorClass ( uint32_t ulSpeed );
 
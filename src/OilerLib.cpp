@@ -6,90 +6,85 @@
 #include "OilerLib.h"
 #include "Timer.h"
 #include "PCIHandler.h"
+#include <new.h>
 
 /// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 1 has produced a unit of work
+/// Callback from timer alarm set for the nearest elapsed or powered time deadline
 /// </summary>
-/// <param name="">none</param>
-void Motor1WorkSignal ( void )
-{
-	TheOiler.MotorWork ( 0 );
-}
-/// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 2 has produced a unit of work
-/// </summary>
-/// <param name="">none</param>
-void Motor2WorkSignal ( void )
+/// <param name="pContext">oiler to be checked</param>
+void OilerClass::AlarmSignal ( void* pContext )
 {
-	TheOiler.MotorWork ( 1 );
+	( (OilerClass*)pContext )->TimerDue ();
 }
 /// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 3 has produced a unit of work
+/// Callback from target machine when its count of work units reaches the nearest deadline, motors are restarted without waiting for the timer
 /// </summary>
-/// <param name="">none</param>
-void Motor3WorkSignal ( void )
+/// <param name="pContext">oiler to be checked</param>
+/// <param name="ulWorkUnits">count of work units, not used as ProcessTimerEvent reads it</param>
+void OilerClass::WorkTargetSignal ( void* pContext, uint32_t ulWorkUnits )
 {
-	TheOiler.MotorWork ( 2 );
+	( (OilerClass*)pContext )->TimerDue ();
 }
 /// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 4 has produced a unit of work
+/// Called from interrupt when a deadline may be due. Deadlines are checked now or, in deferred mode, an event is queued for Poll () unless one is already waiting.
+/// <para>the timer alarm is one shot so the check is flagged as pending even if the queue is full, Poll () then makes it once the queue is empty</para>
 /// </summary>
 /// <param name="">none</param>
-void Motor4WorkSignal ( void )
+void OilerClass::TimerDue ( void )
 {
-	TheOiler.MotorWork ( 3 );
-}
-/// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 5 has produced a unit of work
-/// </summary>
-/// <param name="">none</param>
-void Motor5WorkSignal ( void )
-{
-	TheOiler.MotorWork ( 4 );
-}
-/// <summary>
-/// Called by interrupt routine handling signal from pin indicating motor 6 has produced a unit of work
-/// </summary>
-/// <param name="">none</param>
-void Motor6WorkSignal ( void )
-{
-	TheOiler.MotorWork ( 5 );
-}
-// list of ISRs for each motor upto max allowed
-typedef void ( *Callback )( void );
-struct
-{
-	Callback MotorWorkCallback [ MAX_MOTORS ];
-} MotorISRs =
-{
-	Motor1WorkSignal,
-	Motor2WorkSignal,
-	Motor3WorkSignal,
-	Motor4WorkSignal,
-	Motor5WorkSignal,
-	Motor6WorkSignal
-};
-/// <summary>
-/// Callback from interrupt based timer to check if restart event has been met and motors need restarting
-/// </summary>
-/// <param name=""></param>
-void OilerTimerCallback ( void )
-{
-	TheOiler.ProcessTimerEvent ();
+	if ( m_bDeferred )
+	{
+		if ( !m_bTimerEventPending )
+		{
+			m_bTimerEventPending = true;
+			m_Events.Push ( EVENT_TIMER, 0 );
+		}
+	}
+	else
+	{
+		ProcessTimerEvent ();
+	}
 }
 /// <summary>
 /// initialises oiler
 /// </summary>
-/// <param name="pMachine"></param>
-OilerClass::OilerClass ( TargetMachineClass* pMachine )
+/// <param name="pMotorInfo">storage for uiMaxMotors motors</param>
+/// <param name="pDeadlines">storage for OILER_METRICS * uiMaxMotors deadlines</param>
+/// <param name="pDeadlinePos">storage for OILER_METRICS * uiMaxMotors deadline positions</param>
+/// <param name="pPendingStarts">storage for uiMaxMotors motors waiting to start</param>
+/// <param name="uiMaxMotors">number of motors that can be added</param>
+/// <param name="pEvents">storage for uiEventQueueSize events</param>
+/// <param name="uiEventQueueSize">size of event queue used in deferred mode, power of 2</param>
+/// <param name="pMachine">machine being oiled by all motors, can be NULL</param>
+OilerClass::OilerClass ( MOTOR_INFO* pMotorInfo, DeadlineQueueClass::DEADLINE* pDeadlines, uint8_t* pDeadlinePos, uint8_t* pPendingStarts, uint8_t uiMaxMotors, EventQueueClass::EVENT* pEvents, uint8_t uiEventQueueSize, TargetMachineClass* pMachine ) : m_Events ( pEvents, uiEventQueueSize )
 {
-	m_pMachine				= pMachine;
+	m_pMotorInfo			= pMotorInfo;
+	m_uiMaxMotors			= uiMaxMotors;
+	m_uiNumMachines			= 0;
+	m_uiMachine				= FindMachine ( pMachine );
 	m_OilerMode				= ON_TIME;					// default vvalue
 	m_OilerStatus			= OFF;						
-	m_uiRestartTarget		= TIME_BETWEEN_OILING;		//default value
-	m_Motors.uiNumMotors	= 0;
+	m_ulRestartTarget		= TIME_BETWEEN_OILING * 1000UL;	//default value, in ms
+	m_uiMetricsInUse		= 0;
+	for ( uint8_t i = 0; i < OILER_METRICS; i++ )
+	{
+		m_Deadlines [ i ].Begin ( pDeadlines + i * uiMaxMotors, pDeadlinePos + i * uiMaxMotors, uiMaxMotors );
+	}
+	m_uiNumMotors			= 0;
+	m_MovingMask			= 0;
+	m_IdleMask				= 0;
+	m_ErrorMask				= 0;
+	m_PendingMask			= 0;
+	m_pPendingStarts		= pPendingStarts;
+	m_uiPendingHead			= 0;
+	m_uiPendingCount		= 0;
+	m_uiStartingCount		= 0;
+	m_uiMaxMoving			= 0;
+	m_bDeferred				= false;
+	m_bTimerEventPending	= false;
 	m_uiAlertPin			= NOT_A_PIN;
 	m_ulAlertThreshold		= 0UL;
+	m_ulAlertThresholdms	= 0UL;
 	m_uiALertOnValue		= ALERT_PIN_ERROR_STATE;	// default value
 	m_bAlert				= false;
 }
@@ -101,19 +96,27 @@ bool OilerClass::On ()
 {
 	// can only start if > 0 motors!
 	bool bResult = false;
-	if ( m_Motors.uiNumMotors > 0 )
+	if ( m_uiNumMotors > 0 )
 	{
-		for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+		uint32_t ulMetricUnits [ OILER_METRICS ];
+		GetAllMetricUnits ( ulMetricUnits );
+		for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
 		{
-			OilerMotorClass* pMotor = GetOilerMotor ( i );
-			if ( !pMotor->IsMoving() )
+			if ( !GetOilerMotor ( i )->IsMoving() )
 			{
-				pMotor->Action ( OilerMotorClass::eOilerMotorEvents::TURN_ON, GetStartModeUnits() );
+				if ( CanStartMotor () )
+				{
+					MotorAction ( i, OilerMotorBaseClass::TURN_ON, ulMetricUnits [ GetMetric ( i ) ] );
+				}
+				else
+				{
+					QueueStart ( i );
+				}
 			}
 		}
 
-		TheTimer.AddCallBack ( OilerTimerCallback, RESOLUTION );		// callback once per sec
 		m_OilerStatus = OILING;
+		ScheduleTimer ();			// timer callback when first motor alert is due
 		bResult = true;
 	}
 	return bResult;
@@ -125,8 +128,7 @@ bool OilerClass::On ()
 /// <param name="uiMotorIndex"></param>
 void OilerClass::MotorWork ( uint8_t uiMotorIndex )
 {
-	OilerMotorClass* pMotor = GetOilerMotor ( uiMotorIndex );
-	if ( pMotor->Action ( OilerMotorClass::eOilerMotorEvents::WORK_SEEN, GetStartModeUnits() ) )
+	if ( MotorAction ( uiMotorIndex, OilerMotorBaseClass::WORK_SEEN, GetMotorModeUnits ( uiMotorIndex ) ) )
 	{
 		// get here if state changed
 
@@ -135,19 +137,102 @@ void OilerClass::MotorWork ( uint8_t uiMotorIndex )
 	}
 }
 
+/// <summary>
+/// Sets whether motor work and timer events are processed in the interrupt that signals them or queued for Poll () to process from loop ().
+/// Deferred mode keeps interrupts short so stepper timing has less jitter, but Poll () must be called often enough that the queue does not fill.
+/// </summary>
+/// <param name="bDeferred">true to queue events for Poll (), false to process them in interrupts</param>
+void OilerClass::SetDeferredMode ( bool bDeferred )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	if ( !bDeferred && m_bDeferred )
+	{
+		// process what is queued before interrupts start processing events
+		m_bDeferred = false;
+		Poll ();
+	}
+	m_bDeferred = bDeferred;
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Processes events queued by interrupts in deferred mode, call from loop ()
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of events processed</returns>
+uint8_t OilerClass::Poll ( void )
+{
+	uint8_t uiResult = 0;
+	EventQueueClass::EVENT Event;
+
+	while ( m_Events.Pop ( &Event ) )
+	{
+		switch ( Event.uiEvent )
+		{
+			case EVENT_MOTOR_WORK:
+				GetOilerMotor ( Event.uiIndex )->SetWorkSignalTime ( Event.ulTime );	// debounce and drip rate use time of signal not of processing
+				MotorWork ( Event.uiIndex );
+				break;
+
+			case EVENT_TIMER:
+				ProcessPendingTimerEvent ();
+				break;
+
+			default:
+				break;
+		}
+		if ( uiResult < 0xFF )
+		{
+			uiResult++;
+		}
+	}
+	// timer event that could not be queued as the queue was full
+	if ( m_bTimerEventPending )
+	{
+		ProcessPendingTimerEvent ();
+		if ( uiResult < 0xFF )
+		{
+			uiResult++;
+		}
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// Checks deadlines for the timer event waiting for Poll (), does nothing if it has already been processed
+/// </summary>
+/// <param name="">none</param>
+void OilerClass::ProcessPendingTimerEvent ( void )
+{
+	if ( m_bTimerEventPending )
+	{
+		m_bTimerEventPending = false;		// clear first so a deadline reached whilst processing queues another
+		ProcessTimerEvent ();
+	}
+}
+
 /// <summary>
 /// turns all motors off
 /// </summary>
 void OilerClass::Off ()
 {
-	uint32_t ulModeUnitsNow = GetStartModeUnits ();
-	for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+	// forget motors waiting to start
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_PendingMask		= 0;
+	m_uiPendingCount	= 0;
+	SREG = uiSREG;
+
+	uint32_t ulMetricUnitsNow [ OILER_METRICS ];
+	GetAllMetricUnits ( ulMetricUnitsNow );
+	for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
 	{
-		OilerMotorClass* pMotor = GetOilerMotor ( i );
-		pMotor->Action ( OilerMotorClass::eOilerMotorEvents::TURN_OFF, ulModeUnitsNow );
+		MotorAction ( i, OilerMotorBaseClass::TURN_OFF, ulMetricUnitsNow [ GetMetric ( i ) ] );
 	}
 	m_OilerStatus = OFF;
 	m_timeOilerStopped = millis ();
+	ScheduleTimer ();
 }
 /// <summary>
 /// Adds a new four pin stepper driver based motor
@@ -158,22 +243,21 @@ void OilerClass::Off ()
 /// <param name="uiPin4">digital pin used to control stepper driver</param>
 /// <param name="ulSpeed">time in microseconds between updates sent to stepper motor</param>
 /// <param name="uiWorkPin">digital pin that signals when motor has caused a unit of work (eg oil drip) to be produced</param>
-/// <param name="uiWorkTarget">number of work units after which motor is turned off</param>
-/// <returns>false if number of motors exceeds maximum, else true</returns>
-bool OilerClass::AddMotor ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, uint8_t uiWorkPin, uint8_t uiWorkTarget )
+/// <param name="ulWorkTarget">number of work units after which motor is turned off</param>
+/// <returns>false if number of motors exceeds maximum or work pin cannot be monitored, else true</returns>
+bool OilerClass::AddMotor ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, uint8_t uiWorkPin, uint32_t ulWorkTarget )
 {
 	bool bResult = false;
-	if ( m_Motors.uiNumMotors < MAX_MOTORS )
+	if ( m_uiNumMotors < m_uiMaxMotors )
 	{
-		// space to add another motor
-		m_Motors.MotorInfo [ m_Motors.uiNumMotors ].Motor = new FourPinStepperMotorClass ( uiPin1, uiPin2, uiPin3, uiPin4, uiWorkPin, uiWorkTarget, DEBOUNCE_THRESHOLD, ulSpeed, m_uiRestartTarget );
-		if ( m_ulAlertThreshold > 0UL )
+		// space to add another motor, construct it in the slot's storage
+		StaticFourPinStepperMotorClass* pMotor = new ( &m_pMotorInfo [ m_uiNumMotors ].Storage ) StaticFourPinStepperMotorClass ( uiPin1, uiPin2, uiPin3, uiPin4, uiWorkPin, ulWorkTarget, DEBOUNCE_THRESHOLD, ulSpeed, m_ulRestartTarget );
+		bResult = AddMotor ( pMotor );
+		if ( !bResult )
 		{
-			m_Motors.MotorInfo [ m_Motors.uiNumMotors ].Motor->SetAlertThreshold ( m_ulAlertThreshold );
+			// slot is reused by the next motor added, the stepper must no longer be stepped by the timer
+			pMotor->~StaticFourPinStepperMotorClass ();
 		}
-		SetupMotorPins ( uiWorkPin, uiWorkTarget );
-		m_Motors.uiNumMotors++;
-		bResult = true;
 	}
 	return bResult;
 }
@@ -182,48 +266,194 @@ bool OilerClass::AddMotor ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint
 /// </summary>
 /// <param name="uiRelayPin">digital pin to signal to turn on relay and hence motor</param>
 /// <param name="uiWorkPin">digital pin that signals when motor has caused a unit of work (eg oil drip) to be produced</param>
-/// <param name="uiWorkTarget">number of work units after which motor is turned off</param>
-/// <returns>false if number of motors exceeds maximum, else true</returns>
-bool OilerClass::AddMotor ( uint8_t uiRelayPin, uint8_t uiWorkPin, uint8_t uiWorkTarget )
+/// <param name="ulWorkTarget">number of work units after which motor is turned off</param>
+/// <returns>false if number of motors exceeds maximum or work pin cannot be monitored, else true</returns>
+bool OilerClass::AddMotor ( uint8_t uiRelayPin, uint8_t uiWorkPin, uint32_t ulWorkTarget )
+{
+	bool bResult = false;
+	if ( m_uiNumMotors < m_uiMaxMotors )
+	{
+		// space to add another motor, construct it in the slot's storage
+		bResult = AddMotor ( new ( &m_pMotorInfo [ m_uiNumMotors ].Storage ) StaticRelayMotorClass ( uiRelayPin, uiWorkPin, ulWorkTarget, DEBOUNCE_THRESHOLD, m_ulRestartTarget ) );
+	}
+	return bResult;
+}
+/// <summary>
+/// Adds a motor, the motor must exist for as long as the oiler. Its work pin and target are taken from the motor
+/// and it is given the oiler's machine, start mode, restart and alert thresholds
+/// </summary>
+/// <param name="pMotor">motor to add</param>
+/// <param name="pfnAction">function that passes events to the motor as its actual type</param>
+/// <param name="pfnWorkSignal">function called when motor's work pin signals</param>
+/// <returns>false if number of motors exceeds maximum or work pin cannot be monitored, e.g. already used or more than MAX_PCI_PINS mcu pins, else true</returns>
+bool OilerClass::AddMotor ( OilerMotorBaseClass* pMotor, MotorActionFn pfnAction, PinCallback pfnWorkSignal )
 {
 	bool bResult = false;
-	if ( m_Motors.uiNumMotors < MAX_MOTORS )
+	if ( pMotor != NULL && m_uiNumMotors < m_uiMaxMotors )
 	{
-		// space to add another motor
-		m_Motors.MotorInfo [ m_Motors.uiNumMotors ].Motor = new RelayMotorClass ( uiRelayPin, uiWorkPin, uiWorkTarget, DEBOUNCE_THRESHOLD, m_uiRestartTarget );
-		if ( m_ulAlertThreshold > 0UL )
+		m_pMotorInfo [ m_uiNumMotors ].Motor		= pMotor;
+		m_pMotorInfo [ m_uiNumMotors ].pfnAction	= pfnAction;
+		m_pMotorInfo [ m_uiNumMotors ].StartMode	= m_OilerMode;
+		m_pMotorInfo [ m_uiNumMotors ].uiMachine	= m_uiMachine;
+		pMotor->SetRestartThreshold ( m_ulRestartTarget );
+		pMotor->SetAlertThreshold ( GetMotorAlertThreshold ( m_uiNumMotors ) );
+		// the motor is only counted once its work pin is monitored, else it would never see work and never stop
+		if ( SetupMotorPins ( pMotor->GetWorkPin (), pfnWorkSignal ) )
 		{
-			m_Motors.MotorInfo [ m_Motors.uiNumMotors ].Motor->SetAlertThreshold ( m_ulAlertThreshold );
+			m_uiNumMotors++;
+			UpdateMetricsInUse ();
+			bResult = true;
 		}
-		SetupMotorPins ( uiWorkPin, uiWorkTarget );
-		m_Motors.uiNumMotors++;
-		bResult = true;
 	}
 	return bResult;
 }
 /// <summary>
-/// Stores information to current (last) motor about pin that signals motor has produced work (e.g. oil drip) and the target number after which it is stopped
+/// Stores information to current (last) motor about pin that signals motor has produced work (e.g. oil drip)
 /// </summary>
 /// <param name="uiWorkPin">pin to signal work unit has been produced</param>
-/// <param name="uiWorkTarget">number of units of work (eg oil drips) after which motor is stopped</param>
-void OilerClass::SetupMotorPins ( uint8_t uiWorkPin, uint8_t uiWorkTarget )
+/// <param name="pfnWorkSignal">function to be called when work pin signals</param>
+/// <returns>true if work pin is monitored, false if it is already used or no more pins can be monitored</returns>
+bool OilerClass::SetupMotorPins ( uint8_t uiWorkPin, PinCallback pfnWorkSignal )
 {
-	PCIHandler.AddPin ( uiWorkPin, MotorISRs.MotorWorkCallback [ m_Motors.uiNumMotors ], MOTOR_WORK_SIGNAL_MODE, MOTOR_WORK_SIGNAL_PINMODE );
+	MOTOR_INFO* pInfo = &m_pMotorInfo [ m_uiNumMotors ];
+	pInfo->uiWorkPin	= uiWorkPin;
+	pInfo->uiIndex		= m_uiNumMotors;
+	pInfo->pOiler		= this;
+	return PCIHandler.AddPin ( uiWorkPin, pfnWorkSignal, pInfo, MOTOR_WORK_SIGNAL_MODE, MOTOR_WORK_SIGNAL_PINMODE );
+}
+/// <summary>
+/// Add the machine being oiled object to the oiler, prerequisite for setting restart mode to target machine powered time or units of work.
+/// Motors can be assigned to different machines so one oiler can oil up to OILER_MAX_MACHINES machines.
+/// <para>if the motor restarts on powered time or work of its previous machine it now measures that of the new machine from now, 
+/// if pMachine is NULL the motor restarts on elapsed time</para>
+/// </summary>
+/// <param name="pMachine">object representing machine being oiled, NULL to remove machine</param>
+/// <param name="uiMotorIndex">zero based index of motor oiling the machine, if ALL_MOTORS applies to all motors and those added later</param>
+/// <returns>false if invalid motor index or already have OILER_MAX_MACHINES other machines, else true</returns>
+bool	OilerClass::AddMachine ( TargetMachineClass* pMachine, uint8_t uiMotorIndex )
+{
+	bool bResult = false;
+	uint8_t uiMachine = FindMachine ( pMachine );
+	if ( ( uiMachine != NO_MACHINE || pMachine == NULL ) && ( uiMotorIndex == ALL_MOTORS || uiMotorIndex < m_uiNumMotors ) )
+	{
+		if ( uiMotorIndex == ALL_MOTORS )
+		{
+			for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
+			{
+				SetMotorMachine ( i, uiMachine );
+			}
+			m_uiMachine = uiMachine;
+			if ( uiMachine == NO_MACHINE )
+			{
+				m_OilerMode = ON_TIME;
+			}
+		}
+		else
+		{
+			SetMotorMachine ( uiMotorIndex, uiMachine );
+		}
+		UpdateMetricsInUse ();
+		RescheduleMotors ();
+		bResult = true;
+	}
+	return bResult;
 }
 /// <summary>
-/// Add the machine being oiled object to the oiler, prerequisite for setting restart mode to target machine powered time or units of work
+/// Finds the index of a machine, adding it if not already known
 /// </summary>
-/// <param name="pMachine">object representing machine being oiled</param>
-void	OilerClass::AddMachine ( TargetMachineClass* pMachine )
+/// <param name="pMachine">machine</param>
+/// <returns>index in m_pMachines or NO_MACHINE if pMachine is NULL or no space for it</returns>
+uint8_t OilerClass::FindMachine ( TargetMachineClass* pMachine )
 {
-	m_pMachine = pMachine;
+	uint8_t uiResult = NO_MACHINE;
+	if ( pMachine != NULL )
+	{
+		for ( uint8_t i = 0; i < m_uiNumMachines && uiResult == NO_MACHINE; i++ )
+		{
+			if ( m_pMachines [ i ] == pMachine )
+			{
+				uiResult = i;
+			}
+		}
+		if ( uiResult == NO_MACHINE && m_uiNumMachines < OILER_MAX_MACHINES )
+		{
+			uiResult = m_uiNumMachines++;
+			m_pMachines [ uiResult ] = pMachine;
+		}
+	}
+	return uiResult;
+}
+/// <summary>
+/// Changes the machine a motor oils. If the motor restarts on a machine metric its deadline moves to the new machine's queue
+/// and it measures the new metric from now
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <param name="uiMachine">index in m_pMachines or NO_MACHINE</param>
+void OilerClass::SetMotorMachine ( uint8_t uiMotorIndex, uint8_t uiMachine )
+{
+	MOTOR_INFO* pInfo = &m_pMotorInfo [ uiMotorIndex ];
+	if ( pInfo->uiMachine != uiMachine )
+	{
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		m_Deadlines [ GetMetric ( uiMotorIndex ) ].Remove ( uiMotorIndex );
+		pInfo->uiMachine = uiMachine;
+		if ( uiMachine == NO_MACHINE )
+		{
+			pInfo->StartMode = ON_TIME;
+		}
+		pInfo->Motor->SetModeMetricAtStart ( GetMotorModeUnits ( uiMotorIndex ) );
+		SREG = uiSREG;
+	}
+}
+/// <summary>
+/// Checks if a motor has a machine
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor, if ALL_MOTORS checks all motors and the machine given to motors added later</param>
+/// <returns>true if motor, or all motors, has a machine</returns>
+bool OilerClass::HasMachine ( uint8_t uiMotorIndex )
+{
+	bool bResult = false;
+	if ( uiMotorIndex == ALL_MOTORS )
+	{
+		bResult = m_uiMachine != NO_MACHINE;
+		for ( uint8_t i = 0; i < m_uiNumMotors && bResult; i++ )
+		{
+			bResult = m_pMotorInfo [ i ].uiMachine != NO_MACHINE;
+		}
+	}
+	else if ( uiMotorIndex < m_uiNumMotors )
+	{
+		bResult = m_pMotorInfo [ uiMotorIndex ].uiMachine != NO_MACHINE;
+	}
+	return bResult;
 }
 /// <summary>
 /// Configures alert settings
 /// </summary>
 /// <param name="uiAlertPin">pin on which to signal when in alert state, if NOT_A_PIN no signal will be output</param>
-/// <param name="ulAlertMultiple">multiple of restart threshold after which alert is generated</param>
+/// <param name="ulAlertThreshold">seconds, or work units for motors restarted by target machine work, a motor can move before alert is generated</param>
 void	OilerClass::SetAlert ( uint8_t uiAlertPin, uint32_t ulAlertThreshold )
+{
+	SetAlertPin ( uiAlertPin );
+	SetAlertThreshold ( ulAlertThreshold );			// ensure all configured motors know the new alert threshold
+}
+/// <summary>
+/// Configures alert settings with a threshold in milliseconds, e.g. for short oiling cycles set with SetStartEventToTimems
+/// </summary>
+/// <param name="uiAlertPin">pin on which to signal when in alert state, if NOT_A_PIN no signal will be output</param>
+/// <param name="ulAlertThresholdms">ms a motor restarted by elapsed or powered time can move before alert is generated, motors restarted by
+/// target machine work keep the work units last given to SetAlert</param>
+void	OilerClass::SetAlertms ( uint8_t uiAlertPin, uint32_t ulAlertThresholdms )
+{
+	SetAlertPin ( uiAlertPin );
+	SetAlertThresholdms ( ulAlertThresholdms, m_ulAlertThreshold );
+}
+/// <summary>
+/// Sets the pin signalled in alert state and clears any alert
+/// </summary>
+/// <param name="uiAlertPin">pin on which to signal when in alert state, if NOT_A_PIN no signal will be output</param>
+void OilerClass::SetAlertPin ( uint8_t uiAlertPin )
 {
 	m_uiAlertPin = uiAlertPin;
 	if ( uiAlertPin != NOT_A_PIN )
@@ -232,21 +462,32 @@ void	OilerClass::SetAlert ( uint8_t uiAlertPin, uint32_t ulAlertThreshold )
 	}
 	// no pin just do software error
 	ClearError ();
-	SetAlertThreshold ( ulAlertThreshold );			// ensure all configured motors know the new alert threshold
 }
 /// <summary>
 /// if changed, updates all oilermotors with new threshold
 /// </summary>
-/// <param name="uiAlertThreshold">new alert threshold</param>
+/// <param name="ulAlertThreshold">new alert threshold in seconds or work units</param>
 void OilerClass::SetAlertThreshold ( uint32_t ulAlertThreshold )
 {
-	if ( ulAlertThreshold != m_ulAlertThreshold )
+	SetAlertThresholdms ( SecsToms ( ulAlertThreshold ), ulAlertThreshold );
+}
+/// <summary>
+/// if changed, updates all oilermotors with new thresholds
+/// </summary>
+/// <param name="ulAlertThresholdms">new alert threshold of motors restarted by time in ms, limited to MAX_TIME_TARGETMS</param>
+/// <param name="ulAlertThreshold">new alert threshold of motors restarted by target machine work in work units</param>
+void OilerClass::SetAlertThresholdms ( uint32_t ulAlertThresholdms, uint32_t ulAlertThreshold )
+{
+	ulAlertThresholdms = ulAlertThresholdms < MAX_TIME_TARGETMS ? ulAlertThresholdms : MAX_TIME_TARGETMS;
+	if ( ulAlertThresholdms != m_ulAlertThresholdms || ulAlertThreshold != m_ulAlertThreshold )
 	{
-		m_ulAlertThreshold = ulAlertThreshold;
-		for ( uint8_t i = 0; i < m_Motors.uiNumMotors ; i++ )
+		m_ulAlertThresholdms	= ulAlertThresholdms;
+		m_ulAlertThreshold		= ulAlertThreshold;
+		for ( uint8_t i = 0; i < m_uiNumMotors ; i++ )
 		{
-			GetOilerMotor ( i )->SetAlertThreshold ( ulAlertThreshold );
+			GetOilerMotor ( i )->SetAlertThreshold ( GetMotorAlertThreshold ( i ) );
 		}
+		RescheduleMotors ();
 	}
 }
 /// <summary>
@@ -306,37 +547,63 @@ bool OilerClass::IsIdle ( void )
 	return m_OilerStatus == IDLE;
 }
 /// <summary>
-/// Checks if system restart mode is monitoring elapsed time
+/// Checks if restart mode is monitoring elapsed time
 /// </summary>
-/// <param name="">none</param>
+/// <param name="uiMotorIndex">zero based index of motor or ALL_MOTORS to check if any motor is</param>
 /// <returns>true if mode is ON_TIME, else false</returns>
-bool OilerClass::IsMonitoringTime ( void )
+bool OilerClass::IsMonitoringTime ( uint8_t uiMotorIndex )
 {
-	return m_OilerMode == ON_TIME;
+	return IsMonitoring ( ON_TIME, uiMotorIndex );
 }
 /// <summary>
-/// Checks if system restart mode is monitoring time the target machine has power
+/// Checks if restart mode is monitoring time the target machine has power
 /// </summary>
-/// <param name="">none</param>
+/// <param name="uiMotorIndex">zero based index of motor or ALL_MOTORS to check if any motor is</param>
 /// <returns>true is mode is ON_POWERED_TIME, else false</returns>
-bool OilerClass::IsMonitoringTargetPower ( void )
+bool OilerClass::IsMonitoringTargetPower ( uint8_t uiMotorIndex )
 {
-	return m_OilerMode == ON_POWERED_TIME;
+	return IsMonitoring ( ON_POWERED_TIME, uiMotorIndex );
 }
 /// <summary>
-/// Checks if system restart mode is monitoring how many units of work the target machine has done
+/// Checks if restart mode is monitoring how many units of work the target machine has done
 /// </summary>
-/// <param name="">none</param>
+/// <param name="uiMotorIndex">zero based index of motor or ALL_MOTORS to check if any motor is</param>
 /// <returns>true if mode is ON_TARGET_ACTIVITY, else false</returns>
-bool OilerClass::IsMonitoringTargetWork ( void )
+bool OilerClass::IsMonitoringTargetWork ( uint8_t uiMotorIndex )
+{
+	return IsMonitoring ( ON_TARGET_ACTIVITY, uiMotorIndex );
+}
+/// <summary>
+/// Checks if a motor restarts on the given mode
+/// </summary>
+/// <param name="Mode">start mode</param>
+/// <param name="uiMotorIndex">zero based index of motor or ALL_MOTORS to check if any motor does, if no motors have been added the mode they will be given is checked</param>
+/// <returns>true if motor uses Mode, false if not or invalid index</returns>
+bool OilerClass::IsMonitoring ( eStartMode Mode, uint8_t uiMotorIndex )
 {
-	return m_OilerMode == ON_TARGET_ACTIVITY;
+	bool bResult = false;
+	if ( uiMotorIndex == ALL_MOTORS )
+	{
+		bResult = m_uiNumMotors == 0 && m_OilerMode == Mode;
+		for ( uint8_t i = 0; i < m_uiNumMotors && !bResult; i++ )
+		{
+			bResult = GetStartMode ( i ) == Mode;
+		}
+	}
+	else if ( uiMotorIndex < m_uiNumMotors )
+	{
+		bResult = GetStartMode ( uiMotorIndex ) == Mode;
+	}
+	return bResult;
 }
 /// <summary>
 /// checks if all motors are idle and updates status as necessary, called from timer interrupt
 /// </summary>
 void OilerClass::CheckMotors ()
 {
+	// a motor that stopped makes room for one waiting to start
+	StartPendingMotors ();
+
 	// have we stopped all motors
 	if ( IsOiling () )
 	{
@@ -346,16 +613,7 @@ void OilerClass::CheckMotors ()
 			m_OilerStatus = IDLE;
 		}
 	}
-	bool bAlert = false;
-	for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
-	{
-		if ( GetOilerMotor ( i )->IsInError () )
-		{
-			bAlert = true;
-			break;
-		}
-	}
-	if ( bAlert )
+	if ( m_ErrorMask != 0 )
 	{
 		SetError ();
 	}
@@ -365,13 +623,13 @@ void OilerClass::CheckMotors ()
 	}
 }
 /// <summary>
-/// Gets the restart mode of the oiler system if set
+/// Gets the restart mode of a motor
 /// </summary>
-/// <param name="">none</param>
+/// <param name="uiMotorIndex">zero based index of motor</param>
 /// <returns>OilerClass::eStartMode</returns>
-inline OilerClass::eStartMode OilerClass::GetStartMode ( void )
+inline OilerClass::eStartMode OilerClass::GetStartMode ( uint8_t uiMotorIndex )
 {
-	return m_OilerMode;
+	return m_pMotorInfo [ uiMotorIndex ].StartMode;
 }
 /// <summary>
 /// Gets the status of the oiler system
@@ -383,60 +641,114 @@ inline OilerClass::eStatus OilerClass::GetStatus ( void )
 	return m_OilerStatus;
 }
 /// <summary>
-/// Gets the current value of the units being measured for the current start mode
+/// Gets the metric that restarts a motor, this is the start mode and for target machine modes the machine
 /// </summary>
-/// <param name="">None</param>
-/// <returns>units</returns>
-uint32_t OilerClass::GetStartModeUnits ( void )
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <returns>0 for elapsed time, 1 + 2 * machine for powered time, 2 + 2 * machine for work units</returns>
+inline uint8_t OilerClass::GetMetric ( uint8_t uiMotorIndex )
+{
+	MOTOR_INFO* pInfo = &m_pMotorInfo [ uiMotorIndex ];
+	return pInfo->StartMode == ON_TIME || pInfo->uiMachine == NO_MACHINE ? 0 : pInfo->StartMode + 2 * pInfo->uiMachine;
+}
+/// <summary>
+/// Gets the current value of the units being measured for a metric
+/// </summary>
+/// <param name="uiMetric">index of metric as returned by GetMetric</param>
+/// <returns>ms for elapsed and powered time, else work units</returns>
+uint32_t OilerClass::GetMetricUnits ( uint8_t uiMetric )
 {
 	uint32_t ulResult = 0UL;
-	switch ( GetStartMode() )
+	if ( uiMetric == 0 )
 	{
-		case eStartMode::ON_TIME:
-			ulResult = millis () / 1000;		// in seconds
-			break;
-
-		case eStartMode::ON_POWERED_TIME:
-			ulResult = m_pMachine->GetActiveTime ();
-			break;
-
-		case eStartMode::ON_TARGET_ACTIVITY:
-			ulResult = m_pMachine->GetWorkUnits ();
-			break;
-
-		default:
-			break;
+		ulResult = millis ();
+	}
+	else
+	{
+		TargetMachineClass* pMachine = m_pMachines [ ( uiMetric - 1 ) / 2 ];
+		ulResult = ( uiMetric & 1 ) ? pMachine->GetActiveTimems () : pMachine->GetWorkUnits ();
 	}
 	return ulResult;
 }
 /// <summary>
-/// Gets the number of seconds the coinfigured machine has had power to date
+/// Gets the current value of the units being measured for the start mode of a motor
 /// </summary>
-/// <param name="">None</param>
-/// <returns>returns 0 if no machine configured else the number of seconds of powered time</returns>
-uint32_t OilerClass::GetMachinePoweredOnTime ( void )
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <returns>units</returns>
+uint32_t OilerClass::GetMotorModeUnits ( uint8_t uiMotorIndex )
+{
+	return GetMetricUnits ( GetMetric ( uiMotorIndex ) );
+}
+/// <summary>
+/// Gets the alert threshold of a motor in the units of the metric that restarts it, time metrics are in ms
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <returns>units, 0 if no alert threshold</returns>
+uint32_t OilerClass::GetMotorAlertThreshold ( uint8_t uiMotorIndex )
+{
+	uint8_t uiMetric = GetMetric ( uiMotorIndex );
+	return uiMetric == 0 || ( uiMetric & 1 ) ? m_ulAlertThresholdms : m_ulAlertThreshold;
+}
+/// <summary>
+/// Converts a time target in seconds to ms, limited to MAX_TIME_TARGETMS as longer deadlines would compare as already passed
+/// </summary>
+/// <param name="ulSecs">seconds</param>
+/// <returns>milliseconds</returns>
+uint32_t OilerClass::SecsToms ( uint32_t ulSecs )
+{
+	return ulSecs < MAX_TIME_TARGETMS / 1000UL ? ulSecs * 1000UL : MAX_TIME_TARGETMS;
+}
+/// <summary>
+/// Gets the current value of the units of each metric used by a motor, so that when all motors are changed each metric is read once
+/// </summary>
+/// <param name="pulMetricUnits">array of OILER_METRICS values, indexed by metric, metrics not in use are set to 0</param>
+void OilerClass::GetAllMetricUnits ( uint32_t* pulMetricUnits )
+{
+	for ( uint8_t i = 0; i < OILER_METRICS; i++ )
+	{
+		pulMetricUnits [ i ] = ( m_uiMetricsInUse & ( 1 << i ) ) != 0 ? GetMetricUnits ( i ) : 0UL;
+	}
+}
+/// <summary>
+/// Recalculates which metrics are used by at least one motor
+/// </summary>
+/// <param name="">none</param>
+void OilerClass::UpdateMetricsInUse ( void )
+{
+	uint8_t uiMetrics = 0;
+	for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
+	{
+		uiMetrics |= 1 << GetMetric ( i );
+	}
+	m_uiMetricsInUse = uiMetrics;
+}
+/// <summary>
+/// Gets the number of seconds the machine oiled by a motor has had power to date
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <returns>returns 0 if motor has no machine else the number of seconds of powered time</returns>
+uint32_t OilerClass::GetMachinePoweredOnTime ( uint8_t uiMotorIndex )
 {
 	uint32_t ulResult = 0UL;
 
-	if ( m_pMachine )
+	if ( HasMachine ( uiMotorIndex ) )
 	{
-		ulResult = m_pMachine->GetActiveTime ();
+		ulResult = m_pMachines [ m_pMotorInfo [ uiMotorIndex ].uiMachine ]->GetActiveTime ();
 	}
 	return ulResult;
 }
 
 /// <summary>
-/// Returns the number of machine units done to date or 0 if no machine is configured
+/// Returns the number of machine units done to date by the machine oiled by a motor or 0 if it has no machine
 /// </summary>
-/// <param name="">None</param>
+/// <param name="uiMotorIndex">zero based index of motor</param>
 /// <returns>number of work units done or 0 if no machine configured</returns>
-uint32_t OilerClass::GetMachineUnitCount ( void )
+uint32_t OilerClass::GetMachineUnitCount ( uint8_t uiMotorIndex )
 {
 	uint32_t ulResult = 0UL;
 
-	if ( m_pMachine )
+	if ( HasMachine ( uiMotorIndex ) )
 	{
-		ulResult = m_pMachine->GetWorkUnits ();
+		ulResult = m_pMachines [ m_pMotorInfo [ uiMotorIndex ].uiMachine ]->GetWorkUnits ();
 	}
 
 	return ulResult;
@@ -450,27 +762,42 @@ void OilerClass::ProcessTimerEvent ( void )
 	// if Oiler is on
 	if ( IsOff () == false )
 	{
-		// get current value of units being measured for this more ie elapsed time, powered time or active work units (eg revs)
-		uint32_t ulModeUnits = GetStartModeUnits ();
-
-		// motors configured
-		for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+		for ( uint8_t uiMetric = 0; uiMetric < OILER_METRICS; uiMetric++ )
 		{
-			OilerMotorClass* pMotor = GetOilerMotor ( i );
-			if ( pMotor->Action ( OilerMotorClass::eOilerMotorEvents::TIMER, ulModeUnits ) )
+			DeadlineQueueClass* pDeadlines = &m_Deadlines [ uiMetric ];
+			if ( !pDeadlines->IsEmpty () )
 			{
-				// state changed
-				if ( pMotor->IsMoving () )
+				// get current value of units being measured ie elapsed time, powered time or active work units (eg revs) of a machine, once for all its motors
+				uint32_t ulModeUnits = GetMetricUnits ( uiMetric );
+
+				// only motors whose restart or alert deadline has passed need to check, a motor that restarts can then be due an alert check
+				for ( uint8_t n = 0; n < 2 * m_uiNumMotors && pDeadlines->IsDue ( ulModeUnits ); n++ )
 				{
-					m_OilerStatus = OILING;
+					uint8_t i = pDeadlines->GetFirstId ();
+					pDeadlines->Remove ( i );			// motor is given a new deadline if it still needs one
+					if ( GetOilerMotor ( i )->IsIdle () && !CanStartMotor () )
+					{
+						// restart is due but too many motors moving, wait in turn
+						QueueStart ( i );
+					}
+					else
+					{
+						MotorAction ( i, OilerMotorBaseClass::TIMER, ulModeUnits );
+					}
 				}
 			}
-			// check if in error state
-			if ( pMotor->IsInError () )
-			{
-				SetError ();
-			}
 		}
+		// a motor restarted
+		if ( m_MovingMask != 0 )
+		{
+			m_OilerStatus = OILING;
+		}
+		// check if in error state
+		if ( m_ErrorMask != 0 )
+		{
+			SetError ();
+		}
+		ScheduleTimer ();
 	}
 }
 
@@ -498,7 +825,7 @@ uint32_t OilerClass::GetTimeOilerIdle ( void )
 uint32_t OilerClass::GetTimeSinceMotorStarted ( uint8_t uiMotorIndex )
 {
 	uint32_t ulResult = 0;
-	if ( uiMotorIndex < m_Motors.uiNumMotors )
+	if ( uiMotorIndex < m_uiNumMotors )
 	{
 		ulResult = GetOilerMotor ( uiMotorIndex )->GetTimeMotorRunning ();
 	}
@@ -506,13 +833,381 @@ uint32_t OilerClass::GetTimeSinceMotorStarted ( uint8_t uiMotorIndex )
 }
 
 /// <summary>
-/// Get pointer to instance of OilerMotorClass
+/// Copies the state of the oiler, its motors and machines in one go with interrupts held off, so values are consistent with each other
+/// and multi-byte values are not torn by an interrupt changing them part way through being read
+/// </summary>
+/// <param name="pSnapshot">receives oiler and machine state, nothing is copied if NULL</param>
+/// <param name="pMotors">array of uiMaxMotors to receive state of each motor, can be NULL</param>
+/// <param name="uiMaxMotors">size of pMotors</param>
+/// <returns>number of motors copied to pMotors</returns>
+uint8_t OilerClass::GetSnapshot ( SNAPSHOT* pSnapshot, MOTOR_SNAPSHOT* pMotors, uint8_t uiMaxMotors )
+{
+	uint8_t uiResult = 0;
+	if ( pSnapshot != NULL )
+	{
+		uiResult = pMotors == NULL ? 0 : uiMaxMotors < m_uiNumMotors ? uiMaxMotors : m_uiNumMotors;
+		uint32_t ulMachinePeriodus [ OILER_MAX_MACHINES ];
+
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		uint32_t ulNow				= millis ();
+		pSnapshot->ulTimems			= ulNow;
+		pSnapshot->ulIdlems			= AllMotorsStopped () && m_OilerStatus != OFF ? ulNow - m_timeOilerStopped : 0UL;
+		pSnapshot->Status			= m_OilerStatus;
+		pSnapshot->bAlert			= m_bAlert;
+		pSnapshot->uiNumMotors		= m_uiNumMotors;
+		pSnapshot->uiPendingStarts	= m_uiPendingCount;
+		pSnapshot->MovingMask		= m_MovingMask;
+		pSnapshot->ErrorMask		= m_ErrorMask;
+		pSnapshot->uiNumMachines	= m_uiNumMachines;
+		for ( uint8_t i = 0; i < OILER_MAX_MACHINES; i++ )
+		{
+			pSnapshot->ulMachineWorkUnits [ i ]	= i < m_uiNumMachines ? m_pMachines [ i ]->GetWorkUnits () : 0UL;
+			pSnapshot->ulMachineActivems [ i ]	= i < m_uiNumMachines ? m_pMachines [ i ]->GetActiveTimems () : 0UL;
+			ulMachinePeriodus [ i ]				= i < m_uiNumMachines ? m_pMachines [ i ]->GetPeriodus () : 0UL;
+		}
+		for ( uint8_t i = 0; i < uiResult; i++ )
+		{
+			OilerMotorBaseClass* pMotor = GetOilerMotor ( i );
+			pMotors [ i ].State			= pMotor->GetOilerMotorState ();
+			pMotors [ i ].ulWorkCount	= pMotor->GetWorkUnits ();
+			pMotors [ i ].ulRunningms	= pMotor->GetTimeMotorRunningms ();
+		}
+		SREG = uiSREG;
+
+		// divide once interrupts are back on
+		for ( uint8_t i = 0; i < OILER_MAX_MACHINES; i++ )
+		{
+			pSnapshot->uiMachineRPM [ i ] = TargetMachineClass::PeriodToRPM ( ulMachinePeriodus [ i ] );
+		}
+	}
+
+	return uiResult;
+}
+
+/// <summary>
+/// Checks if events are queued for Poll () rather than processed in interrupts
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if in deferred mode</returns>
+bool OilerClass::IsDeferredMode ( void )
+{
+	return m_bDeferred;
+}
+
+/// <summary>
+/// Gets the number of events lost because the queue was full when an interrupt queued them, i.e. Poll () not called often enough
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of events, stops at 0xFFFF</returns>
+uint16_t OilerClass::GetEventOverflowCount ( void )
+{
+	return m_Events.GetOverflowCount ();
+}
+
+/// <summary>
+/// Gets the most events that have waited for Poll () at once, if near OILER_EVENT_QUEUE_SIZE Poll () should be called more often or the queue made bigger
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of events</returns>
+uint8_t OilerClass::GetEventHighWater ( void )
+{
+	return m_Events.GetHighWater ();
+}
+
+/// <summary>
+/// Limits the number of motors moving at once e.g. to limit current drawn or pressure drop in a shared oil line. A motor due to start
+/// when the limit is reached waits until another motor stops, waiting motors start in the order they became due
+/// </summary>
+/// <param name="uiMaxMoving">max motors moving at once, 0 => no limit</param>
+void OilerClass::SetMaxMovingMotors ( uint8_t uiMaxMoving )
+{
+	m_uiMaxMoving = uiMaxMoving;
+	// a raised limit may let waiting motors start
+	StartPendingMotors ();
+}
+
+/// <summary>
+/// Gets the number of motors waiting to start because max moving motors are moving
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of motors</returns>
+uint8_t OilerClass::GetNumPendingStarts ( void )
+{
+	return m_uiPendingCount;
+}
+
+/// <summary>
+/// Passes event to specified motor
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <param name="eAction">event</param>
+/// <param name="ulParam">current value of start mode metric</param>
+/// <returns>true if motor state changed</returns>
+inline bool OilerClass::MotorAction ( uint8_t uiMotorIndex, OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam )
+{
+	bool bResult = m_pMotorInfo [ uiMotorIndex ].pfnAction ( m_pMotorInfo [ uiMotorIndex ].Motor, eAction, ulParam );
+	UpdateMotorState ( uiMotorIndex );
+	return bResult;
+}
+
+/// <summary>
+/// Updates the moving, idle and error masks and the deadline of a motor from its state. Called after every event a motor processes so that
+/// queries on all motors are a test of a mask rather than a loop over the motors
+/// <para>an idle motor's deadline is when it is due to restart and a moving motor's deadline is when it will be in alert if it has not completed its work,
+/// the motor is only sent a TIMER event when its deadline is reached</para>
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+void OilerClass::UpdateMotorState ( uint8_t uiMotorIndex )
+{
+	OilerMotorBaseClass* pMotor = GetOilerMotor ( uiMotorIndex );
+	MOTOR_MASK Bit = (MOTOR_MASK)1 << uiMotorIndex;
+	OilerMotorBaseClass::eOilerMotorState eState = pMotor->GetOilerMotorState ();
+	DeadlineQueueClass* pDeadlines = &m_Deadlines [ GetMetric ( uiMotorIndex ) ];
+
+	// masks and deadlines are updated from interrupts and main code
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_MovingMask	= eState == OilerMotorBaseClass::MOVING ? m_MovingMask | Bit : m_MovingMask & ~Bit;
+	m_IdleMask		= eState == OilerMotorBaseClass::IDLE ? m_IdleMask | Bit : m_IdleMask & ~Bit;
+	m_ErrorMask		= pMotor->IsInError () ? m_ErrorMask | Bit : m_ErrorMask & ~Bit;
+	switch ( eState )
+	{
+		case OilerMotorBaseClass::MOVING:
+			// alert threshold of 0 means no alert
+			if ( pMotor->GetAlertThreshold () > 0UL && !pMotor->IsInError () )
+			{
+				pDeadlines->Set ( uiMotorIndex, pMotor->GetModeMetricAtStart () + pMotor->GetAlertThreshold () );
+			}
+			else
+			{
+				pDeadlines->Remove ( uiMotorIndex );
+			}
+			break;
+
+		case OilerMotorBaseClass::IDLE:
+			// a motor waiting to start has no deadline
+			if ( ( m_PendingMask & Bit ) == 0 )
+			{
+				pDeadlines->Set ( uiMotorIndex, pMotor->GetModeMetricAtStart () + pMotor->GetRestartThreshold () );
+			}
+			else
+			{
+				pDeadlines->Remove ( uiMotorIndex );
+			}
+			break;
+
+		default:
+			pDeadlines->Remove ( uiMotorIndex );
+			break;
+	}
+	SREG = uiSREG;
+	ScheduleTimer ();
+}
+
+/// <summary>
+/// Checks if a motor can start now. Motors already waiting go first so starts are in the order they became due
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if no motors waiting and fewer than max moving motors are moving</returns>
+bool OilerClass::CanStartMotor ( void )
+{
+	return m_uiPendingCount == 0 && BelowMaxMoving ();
+}
+
+/// <summary>
+/// Checks if fewer than max moving motors are moving, including any StartPendingMotors is starting
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if another motor can move</returns>
+bool OilerClass::BelowMaxMoving ( void )
+{
+	bool bResult = true;
+	if ( m_uiMaxMoving != 0 )
+	{
+		uint8_t uiMoving = m_uiStartingCount;
+		for ( MOTOR_MASK Moving = m_MovingMask; Moving != 0; Moving &= Moving - 1 )
+		{
+			uiMoving++;
+		}
+		bResult = uiMoving < m_uiMaxMoving;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Adds motor to end of the motors waiting to start, does nothing if already waiting
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+void OilerClass::QueueStart ( uint8_t uiMotorIndex )
+{
+	MOTOR_MASK Bit = (MOTOR_MASK)1 << uiMotorIndex;
+
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	if ( ( m_PendingMask & Bit ) == 0 )
+	{
+		m_pPendingStarts [ ( m_uiPendingHead + m_uiPendingCount ) % m_uiMaxMotors ] = uiMotorIndex;
+		m_uiPendingCount++;
+		m_PendingMask |= Bit;
+	}
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Starts motors waiting to start, in the order they were queued, until max moving motors are moving. A motor measures its restart and alert
+/// thresholds from when it actually starts
+/// <para>only taking a motor from the queue holds interrupts off, it is started with them restored as starting may shift out expander outputs,
+/// until then it is counted in m_uiStartingCount so a call from an interrupt cannot start one motor too many</para>
+/// </summary>
+/// <param name="">none</param>
+void OilerClass::StartPendingMotors ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	while ( m_uiPendingCount > 0 && BelowMaxMoving () )
+	{
+		uint8_t i = m_pPendingStarts [ m_uiPendingHead ];
+		m_uiPendingHead = ( m_uiPendingHead + 1 ) % m_uiMaxMotors;
+		m_uiPendingCount--;
+		m_PendingMask &= ~( (MOTOR_MASK)1 << i );
+		m_uiStartingCount++;
+		SREG = uiSREG;
+
+		MotorAction ( i, OilerMotorBaseClass::TURN_ON, GetMotorModeUnits ( i ) );
+
+		noInterrupts ();
+		m_uiStartingCount--;
+	}
+	if ( m_MovingMask != 0 && !IsOff () )
+	{
+		m_OilerStatus = OILING;
+	}
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Recalculates the deadline of every motor, needed when thresholds or the start mode change
+/// </summary>
+/// <param name="">none</param>
+void OilerClass::RescheduleMotors ( void )
+{
+	for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
+	{
+		UpdateMotorState ( i );
+	}
+	ScheduleTimer ();
+}
+
+/// <summary>
+/// Arms the timer to call ProcessTimerEvent when the nearest deadline of each metric is reached
+/// <para>ON_TIME deadlines are ms of elapsed time so the timer is set as an alarm for the nearest. ON_POWERED_TIME deadlines are ms of a machine's powered time,
+/// which cannot pass faster than elapsed time, so the ms still needed is the earliest the deadline can be reached. Whilst a machine has no power its deadlines are checked
+/// every POWERED_TIME_IDLE_CHECKMS instead. For ON_TARGET_ACTIVITY deadlines each target machine is asked to call back when its work units reach the nearest</para>
+/// </summary>
+/// <param name="">none</param>
+void OilerClass::ScheduleTimer ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	bool		bOn			= !IsOff ();
+	bool		bAlarm		= false;
+	uint32_t	ulDelayms	= 0UL;
+
+	if ( bOn && !m_Deadlines [ 0 ].IsEmpty () )
+	{
+		uint32_t ulDuems	= m_Deadlines [ 0 ].GetFirstDeadline ();
+		uint32_t ulNow		= millis ();
+		ulDelayms			= (int32_t)( ulDuems - ulNow ) > 0 ? ulDuems - ulNow : 0UL;
+		bAlarm				= true;
+	}
+
+	for ( uint8_t uiMachine = 0; uiMachine < m_uiNumMachines; uiMachine++ )
+	{
+		TargetMachineClass*	pMachine		= m_pMachines [ uiMachine ];
+		DeadlineQueueClass*	pTimeDeadlines	= &m_Deadlines [ ON_POWERED_TIME + 2 * uiMachine ];
+		DeadlineQueueClass*	pWorkDeadlines	= &m_Deadlines [ ON_TARGET_ACTIVITY + 2 * uiMachine ];
+
+		if ( bOn && !pTimeDeadlines->IsEmpty () )
+		{
+			uint32_t ulDuems	= pTimeDeadlines->GetFirstDeadline ();
+			uint32_t ulActivems	= pMachine->GetActiveTimems ();
+			uint32_t ulWaitms	= (int32_t)( ulDuems - ulActivems ) > 0 ? ulDuems - ulActivems : 0UL;
+			if ( !pMachine->IsActive () && ulWaitms < POWERED_TIME_IDLE_CHECKMS )
+			{
+				// powered time is not increasing, check back later in case machine is powered on
+				ulWaitms = POWERED_TIME_IDLE_CHECKMS;
+			}
+			ulDelayms	= bAlarm && ulDelayms < ulWaitms ? ulDelayms : ulWaitms;
+			bAlarm		= true;
+		}
+
+		if ( bOn && !pWorkDeadlines->IsEmpty () )
+		{
+			if ( pWorkDeadlines->IsDue ( pMachine->GetWorkUnits () ) )
+			{
+				// already reached e.g. target lowered, handle on next tick
+				pMachine->RemoveWorkWatch ( WorkTargetSignal, this );
+				ulDelayms	= 0UL;
+				bAlarm		= true;
+			}
+			else
+			{
+				// machine calls back as soon as its work units reach the deadline
+				pMachine->SetWorkWatch ( WorkTargetSignal, this, pWorkDeadlines->GetFirstDeadline () );
+			}
+		}
+		else
+		{
+			pMachine->RemoveWorkWatch ( WorkTargetSignal, this );
+		}
+	}
+
+	if ( bAlarm )
+	{
+		// a deadline weeks away would overflow the delay in ticks, waking early only reschedules
+		if ( ulDelayms > MAX_ALARM_DELAYMS )
+		{
+			ulDelayms = MAX_ALARM_DELAYMS;
+		}
+		// + 1 as alarm may be set part way through a tick
+		TheTimer.SetAlarm ( AlarmSignal, this, ulDelayms * ( RESOLUTION / 1000 ) + 1 );
+	}
+	else
+	{
+		TheTimer.RemoveCallBack ( AlarmSignal, this );
+	}
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Get pointer to instance of OilerMotorBaseClass
 /// </summary>
 /// <param name="uiMotorIndex">zero based index of oiler motor class instance</param>
-/// <returns>pointer to OilerMotorClass</returns>
-inline OilerMotorClass* OilerClass::GetOilerMotor ( uint8_t uiMotorIndex )
+/// <returns>pointer to OilerMotorBaseClass</returns>
+inline OilerMotorBaseClass* OilerClass::GetOilerMotor ( uint8_t uiMotorIndex )
+{
+	return m_pMotorInfo [ uiMotorIndex ].Motor;
+}
+
+/// <summary>
+/// Gets the number of motors that have been added to the oiler
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of motors</returns>
+uint8_t OilerClass::GetNumMotors ( void )
 {
-	return m_Motors.MotorInfo[ uiMotorIndex ].Motor;
+	return m_uiNumMotors;
+}
+
+/// <summary>
+/// Gets the number of motors the oiler has storage for
+/// </summary>
+/// <param name="">none</param>
+/// <returns>max number of motors</returns>
+uint8_t OilerClass::GetMaxMotors ( void )
+{
+	return m_uiMaxMotors;
 }
 
 /// <summary>
@@ -544,14 +1239,14 @@ void	OilerClass::ClearError ( void )
 /// </summary>
 /// <param name="uiMotorNum">zero based index of motor to be checked</param>
 /// <returns>Count of units</returns>
-uint16_t OilerClass::GetMotorWorkCount ( uint8_t uiMotorNum )
+uint32_t OilerClass::GetMotorWorkCount ( uint8_t uiMotorNum )
 {
-	uint16_t uiResult = 0;
-	if ( uiMotorNum < m_Motors.uiNumMotors )
+	uint32_t ulResult = 0UL;
+	if ( uiMotorNum < m_uiNumMotors )
 	{
-		uiResult = GetOilerMotor ( uiMotorNum )->GetWorkUnits();
+		ulResult = GetOilerMotor ( uiMotorNum )->GetWorkUnits();
 	}
-	return uiResult;
+	return ulResult;
 }
 /// <summary>
 /// Checks if the specified motor is in a RUNNING state
@@ -560,17 +1255,17 @@ uint16_t OilerClass::GetMotorWorkCount ( uint8_t uiMotorNum )
 /// <returns>true if RUNNING, else false</returns>
 bool OilerClass::IsMotorRunning ( uint8_t uiMotorNum )
 {
-	return  GetMotorState (  uiMotorNum ) == OilerMotorClass::MOVING;
+	return  GetMotorState (  uiMotorNum ) == OilerMotorBaseClass::MOVING;
 }
 /// <summary>
 /// Checks state of identified motor
 /// </summary>
 /// <param name="uiMotorNum">zero based index of motor to be checked</param>
 /// <returns>MotorClass:eState of motor, returns MotorClass:STOPPED if invalid index</returns>
-OilerMotorClass::eOilerMotorState OilerClass::GetMotorState ( uint8_t uiMotorNum )
+OilerMotorBaseClass::eOilerMotorState OilerClass::GetMotorState ( uint8_t uiMotorNum )
 {
-	OilerMotorClass::eOilerMotorState eResult = OilerMotorClass::OFF;
-	if ( uiMotorNum < m_Motors.uiNumMotors )
+	OilerMotorBaseClass::eOilerMotorState eResult = OilerMotorBaseClass::OFF;
+	if ( uiMotorNum < m_uiNumMotors )
 	{
 		eResult = GetOilerMotor ( uiMotorNum )->GetOilerMotorState ();
 	}
@@ -583,63 +1278,94 @@ OilerMotorClass::eOilerMotorState OilerClass::GetMotorState ( uint8_t uiMotorNum
 /// <returns>false if at least one motor is still running, else true</returns>
 bool OilerClass::AllMotorsStopped ( void )
 {
-	bool bResult = true;
-	for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
-	{
-		if ( GetOilerMotor ( i )->IsMoving() )
-		{
-			bResult = false;
-			break;
-		}
-	}
-	return bResult;
+	return m_MovingMask == 0;
 }
 /// <summary>
 /// Sets the motor restart mode. The mode determines the event that causes the library to restart the motors oiling
 /// </summary>
 /// <param name="Mode">This can be:
 /// <para>ON_TIME - elapsed time since oiling stopped</para>
-/// <para>ON_POWERED_TIME - seconds that machine being oiled has had power since oiling stopped, only valid if AddMachine() has previously been called</para>
+/// <para>ON_POWERED_TIME - milliseconds that machine being oiled has had power since oiling stopped, only valid if AddMachine() has previously been called</para>
 /// <para>ON_TARGET_ACTIVITY - number of work units signalled by machine being oiled has sent since oiling stopped, only valid if AddMachine() has previously been called</para>
 /// </param>
-/// <param name="ulModeTarget">target value in seconds or unit count as relevant</param>
-/// <returns>false if AddMachine() not previously called and Mode is ON_POWERED_TIME or ON_TARGET_ACTIVITY, else true</returns>
-bool OilerClass::SetStartMode ( eStartMode Mode, uint16_t uiModeTarget ) 
+/// <param name="ulModeTarget">target value in milliseconds or unit count as relevant, time targets are limited to MAX_TIME_TARGETMS (about 24 days)</param>
+/// <param name="uiMotorIndex">zero based index of motor, if ALL_MOTORS applies to all motors and those added later</param>
+/// <returns>false if AddMachine() not previously called for motor(s) and Mode is ON_POWERED_TIME or ON_TARGET_ACTIVITY or invalid motor index, else true</returns>
+bool OilerClass::SetStartMode ( eStartMode Mode, uint32_t ulModeTarget, uint8_t uiMotorIndex ) 
 {
 	bool bResult = false;
-	switch ( Mode )
+	if ( ( Mode == ON_TIME || Mode == ON_POWERED_TIME ) && ulModeTarget > MAX_TIME_TARGETMS )
 	{
-		case ON_POWERED_TIME:
-		case ON_TARGET_ACTIVITY:
-			if ( m_pMachine == NULL )
-			{
-				break;
-			}
+		ulModeTarget = MAX_TIME_TARGETMS;
+	}
+	if ( uiMotorIndex == ALL_MOTORS || uiMotorIndex < m_uiNumMotors )
+	{
+		switch ( Mode )
+		{
+			case ON_POWERED_TIME:
+			case ON_TARGET_ACTIVITY:
+				if ( !HasMachine ( uiMotorIndex ) )
+				{
+					break;
+				}
 
-		case ON_TIME:
-			// ensure all oilermotors have this restart value
-			for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
-			{
-				GetOilerMotor ( i )->SetRestartThreshold ( uiModeTarget );
-			}
-			m_uiRestartTarget = uiModeTarget;		// save restart valuue
-			m_OilerMode = Mode;
-			bResult = true;
-			break;
+			case ON_TIME:
+				if ( uiMotorIndex == ALL_MOTORS )
+				{
+					// ensure all oilermotors have this mode and restart value
+					for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
+					{
+						SetMotorStartMode ( i, Mode, ulModeTarget );
+					}
+					m_ulRestartTarget = ulModeTarget;		// save restart value for motors added later
+					m_OilerMode = Mode;
+				}
+				else
+				{
+					SetMotorStartMode ( uiMotorIndex, Mode, ulModeTarget );
+				}
+				UpdateMetricsInUse ();
+				RescheduleMotors ();
+				bResult = true;
+				break;
 
-		default:
-			break;
+			default:
+				break;
+		}
 	}
 	return bResult;
 }
 
+/// <summary>
+/// Changes the restart mode and target of a motor. If the mode changes the motor's deadline moves to the new mode's queue
+/// and the motor measures the new metric from now, as its value when it started is not known
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <param name="Mode">new start mode</param>
+/// <param name="ulModeTarget">target value in milliseconds or unit count as relevant</param>
+void OilerClass::SetMotorStartMode ( uint8_t uiMotorIndex, eStartMode Mode, uint32_t ulModeTarget )
+{
+	OilerMotorBaseClass* pMotor = GetOilerMotor ( uiMotorIndex );
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	pMotor->SetRestartThreshold ( ulModeTarget );
+	if ( GetStartMode ( uiMotorIndex ) != Mode )
+	{
+		m_Deadlines [ GetMetric ( uiMotorIndex ) ].Remove ( uiMotorIndex );
+		m_pMotorInfo [ uiMotorIndex ].StartMode = Mode;
+		pMotor->SetModeMetricAtStart ( GetMotorModeUnits ( uiMotorIndex ) );
+		pMotor->SetAlertThreshold ( GetMotorAlertThreshold ( uiMotorIndex ) );	// time and work alerts are in different units
+	}
+	SREG = uiSREG;
+}
+
 /// <summary>
 /// Sets specified motor to move forwards
 /// </summary>
 /// <param name="uiMotorIndex">zero based index of motor to change</param>
 void OilerClass::SetMotorsForward ( uint8_t uiMotorIndex )
 {
-	m_Motors.MotorInfo [ uiMotorIndex ].Motor->SetDirection ( MotorClass::FORWARD );
+	m_pMotorInfo [ uiMotorIndex ].Motor->SetDirection ( MotorClass::FORWARD );
 }
 /// <summary>
 ///  Sets the minimum time in milliseconds between signals before signal will be considered valid
@@ -650,7 +1376,7 @@ void OilerClass::SetMotorsForward ( uint8_t uiMotorIndex )
 bool OilerClass::SetMotorSensorDebounce ( uint8_t uiMotorIndex, uint16_t uiDelayms )
 {
 	bool bResult = false;
-	if ( uiMotorIndex < m_Motors.uiNumMotors )
+	if ( uiMotorIndex < m_uiNumMotors )
 	{
 		GetOilerMotor ( uiMotorIndex )->SetDebouncems ( uiDelayms );
 		bResult = true;
@@ -658,38 +1384,48 @@ bool OilerClass::SetMotorSensorDebounce ( uint8_t uiMotorIndex, uint16_t uiDelay
 	return bResult;
 }
 
-bool OilerClass::SetStartEventToTargetActiveTime ( uint16_t uiTargetSecs )
+bool OilerClass::SetStartEventToTargetActiveTime ( uint32_t ulTargetSecs, uint8_t uiMotorIndex )
+{
+	return SetStartMode ( ON_POWERED_TIME, SecsToms ( ulTargetSecs ), uiMotorIndex );
+}
+
+bool OilerClass::SetStartEventToTargetActiveTimems ( uint32_t ulTargetms, uint8_t uiMotorIndex )
+{
+	return SetStartMode ( ON_POWERED_TIME, ulTargetms, uiMotorIndex );
+}
+
+bool OilerClass::SetStartEventToTargetWork ( uint32_t ulTargetUnits, uint8_t uiMotorIndex )
 {
-	return SetStartMode ( ON_POWERED_TIME, uiTargetSecs );
+	return SetStartMode ( ON_TARGET_ACTIVITY, ulTargetUnits, uiMotorIndex );
 }
 
-bool OilerClass::SetStartEventToTargetWork ( uint16_t uiTargetUnits )
+bool OilerClass::SetStartEventToTime ( uint32_t ulElapsedSecs, uint8_t uiMotorIndex )
 {
-	return SetStartMode ( ON_TARGET_ACTIVITY, uiTargetUnits );
+	return SetStartMode ( ON_TIME, SecsToms ( ulElapsedSecs ), uiMotorIndex );
 }
 
-bool OilerClass::SetStartEventToTime ( uint16_t uiElapsedSecs )
+bool OilerClass::SetStartEventToTimems ( uint32_t ulElapsedms, uint8_t uiMotorIndex )
 {
-	return SetStartMode ( ON_TIME, uiElapsedSecs );
+	return SetStartMode ( ON_TIME, ulElapsedms, uiMotorIndex );
 }
 
-bool OilerClass::SetStopTarget ( uint8_t uiWorkTarget, uint8_t uiMotorIndex )
+bool OilerClass::SetStopTarget ( uint32_t ulWorkTarget, uint8_t uiMotorIndex )
 {
 	bool bResult = false;
 	
-	if ( uiWorkTarget > 0 )
+	if ( ulWorkTarget > 0 && ( uiMotorIndex == ALL_MOTORS || uiMotorIndex < m_uiNumMotors ) )
 	{
-		if ( uiMotorIndex == MAX_MOTORS )
+		if ( uiMotorIndex == ALL_MOTORS )
 		{
 			// do all
-			for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+			for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
 			{
-				GetOilerMotor ( i )->SetWorkThreshold ( uiWorkTarget );
+				GetOilerMotor ( i )->SetWorkThreshold ( ulWorkTarget );
 			}
 		}
 		else
 		{
-			GetOilerMotor ( uiMotorIndex )->SetWorkThreshold ( uiWorkTarget );
+			GetOilerMotor ( uiMotorIndex )->SetWorkThreshold ( ulWorkTarget );
 		}
 		bResult = true;
 	}
@@ -699,9 +1435,35 @@ bool OilerClass::SetStopTarget ( uint8_t uiWorkTarget, uint8_t uiMotorIndex )
 bool OilerClass::SetMotorWorkPinMode ( uint8_t uiMotorIndex, uint8_t uiMode )
 {
 	bool bResult = false;
-	if ( ( uiMode == INPUT || uiMode == INPUT_PULLUP ) && uiMotorIndex < m_Motors.uiNumMotors )
+	if ( ( uiMode == INPUT || uiMode == INPUT_PULLUP ) && uiMotorIndex < m_uiNumMotors )
+	{
+		// expander inputs have no pin mode
+		if ( !InputExpanderClass::IsExpanderPin ( m_pMotorInfo [ uiMotorIndex ].uiWorkPin ) )
+		{
+			pinMode ( m_pMotorInfo [ uiMotorIndex ].uiWorkPin, uiMode );
+		}
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Enables closed loop control of a motor's speed so that it delivers work units (oil drips) at the target interval, e.g. speeds up a pump when oil is cold
+/// </summary>
+/// <param name="uiMotorIndex">zero based index of motor</param>
+/// <param name="uiDripIntervalms">target milliseconds between drips, 0 disables control</param>
+/// <param name="uiKp">proportional gain in 1/256 drive level per ms of error</param>
+/// <param name="uiKi">integral gain in 1/256 drive level per ms of error per drip</param>
+/// <returns>true if valid motor index else false</returns>
+bool OilerClass::SetMotorDripRate ( uint8_t uiMotorIndex, uint16_t uiDripIntervalms, uint8_t uiKp, uint8_t uiKi )
+{
+	bool bResult = false;
+	if ( uiMotorIndex < m_uiNumMotors )
 	{
-		pinMode ( m_Motors.MotorInfo [ uiMotorIndex ].uiWorkPin, uiMode );
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		GetOilerMotor ( uiMotorIndex )->SetDripRate ( uiDripIntervalms, uiKp, uiKi );
+		SREG = uiSREG;
 		bResult = true;
 	}
 	return bResult;
@@ -713,7 +1475,7 @@ bool OilerClass::SetMotorWorkPinMode ( uint8_t uiMotorIndex, uint8_t uiMode )
 /// <param name="">none</param>
 void OilerClass::SetMotorsForward ( void )
 {
-	for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+	for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
 	{
 		SetMotorsForward ( i );
 	}
@@ -734,11 +1496,10 @@ void OilerClass::SetMotorsBackward ( uint8_t uiMotorIndex )
 /// </summary>
 void OilerClass::SetMotorsBackward ( void )
 {
-	for ( uint8_t i = 0; i < m_Motors.uiNumMotors; i++ )
+	for ( uint8_t i = 0; i < m_uiNumMotors; i++ )
 	{
 		SetMotorsBackward ( i );
 	}
 }
 
-OilerClass TheOiler;
 
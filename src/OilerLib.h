@@ -33,32 +33,116 @@
 
 #define		OILER_VERSION				"1.5.7"
 
-#define		MAX_MOTORS					6											// MAX the oiler can support
+#ifndef		OILER_MAX_MOTORS
+#define		OILER_MAX_MOTORS			6											// number of motors TheOiler can support, declare an OilerGroupClass<n> for a different number
+#endif
+#define		ALL_MOTORS					0xFF										// motor index meaning apply to all motors
+#ifndef		OILER_MOTOR_MASK_TYPE
+#define		OILER_MOTOR_MASK_TYPE		uint16_t									// one bit per motor so limits motors per oiler to 16, define as uint32_t for up to 32
+#endif
+#ifndef		OILER_MAX_MACHINES
+#define		OILER_MAX_MACHINES			2											// number of target machines an oiler's motors can be assigned to, max 3
+#endif
+#if OILER_MAX_MACHINES > 3
+#error OILER_MAX_MACHINES must be 3 or less
+#endif
+#define		OILER_METRICS				( 1 + 2 * OILER_MAX_MACHINES )				// elapsed time plus powered time and work of each machine, each metric has its own deadline queue
+#define		NO_MACHINE					0xFF										// motor has no target machine
+#ifndef		OILER_EVENT_QUEUE_SIZE
+#define		OILER_EVENT_QUEUE_SIZE		8											// events that can wait for Poll() in deferred mode less one, power of 2
+#endif
 #define		MOTOR_WORK_SIGNAL_MODE		FALLING										// Change in signal when motor output (eg oil seen) is signalled
 #define		MOTOR_WORK_SIGNAL_PINMODE	INPUT										// default value
 #define		ALERT_PIN_ERROR_STATE		HIGH										// default value
 #define		TIME_BETWEEN_OILING			30											// default value  - In seconds
+#define		POWERED_TIME_IDLE_CHECKMS	250UL										// while a machine has no power its powered time deadlines are checked at least this often
+#define		MAX_ALARM_DELAYMS			3600000UL									// deadlines further off are checked again after this long, keeps the alarm delay in timer ticks from overflowing
+#define		MAX_TIME_TARGETMS			0x7FFFFFFFUL								// longest restart or alert time, about 24 days, deadlines are compared by signed difference of 32 bit millis
 #define		NUM_MOTOR_WORK_EVENTS		1											// number of motor outputs (oil drips) after which motor is stopped and restarts waiting for mode threshold to occur
 #define		DEBOUNCE_THRESHOLD			150UL										// milliseconds, increase if drip sensor is registering too many drips per single drip
 
 #include "PCIHandler.h"
+#include "OutputExpander.h"
+#include "InputExpander.h"
 #include "RelayMotor.h"
 #include "FourPinStepperMotor.h"
 #include "TargetMachine.h"
+#include "DeadlineQueue.h"
+#include "EventQueue.h"
 
 class OilerClass
 {
+protected:
+	typedef union																	// storage for one motor of any type supported by AddMotor, sized at compile time so no heap is used
+	{
+		uint8_t					Relay [ sizeof ( StaticRelayMotorClass ) ];
+		uint8_t					Stepper [ sizeof ( StaticFourPinStepperMotorClass ) ];
+		uint32_t				ulAlign;											// ensure storage is aligned for any motor member
+		void*					pAlign;
+	} MOTOR_STORAGE;
+
+	typedef OILER_MOTOR_MASK_TYPE MOTOR_MASK;										// bit n set => motor n in given state
+
+	enum eStartMode { ON_TIME = 0, ON_POWERED_TIME, ON_TARGET_ACTIVITY, NONE };		// metric that restarts a motor, NONE is not a valid mode
+
+	typedef bool ( *MotorActionFn )( OilerMotorBaseClass* pMotor, OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam );	// passes event to motor of known type
+
+	typedef struct
+	{
+		uint8_t					uiWorkPin;											// Pin that signals when motor has completed a unit of work e.g. a drip of oil
+		uint8_t					uiIndex;											// zero based index of motor in oiler
+		OilerMotorBaseClass*	Motor;												// ptr to oiler motor
+		MotorActionFn			pfnAction;											// calls Action of motor's actual type
+		eStartMode				StartMode;											// metric that restarts motor, its restart and alert thresholds are in these units
+		uint8_t					uiMachine;											// index in m_pMachines of machine motor oils, NO_MACHINE if none
+		OilerClass*				pOiler;												// oiler that owns motor, allows work signal callback to find it
+		MOTOR_STORAGE			Storage;											// motor created by AddMotor is constructed here
+	} MOTOR_INFO;
+
+	OilerClass ( MOTOR_INFO* pMotorInfo, DeadlineQueueClass::DEADLINE* pDeadlines, uint8_t* pDeadlinePos, uint8_t* pPendingStarts, uint8_t uiMaxMotors, EventQueueClass::EVENT* pEvents, uint8_t uiEventQueueSize, TargetMachineClass* pMachine );	// storage for motors, OILER_METRICS deadline queues, pending starts and event queue is provided by OilerGroupClass
+
 public:
+	enum eStatus { OILING = 0, OFF, IDLE };											// IDLE => waiting for start event
+
+	typedef struct
+	{
+		OilerMotorBaseClass::eOilerMotorState	State;
+		uint32_t				ulWorkCount;										// work units (oil drips) seen since motor last started
+		uint32_t				ulRunningms;										// ms motor has been moving, 0 if not moving
+	} MOTOR_SNAPSHOT;
+
+	typedef struct
+	{
+		uint32_t				ulTimems;											// millis when snapshot taken
+		uint32_t				ulIdlems;											// ms since all motors stopped, 0 if oiling or off
+		eStatus					Status;
+		bool					bAlert;
+		uint8_t					uiNumMotors;										// motors in oiler, MOTOR_SNAPSHOT filled for no more than the number passed
+		uint8_t					uiPendingStarts;									// motors waiting to start as max moving motors are moving
+		OILER_MOTOR_MASK_TYPE	MovingMask;											// bit n set => motor n moving
+		OILER_MOTOR_MASK_TYPE	ErrorMask;											// bit n set => motor n has not completed work within alert threshold
+		uint8_t					uiNumMachines;										// machines added to oiler
+		uint32_t				ulMachineWorkUnits [ OILER_MAX_MACHINES ];			// work units of each machine since monitoring restarted
+		uint32_t				ulMachineActivems [ OILER_MAX_MACHINES ];			// ms each machine has had power since monitoring restarted
+		uint16_t				uiMachineRPM [ OILER_MAX_MACHINES ];				// work units per minute of each machine
+	} SNAPSHOT;
 
-	OilerClass ( TargetMachineClass* pMachine = NULL );
 	// Operations
 	bool				On ();														// Start all motors
 	void				Off ();														// Stop all motors
+	void				SetDeferredMode ( bool bDeferred );							// true => interrupts only queue events and Poll() must be called from loop() to process them
+	uint8_t				Poll ( void );												// in deferred mode processes queued events, returns number processed
 
-	void				AddMachine ( TargetMachineClass* pMachine );				// optionally called to inform oiler we have a target machine that can be queried
-	bool				AddMotor ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, uint8_t uiWorkPin, uint8_t uiWorkTarget = NUM_MOTOR_WORK_EVENTS );		// FourPin Stepper version
-	bool				AddMotor ( uint8_t uiRelayPin, uint8_t uiWorkPin, uint8_t uiWorkTarget = NUM_MOTOR_WORK_EVENTS );		// 1 pin relay version
+	bool				AddMachine ( TargetMachineClass* pMachine, uint8_t uiMotorIndex = ALL_MOTORS );	// optionally called to inform oiler we have a target machine that can be queried, ALL_MOTORS => all motors and those added later
+	bool				AddMotor ( uint8_t uiPin1, uint8_t uiPin2, uint8_t uiPin3, uint8_t uiPin4, uint32_t ulSpeed, uint8_t uiWorkPin, uint32_t ulWorkTarget = NUM_MOTOR_WORK_EVENTS );		// FourPin Stepper version
+	bool				AddMotor ( uint8_t uiRelayPin, uint8_t uiWorkPin, uint32_t ulWorkTarget = NUM_MOTOR_WORK_EVENTS );		// 1 pin relay version
+	template <class TMotor>
+	bool				AddMotor ( TMotor* pMotor )									// motor constructed by caller e.g. a global, for motor types not built in
+	{
+		return AddMotor ( pMotor, MotorAction<TMotor>, MotorWorkSignal<TMotor> );
+	}
 	void				SetAlert ( uint8_t uiAlertPin, uint32_t ulAlertThreshold );	// Set the pin to be signalled when oiling is delayed.
+	void				SetAlertms ( uint8_t uiAlertPin, uint32_t ulAlertThresholdms );	// as SetAlert but in milliseconds for motors restarted by time, work restarted motors keep their threshold
 	bool				SetAlertLevel ( uint8_t uiLevel );							// Set level of alert pin when in Alert State
 	void				SetMotorsBackward ( void );									// Set direction of all motors
 	void				SetMotorsBackward ( uint8_t uiMotorIndex );					// set direction of specified motor
@@ -66,76 +150,188 @@ public:
 	void				SetMotorsForward ( uint8_t uiMotorIndex );					// Set direction of specified motor
 	bool				SetMotorSensorDebounce ( uint8_t uiMotorIndex, uint16_t uiDelayms );	// Set debounce delay of specified motor
 	bool				SetMotorWorkPinMode ( uint8_t uiMotorIndex, uint8_t uiMode );	// set mode to INPUT or INPUT_PULLUP for input sensor of specified motor
-	bool				SetStartEventToTargetActiveTime ( uint16_t ulTargetSecs );	// set time target machine (eg lathe) has power to be event that causes motors to restart oiling
-	bool				SetStartEventToTargetWork ( uint16_t ulTargetUnits );		// set amount of work done by target machine ( eg lathe) to be event that causes motors to restart oiling
-	bool				SetStartEventToTime ( uint16_t ulElapsedSecs );				// set elapsed time to be event that causes motors to restart oiling
-	bool				SetStopTarget ( uint8_t uiWorkTarget, uint8_t uiMotorIndex = MAX_MOTORS );	// change the number of work units (drips) needed before motor stops, if motor not specified, apply to all motors
+	bool				SetMotorDripRate ( uint8_t uiMotorIndex, uint16_t uiDripIntervalms, uint8_t uiKp = DRIP_CONTROL_KP, uint8_t uiKi = DRIP_CONTROL_KI );	// adjust motor speed to hold target ms between drips, 0 to disable
+	bool				SetStartEventToTargetActiveTime ( uint32_t ulTargetSecs, uint8_t uiMotorIndex = ALL_MOTORS );	// set time target machine (eg lathe) has power to be event that causes motors to restart oiling
+	bool				SetStartEventToTargetActiveTimems ( uint32_t ulTargetms, uint8_t uiMotorIndex = ALL_MOTORS );	// as SetStartEventToTargetActiveTime but in milliseconds
+	bool				SetStartEventToTargetWork ( uint32_t ulTargetUnits, uint8_t uiMotorIndex = ALL_MOTORS );		// set amount of work done by target machine ( eg lathe) to be event that causes motors to restart oiling
+	bool				SetStartEventToTime ( uint32_t ulElapsedSecs, uint8_t uiMotorIndex = ALL_MOTORS );				// set elapsed time to be event that causes motors to restart oiling
+	bool				SetStartEventToTimems ( uint32_t ulElapsedms, uint8_t uiMotorIndex = ALL_MOTORS );				// as SetStartEventToTime but in milliseconds
+	bool				SetStopTarget ( uint32_t ulWorkTarget, uint8_t uiMotorIndex = ALL_MOTORS );	// change the number of work units (drips) needed before motor stops, if motor not specified, apply to all motors
+	void				SetMaxMovingMotors ( uint8_t uiMaxMoving );					// limit number of motors moving at once, others wait in turn to start, 0 => no limit
 	// Queries
 	bool				AllMotorsStopped ( void );									// true if no motors active
 	bool				IsIdle ();													// true if all motors are paused waiting for event to start again
 	bool				IsOff ( void );												// true if system is off
 	bool				IsOiling ( void );											// true if at least one motor is running (ie pumping oil)
-	bool				IsMonitoringTargetPower ( void );							// true if oiling starts as a result of target machine having power for configured seconds
-	bool				IsMonitoringTargetWork ( void );							// true if monitoring target machine completing configured units of work (e.g. number of revs of lathe spindle)
-	bool				IsMonitoringTime ( void );									// true if oiling starts as a result of configured number of seconds elapsing
+	bool				IsMonitoringTargetPower ( uint8_t uiMotorIndex = ALL_MOTORS );	// true if oiling starts as a result of target machine having power for configured seconds, ALL_MOTORS => any motor
+	bool				IsMonitoringTargetWork ( uint8_t uiMotorIndex = ALL_MOTORS );	// true if monitoring target machine completing configured units of work (e.g. number of revs of lathe spindle), ALL_MOTORS => any motor
+	bool				IsMonitoringTime ( uint8_t uiMotorIndex = ALL_MOTORS );		// true if oiling starts as a result of configured number of seconds elapsing, ALL_MOTORS => any motor
 	bool				IsMotorRunning ( uint8_t uiMotorNum );						// true if specified motor is running
 	bool				IsAlert ( void );											// true if in Alert state
 
-	uint16_t			GetMotorWorkCount ( uint8_t uiMotorNum );					// get number of work units (oil drips) seen from specified motor since last told to start
+	uint32_t			GetMotorWorkCount ( uint8_t uiMotorNum );					// get number of work units (oil drips) seen from specified motor since last told to start
 	uint32_t			GetTimeOilerIdle ( void );									// returns time in seconds the Oiler has been idle (all motors off)
 	uint32_t			GetTimeSinceMotorStarted ( uint8_t uiMotorIndex );			// returns time in seconds since motor started
+	bool				IsDeferredMode ( void );									// true if events are processed by Poll()
+	uint16_t			GetEventOverflowCount ( void );								// number of events lost in deferred mode as Poll() not called often enough
+	uint8_t				GetEventHighWater ( void );									// most events that have waited for Poll() at once
+	uint8_t				GetNumPendingStarts ( void );								// number of motors waiting to start as max moving motors are moving
+	uint8_t				GetSnapshot ( SNAPSHOT* pSnapshot, MOTOR_SNAPSHOT* pMotors = NULL, uint8_t uiMaxMotors = 0 );	// consistent copy of oiler, motor and machine state, returns number of motors filled, 0 if pSnapshot is NULL
 
 
 /*---------------------- INTERNAL USE - DO NOT USE -----------------------------------*/
 
-	OilerMotorClass*	GetOilerMotor ( uint8_t uiMotorIndex );						// Gets the instance of the specified motor
+	OilerMotorBaseClass*	GetOilerMotor ( uint8_t uiMotorIndex );					// Gets the instance of the specified motor
+	uint8_t				GetNumMotors ( void );										// number of motors added
+	uint8_t				GetMaxMotors ( void );										// number of motors that can be added
 	void				CheckMotors ();												// Used internally by interrupt handler to check if all motors are now off or idle
 	void				MotorWork ( uint8_t uiMotorIndex );							// Used internally to process a unit of work
 	void				ProcessTimerEvent ( void );									// Used internally to handle a time interrupt event
 
 protected:
-	enum eStartMode { ON_TIME = 0, ON_POWERED_TIME, ON_TARGET_ACTIVITY, NONE };
-	enum eStatus { OILING = 0, OFF, IDLE };											// IDLE => waiting for start event
+	bool				AddMotor ( OilerMotorBaseClass* pMotor, MotorActionFn pfnAction, PinCallback pfnWorkSignal );
+	bool				MotorAction ( uint8_t uiMotorIndex, OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam );
+	void				UpdateMotorState ( uint8_t uiMotorIndex );					// record state and next deadline of motor after it processed an event
+	void				RescheduleMotors ( void );									// recalculate deadlines of all motors after a threshold or mode change
+	bool				CanStartMotor ( void );										// true if a motor can start now without exceeding max moving motors
+	bool				BelowMaxMoving ( void );									// true if fewer than max moving motors are moving
+	void				QueueStart ( uint8_t uiMotorIndex );						// motor starts when another stops
+	void				StartPendingMotors ( void );								// start waiting motors whilst below max moving motors
+	void				ScheduleTimer ( void );										// arm timer or target machine work watches for nearest deadlines
+
+	template <class TMotor>
+	static bool			MotorAction ( OilerMotorBaseClass* pMotor, OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam );
+	template <class TMotor>
+	static void			MotorWorkSignal ( void* pContext, uint8_t uiPinState );	// called by interrupt when a motor work pin signals, context is the motor's MOTOR_INFO
+	static void			AlarmSignal ( void* pContext );							// called by timer interrupt when nearest time deadline may be reached, context is the oiler
+	static void			WorkTargetSignal ( void* pContext, uint32_t ulWorkUnits );	// called by target machine when its work units reach nearest deadline, context is the oiler
+	void				TimerDue ( void );											// called by interrupt when a deadline may be due, processes or queues timer event
+	void				ProcessPendingTimerEvent ( void );							// in deferred mode checks deadlines if a timer event is waiting
+
+	enum eDeferredEvent : uint8_t { EVENT_MOTOR_WORK = 0, EVENT_TIMER };			// events queued in deferred mode
 
 	void				ClearError ( void );
-	void				SetupMotorPins ( uint8_t uiWorkPin, uint8_t uiWorkTarget );
-	OilerMotorClass::eOilerMotorState	GetMotorState ( uint8_t uiMotorNum );		// get state of specified motor
-	eStartMode			GetStartMode ( void );
-	uint32_t			GetStartModeUnits ( void );
+	bool				SetupMotorPins ( uint8_t uiWorkPin, PinCallback pfnWorkSignal );
+	OilerMotorBaseClass::eOilerMotorState	GetMotorState ( uint8_t uiMotorNum );	// get state of specified motor
+	eStartMode			GetStartMode ( uint8_t uiMotorIndex );
+	static uint32_t		SecsToms ( uint32_t ulSecs );								// seconds as ms, limited to MAX_TIME_TARGETMS
+	uint8_t				GetMetric ( uint8_t uiMotorIndex );							// index of metric that restarts motor, 0 is elapsed time then powered time and work of each machine
+	uint32_t			GetMetricUnits ( uint8_t uiMetric );
+	uint32_t			GetMotorModeUnits ( uint8_t uiMotorIndex );					// current value of the metric that restarts motor
+	uint32_t			GetMotorAlertThreshold ( uint8_t uiMotorIndex );			// alert threshold in units of the metric that restarts motor
+	void				GetAllMetricUnits ( uint32_t* pulMetricUnits );				// current value of each metric used by a motor, read once for all motors
+	bool				IsMonitoring ( eStartMode Mode, uint8_t uiMotorIndex );
+	void				UpdateMetricsInUse ( void );
+	uint8_t				FindMachine ( TargetMachineClass* pMachine );				// index of machine in m_pMachines, added if new
+	bool				HasMachine ( uint8_t uiMotorIndex );						// true if motor, or all motors if ALL_MOTORS, has a machine
+	void				SetMotorMachine ( uint8_t uiMotorIndex, uint8_t uiMachine );
 	eStatus				GetStatus ( void );
-	uint32_t			GetMachinePoweredOnTime ( void );
-	uint32_t			GetMachineUnitCount ( void );								// return machine work units so far
+	uint32_t			GetMachinePoweredOnTime ( uint8_t uiMotorIndex );
+	uint32_t			GetMachineUnitCount ( uint8_t uiMotorIndex );				// return work units so far of machine motor oils
 	void				SetError ();
-	bool				SetStartMode ( eStartMode Mode, uint16_t uiModeTarget );
-	void				SetAlertThreshold ( uint32_t uiAlertThreshold );
+	bool				SetStartMode ( eStartMode Mode, uint32_t ulModeTarget, uint8_t uiMotorIndex = ALL_MOTORS );
+	void				SetMotorStartMode ( uint8_t uiMotorIndex, eStartMode Mode, uint32_t ulModeTarget );
+	void				SetAlertPin ( uint8_t uiAlertPin );
+	void				SetAlertThreshold ( uint32_t ulAlertThreshold );			// seconds for time restarted motors, work units for work restarted motors
+	void				SetAlertThresholdms ( uint32_t ulAlertThresholdms, uint32_t ulAlertThreshold );	// ms for time restarted motors, work units for work restarted motors
 
-	eStartMode			m_OilerMode;
+	eStartMode			m_OilerMode;												// start mode given to motors when added
 	eStatus				m_OilerStatus;
-	TargetMachineClass* m_pMachine;
+	TargetMachineClass* m_pMachines [ OILER_MAX_MACHINES ];						// machines motors can be assigned to
+	uint8_t				m_uiNumMachines;
+	uint8_t				m_uiMachine;												// machine given to motors when added, NO_MACHINE if none
 	uint32_t			m_timeOilerStopped;
 	uint8_t				m_uiAlertPin;												// pin to signal if Alert to be generated
-	uint32_t			m_ulAlertThreshold;											// Value of metric used to check if oilermotor should be in Error mode
+	uint32_t			m_ulAlertThreshold;											// work units after a work restarted motor starts that it should be in Error mode if still moving
+	uint32_t			m_ulAlertThresholdms;										// as m_ulAlertThreshold in ms for time restarted motors
 	uint8_t				m_uiALertOnValue;											// value to set pin when alert is on
 	bool				m_bAlert;													// true when in alert state
 
-	union																			// These values are mutually exclsuive so use same storage
-	{
-		uint16_t m_uiRestartTarget;
-		uint16_t m_uiWorkTarget;
-	};
+	uint32_t			m_ulRestartTarget;											// restart target given to motors when added, ms for time modes
+	uint8_t				m_uiMetricsInUse;											// bit per metric used by at least one motor
 
-	typedef struct
+	uint8_t					m_uiNumMotors;											// number of motors added
+	uint8_t					m_uiMaxMotors;											// size of motor storage
+	MOTOR_INFO*				m_pMotorInfo;											// keep track of each motor used by oiler
+	volatile MOTOR_MASK		m_MovingMask;											// motors that are moving
+	volatile MOTOR_MASK		m_IdleMask;												// motors that are idle waiting for restart event
+	volatile MOTOR_MASK		m_ErrorMask;											// motors that have not completed work within alert threshold
+	volatile MOTOR_MASK		m_PendingMask;											// motors waiting in m_pPendingStarts
+	uint8_t*				m_pPendingStarts;										// FIFO of motors waiting to start, a motor is in it at most once
+	uint8_t					m_uiPendingHead;										// index of first motor in m_pPendingStarts
+	uint8_t					m_uiPendingCount;										// number of motors in m_pPendingStarts
+	uint8_t					m_uiStartingCount;										// motors taken from m_pPendingStarts and not yet started, counted as moving
+	uint8_t					m_uiMaxMoving;											// max motors moving at once, 0 => no limit
+	DeadlineQueueClass		m_Deadlines [ OILER_METRICS ];							// per metric, restart deadline of idle motors and alert deadline of moving motors in that metric's units
+	volatile bool			m_bDeferred;											// true if interrupts queue events for Poll()
+	volatile bool			m_bTimerEventPending;									// true if a timer event is waiting for Poll(), queued or flagged only if the queue was full, only one is needed
+	EventQueueClass			m_Events;												// events waiting for Poll() in deferred mode
+};
+
+/// <summary>
+/// Passes event to motor, the motor type is known so the motor's state machine is called directly
+/// </summary>
+/// <param name="pMotor">motor of type TMotor</param>
+/// <param name="eAction">event</param>
+/// <param name="ulParam">current value of start mode metric</param>
+/// <returns>true if motor state changed</returns>
+template <class TMotor>
+bool OilerClass::MotorAction ( OilerMotorBaseClass* pMotor, OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam )
+{
+	return static_cast<TMotor*> ( pMotor )->Action ( eAction, ulParam );
+}
+
+/// <summary>
+/// Called by interrupt routine handling signal from pin indicating a motor has produced a unit of work
+/// </summary>
+/// <param name="pContext">MOTOR_INFO of motor that signalled, motor is of type TMotor</param>
+/// <param name="uiPinState">level of work pin, not used</param>
+template <class TMotor>
+void OilerClass::MotorWorkSignal ( void* pContext, uint8_t uiPinState )
+{
+	MOTOR_INFO* pInfo = (MOTOR_INFO*)pContext;
+	if ( pInfo->pOiler->m_bDeferred )
 	{
-		uint8_t					uiWorkPin;											// Pin that signals when motor has completed a unit of work e.g. a drip of oil
-		OilerMotorClass*		Motor;												// ptr to type of oiler motor class
-	} MOTOR_INFO;
-	struct																			
+		// Poll () processes it
+		pInfo->pOiler->m_Events.Push ( EVENT_MOTOR_WORK, pInfo->uiIndex );
+	}
+	else
+	{
+		pInfo->Motor->SetWorkSignalTime ( millis () );
+		bool bChanged = static_cast<TMotor*> ( pInfo->Motor )->Action ( OilerMotorBaseClass::WORK_SEEN, pInfo->pOiler->GetMotorModeUnits ( pInfo->uiIndex ) );
+		pInfo->pOiler->UpdateMotorState ( pInfo->uiIndex );
+		if ( bChanged )
+		{
+			// get here if state changed, check if all motors now idle
+			pInfo->pOiler->CheckMotors ();
+		}
+	}
+}
+
+/// <summary>
+/// Oiler with storage for a compile time number of motors, e.g. OilerGroupClass<12> for a 12 pump oiler
+/// <para>the mcu can monitor MAX_PCI_PINS (default 8) work pins across all oilers and machines, more pumps need their drip sensors on expander
+/// inputs, see EXPANDER_INPUT(), or MAX_PCI_PINS defined larger. AddMotor() returns false for a motor whose work pin cannot be monitored</para>
+/// <para>uiEventQueueSize is the size of the queue used in deferred mode</para>
+/// </summary>
+template <uint8_t uiMaxMotors, uint8_t uiEventQueueSize = OILER_EVENT_QUEUE_SIZE>
+class OilerGroupClass : public OilerClass
+{
+public:
+	OilerGroupClass ( TargetMachineClass* pMachine = NULL ) : OilerClass ( m_MotorInfo, m_DeadlineStorage, m_uiDeadlinePos, m_uiPendingStarts, uiMaxMotors, m_EventStorage, uiEventQueueSize, pMachine )
 	{
-		uint8_t					uiNumMotors;
-		MOTOR_INFO				MotorInfo [ MAX_MOTORS ];
-	}	m_Motors;																	// keep track of each motor used by oiler
+		static_assert ( uiMaxMotors <= sizeof ( MOTOR_MASK ) * 8, "more motors than bits in OILER_MOTOR_MASK_TYPE" );
+		static_assert ( uiEventQueueSize >= 2 && uiEventQueueSize <= 128 && ( uiEventQueueSize & ( uiEventQueueSize - 1 ) ) == 0, "event queue size must be a power of 2 from 2 to 128" );
+	}
+
+protected:
+	MOTOR_INFO				m_MotorInfo [ uiMaxMotors ];
+	DeadlineQueueClass::DEADLINE	m_DeadlineStorage [ OILER_METRICS * uiMaxMotors ];
+	uint8_t					m_uiDeadlinePos [ OILER_METRICS * uiMaxMotors ];
+	uint8_t					m_uiPendingStarts [ uiMaxMotors ];
+	EventQueueClass::EVENT	m_EventStorage [ uiEventQueueSize ];
 };
 
-extern OilerClass TheOiler;
+extern OilerGroupClass<OILER_MAX_MOTORS> TheOiler;
 
 #endif
@@ -6,106 +6,155 @@
 //
 #include "OilerMotor.h"
 
-OilerMotorClass::OilerMotorClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint16_t uiRestartThreshold ) : MotorClass ( ulSpeed ), m_MotorState ( &MotorTable [ 0 ], ( sizeof ( MotorTable ) / sizeof ( MotorTable [ 0 ] ) ) )
+OilerMotorBaseClass::OilerMotorBaseClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulRestartThreshold ) : MotorClass ( ulSpeed )
 {
 	m_uiWorkPin					= uiWorkPin;
 	m_ulLastWorkSignal			= 0UL;
+	m_ulWorkSignalTime			= 0UL;
 	m_bError					= false;
+	m_uiDriveLevel				= DRIVE_LEVEL_MAX;
+	m_eOilerState				= OFF;
 	SetModeMetricAtStart ( 0UL );
 	SetModeMetricAtIdle ( 0UL );
 	SetWorkThreshold ( ulThreshold );
 	SetDebouncems ( ulDebouncems );
-	SetRestartThreshold ( uiRestartThreshold );
+	SetRestartThreshold ( ulRestartThreshold );
 	SetAlertThreshold ( 0UL );
 	ResetWorkUnits ();
 }
 
-bool OilerMotorClass::On ( void )
+bool OilerMotorBaseClass::On ( void )
 {
 	ResetWorkUnits ();
 	return MotorClass::On ();
 }
 
-bool OilerMotorClass::Off ( void )
+bool OilerMotorBaseClass::Off ( void )
 {
 	return MotorClass::Off ();
 }
 
-void OilerMotorClass::IncWorkUnits ( uint16_t uiNewUnits )
+void OilerMotorBaseClass::IncWorkUnits ( uint16_t uiNewUnits )
+{
+	m_ulWorkCount += uiNewUnits;
+}
+
+void OilerMotorBaseClass::ResetWorkUnits ( void )
+{
+	m_ulWorkCount = 0;
+}
+
+uint32_t OilerMotorBaseClass::GetWorkUnits ()
 {
-	m_uiWorkCount += uiNewUnits;
+	return m_ulWorkCount;
 }
 
-void OilerMotorClass::ResetWorkUnits ( void )
+uint8_t OilerMotorBaseClass::GetWorkPin ( void )
 {
-	m_uiWorkCount = 0;
+	return m_uiWorkPin;
 }
 
-uint16_t OilerMotorClass::GetWorkUnits ()
+void OilerMotorBaseClass::SetWorkSignalTime ( uint32_t ulTimems )
 {
-	return m_uiWorkCount;
+	m_ulWorkSignalTime = ulTimems;
 }
 
-void OilerMotorClass::SetDebouncems ( uint32_t ulDebouncems )
+void OilerMotorBaseClass::SetDebouncems ( uint32_t ulDebouncems )
 {
 	m_ulDebounceMin = ulDebouncems;
 }
 
-void OilerMotorClass::SetWorkThreshold ( uint32_t ulWorkThreshold )
+void OilerMotorBaseClass::SetWorkThreshold ( uint32_t ulWorkThreshold )
 {
 	m_ulWorkThreshold = ulWorkThreshold;
 }
 
-void OilerMotorClass::SetRestartThreshold ( uint16_t uiRestartValue )
+void OilerMotorBaseClass::SetRestartThreshold ( uint32_t ulRestartValue )
 {
-	m_uiRestartValue = uiRestartValue;
+	m_ulRestartValue = ulRestartValue;
 }
 
-void OilerMotorClass::SetAlertThreshold ( uint32_t ulAlertThreshold )
+void OilerMotorBaseClass::SetAlertThreshold ( uint32_t ulAlertThreshold )
 {
 	m_ulAlertThreshold = ulAlertThreshold;
 }
 
-void OilerMotorClass::SetModeMetricAtStart ( uint32_t ulMetric )
+uint32_t OilerMotorBaseClass::GetRestartThreshold ( void )
+{
+	return m_ulRestartValue;
+}
+
+uint32_t OilerMotorBaseClass::GetAlertThreshold ( void )
+{
+	return m_ulAlertThreshold;
+}
+
+void OilerMotorBaseClass::SetModeMetricAtStart ( uint32_t ulMetric )
 {
 	m_ulModeMetricAtStart = ulMetric;
 }
 
-void OilerMotorClass::SetModeMetricAtIdle ( uint32_t ulMetric )
+void OilerMotorBaseClass::SetModeMetricAtIdle ( uint32_t ulMetric )
 {
 	m_ulModeMetricAtIdle = ulMetric;
 }
 
-inline uint32_t OilerMotorClass::GetModeMetricAtStart ( void )
+/// <summary>
+/// Enables or disables closed loop control of the drive level to hold a target interval between work units (oil drips)
+/// </summary>
+/// <param name="uiIntervalms">target milliseconds between work units, 0 disables control and leaves motor at current drive level</param>
+/// <param name="uiKp">proportional gain</param>
+/// <param name="uiKi">integral gain</param>
+void OilerMotorBaseClass::SetDripRate ( uint16_t uiIntervalms, uint8_t uiKp, uint8_t uiKi )
+{
+	if ( uiIntervalms == 0 )
+	{
+		m_DripControl.Disable ();
+	}
+	else
+	{
+		m_DripControl.Enable ( uiIntervalms, uiKp, uiKi, GetDriveLevel () );
+	}
+}
+
+/// <summary>
+/// Sets the drive level, motor types hide this to apply it to the motor hardware
+/// </summary>
+/// <param name="uiLevel">DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX</param>
+void OilerMotorBaseClass::SetDriveLevel ( uint8_t uiLevel )
 {
-	return m_ulModeMetricAtStart;
+	m_uiDriveLevel = uiLevel;
 }
 
-inline uint32_t OilerMotorClass::GetModeMetricAtIdle ( void )
+uint8_t OilerMotorBaseClass::GetDriveLevel ( void )
 {
-	return m_ulModeMetricAtIdle;
+	return m_uiDriveLevel;
 }
 
-bool OilerMotorClass::Action ( eOilerMotorEvents eAction, uint32_t ulParam )
+uint32_t OilerMotorBaseClass::GetModeMetricAtStart ( void )
 {
-	return m_MotorState.ProcessEvent ( this, eAction, ulParam );
+	return m_ulModeMetricAtStart;
 }
 
+uint32_t OilerMotorBaseClass::GetModeMetricAtIdle ( void )
+{
+	return m_ulModeMetricAtIdle;
+}
 
 /// <summary>
 /// Get the state table state of motor
 /// </summary>
 /// <returns>current state</returns>
-OilerMotorClass::eOilerMotorState OilerMotorClass::GetOilerMotorState ()
+OilerMotorBaseClass::eOilerMotorState OilerMotorBaseClass::GetOilerMotorState ()
 {
-	return (eOilerMotorState)m_MotorState.GetCurrentState ();
+	return m_eOilerState;
 }
 
 /// <summary>
 /// Checks if motor is idle
 /// </summary>
 /// <returns>true if idle, else false</returns>
-bool OilerMotorClass::IsIdle ()
+bool OilerMotorBaseClass::IsIdle ()
 {
 	return GetOilerMotorState () == IDLE ? true : false;
 }
@@ -114,7 +163,7 @@ bool OilerMotorClass::IsIdle ()
 /// Checks if motor is moving
 /// </summary>
 /// <returns>true if moving, else false</returns>
-bool OilerMotorClass::IsMoving ()
+bool OilerMotorBaseClass::IsMoving ()
 {
 	return GetOilerMotorState () == MOVING ? true : false;
 }
@@ -123,7 +172,7 @@ bool OilerMotorClass::IsMoving ()
 /// Checks if motor is off
 /// </summary>
 /// <returns>true if off, else false</returns>
-bool OilerMotorClass::IsOff ()
+bool OilerMotorBaseClass::IsOff ()
 {
 	return GetOilerMotorState () == OFF ? true : false;
 }
@@ -131,103 +180,30 @@ bool OilerMotorClass::IsOff ()
 /// returns true if the motor has not completed its work output before set threshold
 /// </summary>
 /// <returns>true if work delayed else false</returns>
-bool OilerMotorClass::IsInError ()
+bool OilerMotorBaseClass::IsInError ()
 {
 	return m_bError;
 }
 
-/// <summary>
-/// State table function called to start motor moving
-/// </summary>
-/// <returns>new state</returns>
-uint16_t OilerMotorClass::TurnOn ( uint32_t ulParam )
+OilerMotorClass::OilerMotorClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulRestartThreshold ) : OilerMotorLogicClass<OilerMotorClass> ( uiWorkPin, ulThreshold, ulDebouncems, ulSpeed, ulRestartThreshold )
 {
-	On ();								// Update status
-	Start ();							// physically start motor
-	SetModeMetricAtStart ( ulParam );
-	return MOVING;						// new state
 }
 
-/// <summary>
-/// State table function called to turn off motor
-/// </summary>
-/// <returns>new state</returns>
-uint16_t OilerMotorClass::TurnOff ( uint32_t ulParam )
+bool OilerMotorClass::On ( void )
 {
-	Off ();								// Update status
-	PowerOff ();						// physically turn off
-	return OFF;							// new state
+	return OilerMotorBaseClass::On ();
 }
 
-/// <summary>
-/// Checks if we have equalled or exceeded the threshold set for units of work (oil drips) and idles motor if true
-/// </summary>
-/// <returns>new state or existing state</returns>
-uint16_t OilerMotorClass::CheckWork ( uint32_t ulParam )
-{
-	uint16_t uiResult;
-
-	// check for spurious signal
-	if ( millis () - m_ulLastWorkSignal >= m_ulDebounceMin )
-	{
-		IncWorkUnits ( 1 );
-		if ( GetWorkUnits() >= m_ulWorkThreshold )
-		{
-			uiResult = IDLE;			// new state
-			Idle ();					// Physically idle motor
-			OilerMotorClass::Off ();	// update class, don't invoke
-			SetModeMetricAtIdle ( ulParam );
-			m_bError = false;
-		}
-		else
-		{
-			// not met threshold
-			uiResult = DoNothing (0);
-		}
-	}
-	else
-	{
-		// ignore bad signal
-		uiResult = DoNothing (0);
-	}
-	return uiResult;
-}
-/// <summary>
-/// Called to set error state if still oiling beyond alert threshold
-/// </summary>
-/// <param name="ulParam">Current value of metric to be measured against alert threshold</param>
-/// <returns>false, does not change OilerMotor processing state</returns>
-uint16_t OilerMotorClass::CheckAlert ( uint32_t ulParam )
+bool OilerMotorClass::Off ( void )
 {
-	m_bError = ( ulParam - GetModeMetricAtStart() ) >= m_ulAlertThreshold ? true : false;
-	return DoNothing ( 0UL );
+	return OilerMotorBaseClass::Off ();
 }
 
 /// <summary>
-/// Checks to see if the motor should restart after a set time has elapsed
+/// Sets the drive level, derived classes override to apply it to the motor hardware
 /// </summary>
-/// <returns></returns>
-uint16_t OilerMotorClass::CheckRestart ( uint32_t ulParam )
+/// <param name="uiLevel">DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX</param>
+void OilerMotorClass::SetDriveLevel ( uint8_t uiLevel )
 {
-	uint16_t uiResult;
-
-	if ( ( ulParam - GetModeMetricAtStart () ) >= m_uiRestartValue )
-	{
-		// time to start motor
-		uiResult = TurnOn ( ulParam );
-	}
-	else
-	{
-		uiResult = DoNothing (0);
-	}
-	return uiResult;
+	OilerMotorBaseClass::SetDriveLevel ( uiLevel );
 }
-
-/// <summary>
-/// Keeps state of state machine unchanged
-/// </summary>
-/// <returns>existing state</returns>
-uint16_t OilerMotorClass::DoNothing ( uint32_t ulParam )
-{
-	return m_MotorState.GetCurrentState ();
-}
\ No newline at end of file
@@ -8,126 +8,341 @@
 //		idle the motor when a specified threshold of work units is met
 //		restart the motor after a specified time (in seconds) is passed
 //
-// This class implements a state table to control how the motor state changes in response to external events (e.g. signal work done, timer tick, on or off request
+// The state machine controlling how the motor state changes in response to external events (e.g. signal work done, timer tick, on or off request) is
+// implemented by OilerMotorLogicClass, a template that calls the functions of the actual motor type to idle, stop and start the motor.
 //
-// Different types of motos used to do oiling e.g. a stepper motor or simple dc motor controlled by a relay switch derive from this class and override specific
-// functions to idle, stop and start the motor.
+// There are two families of motor built from it
+//		OilerMotorClass and its derivatives (e.g. RelayMotorClass) use virtual functions, so different types of motor can be handled through one pointer type
+//		Static motors (e.g. StaticRelayMotorClass) have no virtual functions, the motor type is known at compile time so the state machine, drip and timer
+//		processing compile into direct calls that can be inlined and the object has no vtable pointer. OilerClass uses these for the built in motor types.
+//
+// Different types of motors used to do oiling e.g. a stepper motor or simple dc motor controlled by a relay switch provide functions to idle, stop and start the motor.
 //
 #ifndef _OILER_MOTOR_h
 #define _OILER_MOTOR_h
 
 #include "Motor.h"
-class OilerMotorClass : public MotorClass
-{
-protected:
-	class StateTable
-	{
-		typedef uint16_t ( OilerMotorClass::*OilerMotorStateCallback )( uint32_t ulParam );
-	public:
-		typedef struct
-		{
-			uint16_t				uiCurrentState;				// Current state
-			uint16_t				uiEventId;					// Event that happened
-			OilerMotorStateCallback	FnState;					// function to be called to process this event when in this state
-		} STATE_TABLE_ENTRY, * PSTATE_TABLE_ENTRY;
-
-		StateTable ( PSTATE_TABLE_ENTRY pTable, uint16_t uiNumEntries );
-		uint16_t	GetCurrentState ( void );
-		bool		ProcessEvent ( OilerMotorClass* pMotor, uint16_t uiEventId, uint32_t ulParam );
-
-
-	protected:
-		PSTATE_TABLE_ENTRY	m_pTable;							// ptr to array of table entries
-		uint16_t			m_uiNumTableEntries;				// number of table entries
-		uint16_t			m_uiCurrentState;					// Current State
-
-		void		SetState ( uint16_t uiNewState );
-	};
-
-public:
-	// State table functions
-	virtual uint16_t		TurnOn ( uint32_t ulParam );		// function called to turn motor on and return new state
-	virtual uint16_t		TurnOff ( uint32_t ulParam );		// function called to turn motor off and return new state
-	virtual uint16_t		CheckWork ( uint32_t ulParam );		// function called to check if sufficient oil has been produced and to idle motor if it has
-	virtual uint16_t		CheckAlert ( uint32_t ulParam );	// function called to check if threshold exceeded for oil to be produced
-	virtual uint16_t		CheckRestart ( uint32_t ulParam );	// function called to check if restart required
-	virtual uint16_t		DoNothing ( uint32_t ulParam );
-
-	// abstract function that derived classes must implement
-	virtual void			Idle () = 0;						// Idle motor, still energised but not moving
-	virtual void			Start () = 0;						// Start motor
-	virtual void			PowerOff () = 0;					// power off motor
-
-protected:
-	uint8_t		m_uiWorkPin;									// input Pin that indicates when a unit of work has been seen
-	uint32_t	m_ulWorkThreshold;								// number of units to be seen before idling motor
-	uint32_t	m_ulDebounceMin;								// number of milliseconds that must elapse before a subsequent workpin signal is treated as real
-	uint16_t	m_uiWorkCount;									// number of work units seen since last reset
-	uint32_t	m_ulLastWorkSignal;								// time of last signal in millis
-	uint16_t	m_uiRestartValue;								// Value after which motor should be restarted
-	uint32_t	m_ulAlertThreshold;								// if beyond this threshold then the motor is taking too long to oil
-	bool		m_bError;										// true if motor not completed work within alert threshold
-	uint32_t	m_ulModeMetricAtStart;							// value of mode metric being used when motor last started
-	uint32_t	m_ulModeMetricAtIdle;							// value of mode metric being used when motor last idled
-	StateTable	m_MotorState;
-
-/*
-*	Oiler Motor State table
-*/
+#include "DripRateController.h"
 
+/// <summary>
+/// Data and queries common to all oiler motors, no virtual functions
+/// </summary>
+class OilerMotorBaseClass : public MotorClass
+{
 public:
-	enum eOilerMotorState : uint16_t							// States motor can be in
+	enum eOilerMotorState : uint8_t								// States motor can be in
 	{
 		OFF = 0,			// OFF => not energised, default state at start must be 0
 		IDLE,				// IDLE imples not moving but is being held stationary
 		MOVING
 	};
 
-	enum eOilerMotorEvents : uint16_t							// events that can change motor state
+	enum eOilerMotorEvents : uint8_t							// events that can change motor state
 	{
 		TURN_ON = 0,		// Request to turn on
 		TURN_OFF,			// Request to turn off
 		WORK_SEEN,			// Output seen
 		TIMER				// Timer check
 	};
-private:
-	StateTable::STATE_TABLE_ENTRY	MotorTable [ 12 ]
-	{
-		{ OFF,		TURN_ON,	&OilerMotorClass::TurnOn },				// start motor moving
-		{ OFF,		TURN_OFF,	&OilerMotorClass::DoNothing },			// if off no need to turn off, ignore
-		{ OFF,		WORK_SEEN,	&OilerMotorClass::DoNothing },			// if off and oil drips output, ignore
-		{ OFF,		TIMER,		&OilerMotorClass::DoNothing },			// if off ignore time
-		{ MOVING,	TURN_ON,	&OilerMotorClass::DoNothing },			// if moving no need to start moving, ignore
-		{ MOVING,	TURN_OFF,	&OilerMotorClass::TurnOff },			// if moving, turn off
-		{ MOVING,	WORK_SEEN,	&OilerMotorClass::CheckWork },			// if moving and oil drip see check if enough produced and idle motor
-		{ MOVING,	TIMER,		&OilerMotorClass::CheckAlert },			// if moving, check if taking too long
-		{ IDLE,		TURN_ON,	&OilerMotorClass::TurnOn },				// start motor moving
-		{ IDLE,		TURN_OFF,	&OilerMotorClass::TurnOff },			// turn off
-		{ IDLE,		WORK_SEEN,	&OilerMotorClass::DoNothing },			// oil produced whilst idle - ignore
-		{ IDLE,		TIMER,		&OilerMotorClass::CheckRestart }			// see if we need to restart based on time idle
-	};
 
-public:
-	OilerMotorClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint16_t uiRestartThreshold );
-	virtual		bool On ( void );
-	virtual		bool Off ( void );
+	OilerMotorBaseClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulRestartThreshold );
+	bool		On ( void );
+	bool		Off ( void );
 	uint32_t	GetModeMetricAtStart ( void );
 	uint32_t	GetModeMetricAtIdle ( void );
 	void		IncWorkUnits ( uint16_t uiNewUnits = 1 );
 	void		ResetWorkUnits ( void );
 	void		SetDebouncems ( uint32_t ulDebouncems );
 	void		SetWorkThreshold ( uint32_t ulWorkThreshold );
-	void		SetRestartThreshold ( uint16_t uiRestartValue );
+	void		SetRestartThreshold ( uint32_t ulRestartValue );
 	void		SetAlertThreshold ( uint32_t ulAlertThreshold );
 	void		SetModeMetricAtStart ( uint32_t ulMetric );
 	void		SetModeMetricAtIdle ( uint32_t ulMetric );
-	bool		Action ( eOilerMotorEvents eAction, uint32_t ulParam = 0UL );
-	uint16_t	GetWorkUnits ();
+	void		SetWorkSignalTime ( uint32_t ulTimems );		// time work pin signalled, must be set before WORK_SEEN event as event may be processed later
+	void		SetDripRate ( uint16_t uiIntervalms, uint8_t uiKp = DRIP_CONTROL_KP, uint8_t uiKi = DRIP_CONTROL_KI );	// hold target ms between work units, 0 to disable
+	void		SetDriveLevel ( uint8_t uiLevel );				// record drive level, motor types hide this to apply it to their actuator
+	uint8_t		GetDriveLevel ( void );
+	uint32_t	GetWorkUnits ();
+	uint8_t		GetWorkPin ( void );
+	uint32_t	GetRestartThreshold ( void );
+	uint32_t	GetAlertThreshold ( void );
 	eOilerMotorState GetOilerMotorState ();
 	bool		IsIdle ();
 	bool		IsMoving ();
 	bool		IsOff ();
 	bool		IsInError ();
+
+protected:
+	uint8_t		m_uiWorkPin;									// input Pin that indicates when a unit of work has been seen
+	uint32_t	m_ulWorkThreshold;								// number of units to be seen before idling motor
+	uint32_t	m_ulDebounceMin;								// number of milliseconds that must elapse before a subsequent workpin signal is treated as real
+	uint32_t	m_ulWorkCount;									// number of work units seen since last reset
+	uint32_t	m_ulLastWorkSignal;								// time of last signal in millis
+	uint32_t	m_ulWorkSignalTime;								// time of signal being processed in millis
+	uint32_t	m_ulRestartValue;								// Value after which motor should be restarted, ms for time modes
+	uint32_t	m_ulAlertThreshold;								// if beyond this threshold then the motor is taking too long to oil
+	bool		m_bError;										// true if motor not completed work within alert threshold
+	uint32_t	m_ulModeMetricAtStart;							// value of mode metric being used when motor last started
+	uint32_t	m_ulModeMetricAtIdle;							// value of mode metric being used when motor last idled
+	uint8_t		m_uiDriveLevel;									// current drive level DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX
+	DripRateControllerClass	m_DripControl;						// optional controller adjusting drive level to hold a target interval between work units
+	volatile eOilerMotorState	m_eOilerState;					// current state of state machine
 };
 
-#endif
\ No newline at end of file
+/// <summary>
+/// Oiler motor state machine. TMotor is the motor type whose On, Off, Idle, Start, PowerOff and SetDriveLevel are called, TBase is the class it extends
+/// </summary>
+template <class TMotor, class TBase = OilerMotorBaseClass>
+class OilerMotorLogicClass : public TBase
+{
+public:
+	OilerMotorLogicClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulRestartThreshold ) : TBase ( uiWorkPin, ulThreshold, ulDebouncems, ulSpeed, ulRestartThreshold )
+	{
+	}
+
+	bool		Action ( OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam = 0UL );
+
+protected:
+	// State machine functions
+	uint8_t		ProcessEvent ( uint8_t uiEventId, uint32_t ulParam );
+	uint8_t		TurnOn ( uint32_t ulParam );				// function called to turn motor on and return new state
+	uint8_t		TurnOff ( uint32_t ulParam );				// function called to turn motor off and return new state
+	uint8_t		CheckWork ( uint32_t ulParam );				// function called to check if sufficient oil has been produced and to idle motor if it has
+	uint8_t		CheckAlert ( uint32_t ulParam );			// function called to check if threshold exceeded for oil to be produced
+	uint8_t		CheckRestart ( uint32_t ulParam );			// function called to check if restart required
+	uint8_t		DoNothing ( uint32_t ulParam );
+
+	inline TMotor& Motor ( void )
+	{
+		return static_cast<TMotor&> ( *this );
+	}
+};
+
+/// <summary>
+/// Oiler motor with virtual functions, derive from this to add a type of motor that can be selected at run time
+/// </summary>
+class OilerMotorClass : public OilerMotorLogicClass<OilerMotorClass>
+{
+public:
+	OilerMotorClass ( uint8_t uiWorkPin, uint32_t ulThreshold, uint32_t ulDebouncems, uint32_t ulSpeed, uint32_t ulRestartThreshold );
+	virtual bool			On ( void );
+	virtual bool			Off ( void );
+
+	// abstract function that derived classes must implement
+	virtual void			Idle () = 0;						// Idle motor, still energised but not moving
+	virtual void			Start () = 0;						// Start motor
+	virtual void			PowerOff () = 0;					// power off motor
+	virtual void			SetDriveLevel ( uint8_t uiLevel );	// set how hard the motor is driven, derived classes map this onto their actuator
+};
+
+/*
+*	Oiler Motor State table
+*
+*		State		Event		Function
+*		OFF,		TURN_ON,	TurnOn			start motor moving
+*		OFF,		TURN_OFF,	DoNothing		if off no need to turn off, ignore
+*		OFF,		WORK_SEEN,	DoNothing		if off and oil drips output, ignore
+*		OFF,		TIMER,		DoNothing		if off ignore time
+*		MOVING,		TURN_ON,	DoNothing		if moving no need to start moving, ignore
+*		MOVING,		TURN_OFF,	TurnOff			if moving, turn off
+*		MOVING,		WORK_SEEN,	CheckWork		if moving and oil drip see check if enough produced and idle motor
+*		MOVING,		TIMER,		CheckAlert		if moving, check if taking too long
+*		IDLE,		TURN_ON,	TurnOn			start motor moving
+*		IDLE,		TURN_OFF,	TurnOff			turn off
+*		IDLE,		WORK_SEEN,	DoNothing		oil produced whilst idle - ignore
+*		IDLE,		TIMER,		CheckRestart	see if we need to restart based on time idle
+*/
+
+/// <summary>
+/// Called to process a new event. If match not found, does nothing
+/// </summary>
+/// <param name="eAction">event to process</param>
+/// <param name="ulParam">current value of start mode metric</param>
+/// <returns>true if state changes, else false</returns>
+template <class TMotor, class TBase>
+bool OilerMotorLogicClass<TMotor, TBase>::Action ( OilerMotorBaseClass::eOilerMotorEvents eAction, uint32_t ulParam )
+{
+	uint8_t uiNewState = ProcessEvent ( eAction, ulParam );
+	bool bResult = uiNewState != this->m_eOilerState;
+	this->m_eOilerState = (OilerMotorBaseClass::eOilerMotorState)uiNewState;
+	return bResult;
+}
+
+/// <summary>
+/// Finds the function for the event in the current state, as per the state table above, and calls it
+/// </summary>
+/// <param name="uiEventId">Id of event to process</param>
+/// <param name="ulParam">current value of start mode metric</param>
+/// <returns>new state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::ProcessEvent ( uint8_t uiEventId, uint32_t ulParam )
+{
+	uint8_t uiResult = this->m_eOilerState;
+	switch ( this->m_eOilerState )
+	{
+		case OilerMotorBaseClass::OFF:
+			if ( uiEventId == OilerMotorBaseClass::TURN_ON )
+			{
+				uiResult = TurnOn ( ulParam );
+			}
+			break;
+
+		case OilerMotorBaseClass::MOVING:
+			switch ( uiEventId )
+			{
+				case OilerMotorBaseClass::TURN_OFF:
+					uiResult = TurnOff ( ulParam );
+					break;
+
+				case OilerMotorBaseClass::WORK_SEEN:
+					uiResult = CheckWork ( ulParam );
+					break;
+
+				case OilerMotorBaseClass::TIMER:
+					uiResult = CheckAlert ( ulParam );
+					break;
+
+				default:
+					break;
+			}
+			break;
+
+		case OilerMotorBaseClass::IDLE:
+			switch ( uiEventId )
+			{
+				case OilerMotorBaseClass::TURN_ON:
+					uiResult = TurnOn ( ulParam );
+					break;
+
+				case OilerMotorBaseClass::TURN_OFF:
+					uiResult = TurnOff ( ulParam );
+					break;
+
+				case OilerMotorBaseClass::TIMER:
+					uiResult = CheckRestart ( ulParam );
+					break;
+
+				default:
+					break;
+			}
+			break;
+
+		default:
+			break;
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// State table function called to start motor moving
+/// </summary>
+/// <returns>new state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::TurnOn ( uint32_t ulParam )
+{
+	Motor ().On ();								// Update status
+	Motor ().Start ();							// physically start motor
+	this->SetModeMetricAtStart ( ulParam );
+	this->m_ulLastWorkSignal = millis ();		// interval to first work unit is measured from start
+	return OilerMotorBaseClass::MOVING;			// new state
+}
+
+/// <summary>
+/// State table function called to turn off motor
+/// </summary>
+/// <returns>new state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::TurnOff ( uint32_t ulParam )
+{
+	Motor ().Off ();							// Update status
+	Motor ().PowerOff ();						// physically turn off
+	return OilerMotorBaseClass::OFF;			// new state
+}
+
+/// <summary>
+/// Checks if we have equalled or exceeded the threshold set for units of work (oil drips) and idles motor if true
+/// </summary>
+/// <returns>new state or existing state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::CheckWork ( uint32_t ulParam )
+{
+	uint8_t uiResult;
+	uint32_t ulSignalTime = this->m_ulWorkSignalTime;
+	int32_t lSinceLast = (int32_t)( ulSignalTime - this->m_ulLastWorkSignal );
+
+	// check for spurious signal, or one from before the motor started e.g. queued in deferred mode whilst idle and processed after the restart
+	if ( lSinceLast >= 0 && (uint32_t)lSinceLast >= this->m_ulDebounceMin )
+	{
+		if ( this->m_DripControl.IsEnabled () )
+		{
+			// adjust motor to hold required rate of work units
+			Motor ().SetDriveLevel ( this->m_DripControl.Update ( ulSignalTime - this->m_ulLastWorkSignal ) );
+		}
+		this->m_ulLastWorkSignal = ulSignalTime;
+		this->IncWorkUnits ( 1 );
+		if ( this->GetWorkUnits () >= this->m_ulWorkThreshold )
+		{
+			uiResult = OilerMotorBaseClass::IDLE;	// new state
+			Motor ().Idle ();						// Physically idle motor
+			this->OilerMotorBaseClass::Off ();		// update class, don't invoke
+			this->SetModeMetricAtIdle ( ulParam );
+			this->m_bError = false;
+		}
+		else
+		{
+			// not met threshold
+			uiResult = DoNothing ( 0 );
+		}
+	}
+	else
+	{
+		// ignore bad signal
+		uiResult = DoNothing ( 0 );
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// Called to set error state if still oiling beyond alert threshold
+/// </summary>
+/// <param name="ulParam">Current value of metric to be measured against alert threshold</param>
+/// <returns>existing state, does not change OilerMotor processing state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::CheckAlert ( uint32_t ulParam )
+{
+	this->m_bError = ( ulParam - this->GetModeMetricAtStart () ) >= this->m_ulAlertThreshold ? true : false;
+	return DoNothing ( 0UL );
+}
+
+/// <summary>
+/// Checks to see if the motor should restart after a set time has elapsed
+/// </summary>
+/// <returns>new state or existing state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::CheckRestart ( uint32_t ulParam )
+{
+	uint8_t uiResult;
+
+	if ( ( ulParam - this->GetModeMetricAtStart () ) >= this->m_ulRestartValue )
+	{
+		// time to start motor
+		uiResult = TurnOn ( ulParam );
+	}
+	else
+	{
+		uiResult = DoNothing ( 0 );
+	}
+	return uiResult;
+}
+
+/// <summary>
+/// Keeps state of state machine unchanged
+/// </summary>
+/// <returns>existing state</returns>
+template <class TMotor, class TBase>
+uint8_t OilerMotorLogicClass<TMotor, TBase>::DoNothing ( uint32_t ulParam )
+{
+	return this->m_eOilerState;
+}
+
+#endif
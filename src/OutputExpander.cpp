@@ -0,0 +1,130 @@
+//
+//  OutputExpander.cpp
+//
+// (c) Mark Naylor 2021
+//
+//	This class implements a chain of 74HC595 shift registers used as additional digital outputs, the chain is written with the hardware SPI in
+//	master mode, SPI mode 0, MSB first at fosc/2
+//
+
+#include "OutputExpander.h"
+
+OutputExpanderClass::OutputExpanderClass ( void )
+{
+	m_uiNumRegisters	= 0;
+	m_pLatchPort		= 0;
+	m_uiLatchMask		= 0;
+	m_bDirty			= false;
+	memset ( m_uiFrame, 0, sizeof ( m_uiFrame ) );
+}
+
+/// <summary>
+/// Configures the SPI hardware and latch pin and clears all outputs
+/// </summary>
+/// <param name="uiLatchPin">digital pin connected to STCP (storage register clock) of all registers</param>
+/// <param name="uiNumRegisters">number of 74HC595 in chain, 1 - MAX_OUTPUT_EXPANDER_REGISTERS</param>
+/// <returns>false if number of registers is invalid, else true</returns>
+bool OutputExpanderClass::Begin ( uint8_t uiLatchPin, uint8_t uiNumRegisters )
+{
+	bool bResult = false;
+	if ( uiNumRegisters > 0 && uiNumRegisters <= MAX_OUTPUT_EXPANDER_REGISTERS && uiLatchPin != NOT_A_PIN )
+	{
+		m_pLatchPort	= portOutputRegister ( digitalPinToPort ( uiLatchPin ) );
+		m_uiLatchMask	= digitalPinToBitMask ( uiLatchPin );
+		pinMode ( uiLatchPin, OUTPUT );
+		digitalWrite ( uiLatchPin, HIGH );
+
+		// SS must be an output to keep SPI hardware in master mode
+		pinMode ( SS, OUTPUT );
+		pinMode ( MOSI, OUTPUT );
+		pinMode ( SCK, OUTPUT );
+		SPCR = ( 1 << SPE ) | ( 1 << MSTR );		// enable, master, mode 0, MSB first
+		SPSR |= ( 1 << SPI2X );						// fosc/2
+
+		memset ( m_uiFrame, 0, sizeof ( m_uiFrame ) );
+		m_uiNumRegisters = uiNumRegisters;
+		m_bDirty = true;
+		Flush ();
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Checks if the expander has been configured
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if configured, else false</returns>
+bool OutputExpanderClass::IsActive ( void )
+{
+	return m_uiNumRegisters > 0;
+}
+
+/// <summary>
+/// Checks if pin number is an expander output
+/// </summary>
+/// <param name="uiPin">pin number</param>
+/// <returns>true if pin is in range of expander outputs, else false</returns>
+bool OutputExpanderClass::IsExpanderPin ( uint8_t uiPin )
+{
+	return uiPin >= OUTPUT_EXPANDER_PIN_BASE && uiPin < OUTPUT_EXPANDER_PIN_BASE + MAX_OUTPUT_EXPANDER_REGISTERS * 8;
+}
+
+/// <summary>
+/// Sets the level of an expander output in the frame. The output does not change until Flush() is called. Safe to call from interrupt or main code
+/// </summary>
+/// <param name="uiPin">expander pin number, see EXPANDER_OUTPUT()</param>
+/// <param name="uiLevel">HIGH or LOW</param>
+void OutputExpanderClass::WritePin ( uint8_t uiPin, uint8_t uiLevel )
+{
+	uint8_t uiOutput	= uiPin - OUTPUT_EXPANDER_PIN_BASE;
+	uint8_t uiRegister	= uiOutput >> 3;
+	uint8_t uiMask		= 1 << ( uiOutput & 7 );
+
+	if ( uiRegister < m_uiNumRegisters )
+	{
+		// other outputs of the register may be changed by an interrupt, e.g. another stepper's coils
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		uint8_t uiOld = m_uiFrame [ uiRegister ];
+		m_uiFrame [ uiRegister ] = uiLevel == LOW ? uiOld & ~uiMask : uiOld | uiMask;
+		if ( m_uiFrame [ uiRegister ] != uiOld )
+		{
+			m_bDirty = true;
+		}
+		SREG = uiSREG;
+	}
+}
+
+/// <summary>
+/// If any output has changed since last call, shifts out the complete frame and latches it. Safe to call from interrupt or main code
+/// </summary>
+/// <param name="">none</param>
+void OutputExpanderClass::Flush ( void )
+{
+	if ( m_bDirty )
+	{
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
+		ShiftOut ();
+		m_bDirty = false;
+		SREG = uiSREG;
+	}
+}
+
+/// <summary>
+/// Shifts frame out, register furthest from mcu first, then pulses latch to update all outputs together
+/// </summary>
+/// <param name="">none</param>
+void OutputExpanderClass::ShiftOut ( void )
+{
+	*m_pLatchPort &= ~m_uiLatchMask;
+	for ( uint8_t i = m_uiNumRegisters; i > 0; i-- )
+	{
+		SPDR = m_uiFrame [ i - 1 ];
+		while ( !( SPSR & ( 1 << SPIF ) ) );
+	}
+	*m_pLatchPort |= m_uiLatchMask;
+}
+
+OutputExpanderClass TheOutputExpander;
@@ -0,0 +1,49 @@
+//
+//  OutputExpander.h
+//
+// (c) Mark Naylor 2021
+//
+//	This class encapsulates a chain of 74HC595 serial in / parallel out shift registers driven by the mcu hardware SPI
+//	Each register adds 8 digital outputs which are addressed with pin numbers starting at OUTPUT_EXPANDER_PIN_BASE, use EXPANDER_OUTPUT(n) to get the
+//	pin number of output n where output 0 is Q0 of the register nearest the mcu.
+//
+//	Writes only update a frame held in RAM, the frame is shifted out to the registers in one SPI burst by Flush(). This allows all stepper coil
+//	changes made in a timer tick to be output together.
+//
+//	Wiring (Uno): MOSI (pin 11) to DS of first register, SCK (pin 13) to SHCP of all registers, latch pin of choice to STCP of all registers,
+//	Q7' of each register to DS of the next. Pin 10 (SS) is set to OUTPUT as required by the SPI hardware in master mode and cannot be used as an input.
+//
+//	NB This is written and tested to work on the Arduino Uno
+//
+#ifndef _OUTPUTEXPANDER_h
+#define _OUTPUTEXPANDER_h
+
+#include <Arduino.h>
+
+#define		OUTPUT_EXPANDER_PIN_BASE			64									// first pin number used for expander outputs, well above any Uno digital pin
+#define		MAX_OUTPUT_EXPANDER_REGISTERS		8									// max number of 74HC595 in chain, gives 64 outputs
+#define		EXPANDER_OUTPUT(n)					( OUTPUT_EXPANDER_PIN_BASE + (n) )	// pin number of expander output n
+
+class OutputExpanderClass
+{
+public:
+	OutputExpanderClass ( void );
+	bool			Begin ( uint8_t uiLatchPin, uint8_t uiNumRegisters );		// configure SPI and latch pin for chain of uiNumRegisters 74HC595
+	bool			IsActive ( void );											// true if Begin has been successfully called
+	void			WritePin ( uint8_t uiPin, uint8_t uiLevel );				// set level of expander output in frame, output when Flush is called
+	void			Flush ( void );												// shift frame out to registers if it has changed
+	static bool		IsExpanderPin ( uint8_t uiPin );							// true if pin number refers to an expander output
+
+protected:
+	void			ShiftOut ( void );
+
+	uint8_t				m_uiNumRegisters;										// number of registers in chain, 0 if not configured
+	volatile uint8_t*	m_pLatchPort;											// output register of port with latch pin
+	uint8_t				m_uiLatchMask;											// bit of latch pin on port
+	volatile bool		m_bDirty;												// true if frame changed since last Flush
+	uint8_t				m_uiFrame [ MAX_OUTPUT_EXPANDER_REGISTERS ];			// output levels, one byte per register, bit n = Qn
+};
+
+extern OutputExpanderClass TheOutputExpander;
+
+#endif
@@ -8,6 +8,7 @@
 //
 
 #include "PCIHandler.h"
+#include "InputExpander.h"
 
 PCIHandlerClass::PCIHandlerClass ()
 {
@@ -27,8 +28,13 @@ void PCIHandlerClass::CheckPortPins ( uint8_t uiPortIdGeneratingInterrupt )
 	// See what pins have changed
 	uint8_t uiChangedPins = uiCurrentPCIReg ^ m_PCintLastValues [ uiPortIdGeneratingInterrupt - 2 ];
 
+	// record change before callbacks run so its time is as close to the edge as possible
+	if ( m_pPortChangeHook )
+	{
+		m_pPortChangeHook ( uiPortIdGeneratingInterrupt, uiCurrentPCIReg, uiChangedPins );
+	}
 	// Check if any of these pins relate to one we are montoring
-	InvokeCallback ( uiChangedPins, uiPortIdGeneratingInterrupt );
+	InvokeCallback ( uiChangedPins, uiCurrentPCIReg, uiPortIdGeneratingInterrupt );
 	// Save latest port values
 	m_PCintLastValues [ uiPortIdGeneratingInterrupt - 2 ] = uiCurrentPCIReg;
 
@@ -38,8 +44,9 @@ void PCIHandlerClass::CheckPortPins ( uint8_t uiPortIdGeneratingInterrupt )
 /// checks list of PCI pins of interest against this port/pin and if a match is found invokes the configured callback
 /// </summary>
 /// <param name="uiChangedPins">byte bitmask of which pins have changed</param>
+/// <param name="uiPortPins">current levels of all pins on port</param>
 /// <param name="uiPortIdGeneratingInterrupt">which port generated the pin change interrupt</param>
-void PCIHandlerClass::InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortIdGeneratingInterrupt )
+void PCIHandlerClass::InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortPins, uint8_t uiPortIdGeneratingInterrupt )
 {
 	// check each entry to see if we need to invoke its callback
 	for ( uint8_t i = 0; i < PCIData::m_uiPinCount; i++ )
@@ -48,28 +55,28 @@ void PCIHandlerClass::InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortIdGe
 		if ( m_PinInfo [ i ].uiPinPort == uiPortIdGeneratingInterrupt )
 		{
 			// if this pin has signalled 
-			if ( uiChangedPins & digitalPinToBitMask ( m_PinInfo [ i ].uiPinNum ) )
+			if ( uiChangedPins & m_PinInfo [ i ].uiPinMask )
 			{
 				// if pin has changed as per required mode
-				uint8_t uiCurrentPinState = digitalRead ( m_PinInfo [ i ].uiPinNum );
+				uint8_t uiCurrentPinState = ( uiPortPins & m_PinInfo [ i ].uiPinMask ) ? HIGH : LOW;
 				switch ( m_PinInfo [ i ].uiMode )
 				{
 					case RISING:
 						if ( m_PinInfo [ i ].uiLastState == LOW && uiCurrentPinState == HIGH )
 						{
-							m_PinInfo [ i ].pCallBack ();
+							m_PinInfo [ i ].Callback.Invoke ( uiCurrentPinState );
 						}
 						break;
 
 					case FALLING:
 						if ( m_PinInfo [ i ].uiLastState == HIGH && uiCurrentPinState == LOW )
 						{
-							m_PinInfo [ i ].pCallBack ();
+							m_PinInfo [ i ].Callback.Invoke ( uiCurrentPinState );
 						}
 						break;
 
 					case CHANGE:
-						m_PinInfo [ i ].pCallBack ();
+						m_PinInfo [ i ].Callback.Invoke ( uiCurrentPinState );
 						break;
 
 					default:
@@ -83,6 +90,16 @@ void PCIHandlerClass::InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortIdGe
 	}
 }
 
+/// <summary>
+/// Sets the function called by the interrupt with each change of a port. Edge capture sets this when started so that it is only linked
+/// into sketches that use it
+/// </summary>
+/// <param name="pHook">function to call, 0 for none</param>
+void PCIHandlerClass::SetPortChangeHook ( PortChangeHook pHook )
+{
+	m_pPortChangeHook = pHook;
+}
+
 // Pin Change Interrupt routines, Arduino Uno mcu has 3 ports each handles a different set of pins and each port can generate a unique interrupt for the pins it covers
 ISR ( PCINT0_vect )
 {
@@ -99,7 +116,9 @@ ISR ( PCINT2_vect )
 
 PCIHandlerClass  PCIHandler;
 volatile uint8_t PCIHandlerClass::m_PCintLastValues [ NUM_PCI_PORTS ];
+PortChangeHook volatile PCIHandlerClass::m_pPortChangeHook = 0;
 uint8_t	PCIData::m_uiPinCount = 0;
+ExpanderAddPin PCIData::m_pExpanderAddPin = 0;
 PCIData::PININFO PCIData::m_PinInfo [ MAX_PCI_PINS ];
 
 PCIData::PCIData ( void )
@@ -113,18 +132,56 @@ PCIData::PCIData ( void )
 /// <param name="uiDigitalPinNum">digital pin number to monitor</param>
 /// <param name="pInterruptFn">callback function to be invoked</param>
 /// <param name="uiState">change in state of interest, must be FALLING or RISING or CHANGE</param>
-/// <param name="uiMode">pinMode of digital pin, must be INPUT or INPUT_PULLUP</param>
+/// <param name="uiMode">pinMode of digital pin, must be INPUT or INPUT_PULLUP, ignored for expander inputs</param>
 /// <returns>true if added successfully else false</returns>
 bool PCIData::AddPin ( uint8_t uiDigitalPinNum, InterruptCallback pInterruptFn, uint8_t uiState, uint8_t uiMode )
+{
+	PIN_CALLBACK Callback = { pInterruptFn, 0, 0 };
+	return AddPin ( uiDigitalPinNum, Callback, uiState, uiMode );
+}
+
+/// <summary>
+/// Adds a callback to be invoked with a context for specified pin, allows one function to serve many objects
+/// </summary>
+/// <param name="uiDigitalPinNum">digital pin number to monitor</param>
+/// <param name="pInterruptFn">callback function to be invoked, passed pContext and level of pin</param>
+/// <param name="pContext">value passed to callback, e.g. object interested in pin</param>
+/// <param name="uiState">change in state of interest, must be FALLING or RISING or CHANGE</param>
+/// <param name="uiMode">pinMode of digital pin, must be INPUT or INPUT_PULLUP, ignored for expander inputs</param>
+/// <returns>true if added successfully else false</returns>
+bool PCIData::AddPin ( uint8_t uiDigitalPinNum, PinCallback pInterruptFn, void* pContext, uint8_t uiState, uint8_t uiMode )
+{
+	PIN_CALLBACK Callback = { 0, pInterruptFn, pContext };
+	return AddPin ( uiDigitalPinNum, Callback, uiState, uiMode );
+}
+
+/// <summary>
+/// Adds callback details for specified pin
+/// </summary>
+/// <param name="uiDigitalPinNum">digital pin number to monitor</param>
+/// <param name="Callback">callback to be invoked</param>
+/// <param name="uiState">change in state of interest, must be FALLING or RISING or CHANGE</param>
+/// <param name="uiMode">pinMode of digital pin, must be INPUT or INPUT_PULLUP, ignored for expander inputs</param>
+/// <returns>true if added successfully else false</returns>
+bool PCIData::AddPin ( uint8_t uiDigitalPinNum, const PIN_CALLBACK& Callback, uint8_t uiState, uint8_t uiMode )
 {
 	bool bResult = false;
-	if ( !IsPinPresent ( uiDigitalPinNum ) && !IsFull () && ( uiState == FALLING || uiState == RISING || uiState == CHANGE ) )
+	if ( InputExpanderClass::IsExpanderPin ( uiDigitalPinNum ) )
+	{
+		// input is on a shift register, it is sampled by the input expander rather than by pin change interrupt
+		if ( m_pExpanderAddPin )
+		{
+			bResult = m_pExpanderAddPin ( uiDigitalPinNum, Callback, uiState );
+		}
+	}
+	else if ( !IsPinPresent ( uiDigitalPinNum ) && !IsFull () && ( uiState == FALLING || uiState == RISING || uiState == CHANGE ) )
 	{
 		m_PinInfo [ m_uiPinCount ].uiPinNum = uiDigitalPinNum;
-		m_PinInfo [ m_uiPinCount ].pCallBack = pInterruptFn;
+		m_PinInfo [ m_uiPinCount ].Callback = Callback;
 		m_PinInfo [ m_uiPinCount ].uiMode = uiState;
 		m_PinInfo [ m_uiPinCount ].uiLastState = digitalRead ( uiDigitalPinNum );
 		m_PinInfo [ m_uiPinCount ].uiPinPort = digitalPinToPort ( uiDigitalPinNum );				// NB digitalPinToPort returns 2,3 or 4
+		m_PinInfo [ m_uiPinCount ].uiPinMask = digitalPinToBitMask ( uiDigitalPinNum );
 		pinMode ( uiDigitalPinNum, uiMode );
 		m_uiPinCount++;
 		EnablePCI ( uiDigitalPinNum );
@@ -133,6 +190,16 @@ bool PCIData::AddPin ( uint8_t uiDigitalPinNum, InterruptCallback pInterruptFn,
 	return bResult;
 }
 
+/// <summary>
+/// Sets the function used to add pins that are expander inputs. The input expander calls this when it is configured so that it is only linked
+/// into sketches that use it
+/// </summary>
+/// <param name="pAddPinFn">function to add expander pin</param>
+void PCIData::SetExpander ( ExpanderAddPin pAddPinFn )
+{
+	m_pExpanderAddPin = pAddPinFn;
+}
+
 /// <summary>
 /// enables PCI interrupts for the pin specified
 /// </summary>
@@ -157,7 +224,7 @@ InterruptCallback PCIData::GetCallback ( uint8_t uiPin )
 	{
 		if ( m_PinInfo [ i ].uiPinNum == uiPin )
 		{
-			pResult = m_PinInfo [ i ].pCallBack;
+			pResult = m_PinInfo [ i ].Callback.pCallBack;
 			break;
 		}
 	}
@@ -6,6 +6,7 @@
 //	This class is encapsulates the handling of Pin Change Interrupt (PCI) functionality
 //  This code enables users to specify a pin to be monitored using the mcu PCI functionality
 //	A pin can be configured along with a requested callback routine. The pin must be identified using an Arduino digital pin number
+//	or an expander input number (see InputExpander.h), expander inputs are passed on to TheInputExpander (once configured) which invokes the same callbacks
 //
 //	NB This is written and tested to work on the Arduino Uno
 //
@@ -15,17 +16,46 @@
 #include <Arduino.h>
 
 #define		NUM_PCI_PORTS		3										// number of ports on Atmel chip on arduino Uno board that can generate a PCI
-#define		MAX_PCI_PINS		8										// max number of PCI pins allowed to be monitored
+#ifndef		MAX_PCI_PINS
+#define		MAX_PCI_PINS		8										// max number of PCI pins allowed to be monitored, define larger for more than 8 direct drip sensors
+#endif
 typedef void ( *InterruptCallback )( void );
+typedef void ( *PinCallback )( void* pContext, uint8_t uiPinState );	// callback passed the context it was registered with and the level of the pin that signalled
+
+// Callback invoked when a monitored pin signals, either a plain function or a function with the context of the object interested in the pin
+struct PIN_CALLBACK
+{
+	InterruptCallback	pCallBack;										// function with no parameters, used if pContextCallBack is 0
+	PinCallback			pContextCallBack;								// function passed pContext and pin level
+	void*				pContext;										// e.g. object that owns the pin
+
+	inline void Invoke ( uint8_t uiPinState )
+	{
+		if ( pContextCallBack )
+		{
+			pContextCallBack ( pContext, uiPinState );
+		}
+		else
+		{
+			pCallBack ();
+		}
+	}
+};
+
+typedef bool ( *ExpanderAddPin )( uint8_t uiPin, const PIN_CALLBACK& Callback, uint8_t uiState );	// used to pass expander input pins on to the input expander
+typedef void ( *PortChangeHook )( uint8_t uiPort, uint8_t uiPortPins, uint8_t uiChangedPins );		// called by interrupt with every change of a port, e.g. to capture edges
 
 class PCIData
 {
 public:
 	PCIData ( void );
 	bool				AddPin ( uint8_t uiDigitalPinNum, InterruptCallback pInterruptFn, uint8_t uiState, uint8_t uiMode = INPUT_PULLUP ); // add pin to be monitored, function to be called if the signal matches mode (RISING, FALLING or  CHANGE), defaults to INPUT_PULLUP
+	bool				AddPin ( uint8_t uiDigitalPinNum, PinCallback pInterruptFn, void* pContext, uint8_t uiState, uint8_t uiMode = INPUT_PULLUP ); // as above, function is passed pContext and the pin level
 	InterruptCallback	GetCallback ( uint8_t uiPin );
+	static void			SetExpander ( ExpanderAddPin pAddPinFn );			// called by input expander when configured, so expander pins can be added
 
 protected:
+	bool				AddPin ( uint8_t uiDigitalPinNum, const PIN_CALLBACK& Callback, uint8_t uiState, uint8_t uiMode );
 	bool				IsFull ();
 	bool				IsPinPresent ( uint8_t uiPin );
 	void				EnablePCI ( uint8_t uiPin );
@@ -34,11 +64,13 @@ protected:
 	{
 		uint8_t				uiPinNum;									// Pin being monitored
 		uint8_t				uiPinPort;									// mcu Port that pin belongs to
+		uint8_t				uiPinMask;									// bit of pin on its port
 		uint8_t				uiMode;										// mode that (RISING, FALLING or CHANGE) if true invokes callback
 		uint8_t				uiLastState;								// HIGH or LOW
-		InterruptCallback	pCallBack;									// function to call when pin signals
+		PIN_CALLBACK		Callback;									// function to call when pin signals
 	} m_PinInfo [ MAX_PCI_PINS ];
 	static uint8_t	m_uiPinCount;										// Count of pins being monitored
+	static ExpanderAddPin	m_pExpanderAddPin;							// 0 unless an input expander is configured
 };
 
 class PCIHandlerClass : public PCIData
@@ -46,9 +78,11 @@ class PCIHandlerClass : public PCIData
 public:
 	PCIHandlerClass ();
 	static void	CheckPortPins ( uint8_t uiPortIdGeneratingInterrupt );		// Called when a pin on the provided port signals, checks if one that pin is of interest
-	static	void	InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortIdGeneratingInterrupt );
+	static	void	InvokeCallback ( uint8_t uiChangedPins, uint8_t uiPortPins, uint8_t uiPortIdGeneratingInterrupt );
+	static	void	SetPortChangeHook ( PortChangeHook pHook );			// called by edge capture when started, 0 to remove
 protected:
 	volatile static uint8_t m_PCintLastValues [ NUM_PCI_PORTS ];		// holds the prior PCINT pin values, used to determine when one changes.
+	static	PortChangeHook volatile m_pPortChangeHook;					// 0 unless edges are being captured
 };
 
 extern PCIHandlerClass PCIHandler;
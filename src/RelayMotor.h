@@ -1,9 +1,13 @@
 // RelayMotor.h
 //
 // (c) Mark Naylor June 2021
-// 
+//
 // RelayMotor class, derivative of MotorClass for driving a DC motor via a change over relay
 //
+// RelayMotorImplClass holds the relay specific code and is shared by
+//		RelayMotorClass			virtual version, can be used wherever an OilerMotorClass is expected
+//		StaticRelayMotorClass	static version, all calls are resolved at compile time
+//
 
 #ifndef _RELAYMOTOR_h
 #define _RELAYMOTOR_h
@@ -12,18 +16,100 @@
 
 #include "OilerMotor.h"
 
-class RelayMotorClass : public OilerMotorClass
+template <class TBase>
+class RelayMotorImplClass : public TBase
 {
 public:
-						RelayMotorClass ( uint8_t uiPin, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulTimeThreshold );
+						RelayMotorImplClass ( uint8_t uiPin, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulTimeThreshold );
 	void				Idle ();
 	void				Start ();
 	void				PowerOff ();
+	void				SetDriveLevel ( uint8_t uiLevel );			// PWM duty used when motor is started, only applied if relay pin supports PWM and is not on timer 2
 
-	void				SetDirection ( eDirection Direction );		// Does nothing for this type of motor
+	void				SetDirection ( MotorClass::eDirection Direction );	// Does nothing for this type of motor
 
 protected:
 	uint8_t		m_uiRelayPin;										// Pin that controls relay switch
 };
 
-#endif
\ No newline at end of file
+class RelayMotorClass : public RelayMotorImplClass<OilerMotorClass>
+{
+public:
+						RelayMotorClass ( uint8_t uiPin, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulTimeThreshold );
+};
+
+class StaticRelayMotorClass : public RelayMotorImplClass<OilerMotorLogicClass<StaticRelayMotorClass>>
+{
+public:
+						StaticRelayMotorClass ( uint8_t uiPin, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulTimeThreshold );
+};
+
+template <class TBase>
+RelayMotorImplClass<TBase>::RelayMotorImplClass ( uint8_t uiRelayPin, uint8_t uiWorkPin, uint32_t ulWorkThreshold, uint32_t ulDebouncems, uint32_t ulTimeThreshold ) : TBase ( uiWorkPin, ulWorkThreshold, ulDebouncems, 0, ulTimeThreshold )
+{
+	SetDirection ( MotorClass::FORWARD );
+	m_uiRelayPin = uiRelayPin;
+	pinMode ( m_uiRelayPin, OUTPUT );
+}
+
+/// <summary>
+/// Motor specific function to idle motor
+/// </summary>
+template <class TBase>
+void RelayMotorImplClass<TBase>::Idle ()
+{
+	// Idle motor - for relay this means same as power off
+	PowerOff ();
+}
+
+/// <summary>
+/// Motor specific function to Start motor
+/// </summary>
+template <class TBase>
+void RelayMotorImplClass<TBase>::Start ()
+{
+	// Start motor - for relay this means switch on, if driven below full level and pin supports it use PWM (e.g. relay pin drives a MOSFET).
+	// Timer 2 is TheTimer's, PWM on its pins would change the tick rate, so they are switched fully on
+	uint8_t uiTimer = digitalPinToTimer ( m_uiRelayPin );
+	if ( this->GetDriveLevel () < DRIVE_LEVEL_MAX && digitalPinHasPWM ( m_uiRelayPin ) && uiTimer != TIMER2A && uiTimer != TIMER2B )
+	{
+		analogWrite ( m_uiRelayPin, this->GetDriveLevel () );
+	}
+	else
+	{
+		digitalWrite ( m_uiRelayPin, HIGH );
+	}
+}
+
+/// <summary>
+/// Motor specific function to power off
+/// </summary>
+template <class TBase>
+void RelayMotorImplClass<TBase>::PowerOff ()
+{
+	// power off motor - for relay this means switch off
+	digitalWrite ( m_uiRelayPin, LOW );
+}
+
+/// <summary>
+/// Sets the drive level, if motor is running the new level is applied immediately
+/// </summary>
+/// <param name="uiLevel">DRIVE_LEVEL_MIN - DRIVE_LEVEL_MAX, used as PWM duty</param>
+template <class TBase>
+void RelayMotorImplClass<TBase>::SetDriveLevel ( uint8_t uiLevel )
+{
+	OilerMotorBaseClass::SetDriveLevel ( uiLevel );
+	if ( this->GetMotorState () == MotorClass::RUNNING )
+	{
+		Start ();
+	}
+}
+
+template <class TBase>
+void RelayMotorImplClass<TBase>::SetDirection ( MotorClass::eDirection Direction )
+{
+	// Save requested direction
+	MotorClass::SetDirection ( Direction );
+}
+
+#endif
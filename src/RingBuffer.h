@@ -0,0 +1,174 @@
+// RingBuffer.h
+//
+// (c) 2021 Mark Naylor
+//
+// defines a ring buffer of small items passed from interrupt routines to loop(), used by EventQueueClass and EdgeCaptureClass. Interrupt routines
+// on the Uno do not interrupt each other so they are a single producer and loop() is the single consumer. The producer only writes the head index
+// and the consumer only writes the tail index, both are single bytes so are read and written atomically and the ring needs no locking.
+//
+// If the ring is full the item is dropped and counted so that the size can be tuned, as can the high water mark.
+// Storage is provided by the owner so the size is fixed at compile time, the size must be a power of 2 and no more than 128.
+//
+#ifndef _RINGBUFFER_h
+#define _RINGBUFFER_h
+
+#include <Arduino.h>
+
+template <class TItem>
+class RingBufferClass
+{
+public:
+						RingBufferClass ( TItem* pItems, uint8_t uiSize );
+	bool				Push ( const TItem& Item );				// called by producer, false if full and item dropped
+	bool				Pop ( TItem* pItem );					// called by consumer, false if empty
+	bool				IsEmpty ( void );
+	void				Clear ( void );							// discard all items and reset counters, neither side may be using the ring
+	uint16_t			GetOverflowCount ( void );				// number of items dropped as ring was full
+	uint8_t				GetHighWater ( void );					// most items that have been waiting at once
+	void				ResetCounters ( void );
+
+protected:
+	TItem*				m_pItems;								// ring of items
+	uint8_t				m_uiMask;								// size - 1, used to wrap indexes
+	volatile uint8_t	m_uiHead;								// next item written here, only changed by producer
+	volatile uint8_t	m_uiTail;								// next item read from here, only changed by consumer
+	volatile uint16_t	m_uiOverflowCount;						// only changed by producer
+	volatile uint8_t	m_uiHighWater;							// only changed by producer
+};
+
+/// <summary>
+/// initialises an empty ring
+/// </summary>
+/// <param name="pItems">array of uiSize items</param>
+/// <param name="uiSize">number of items, must be a power of 2 and no more than 128. Holds uiSize - 1 items as one slot separates head from tail</param>
+template <class TItem>
+RingBufferClass<TItem>::RingBufferClass ( TItem* pItems, uint8_t uiSize )
+{
+	m_pItems			= pItems;
+	m_uiMask			= uiSize - 1;
+	m_uiHead			= 0;
+	m_uiTail			= 0;
+	m_uiOverflowCount	= 0;
+	m_uiHighWater		= 0;
+}
+
+/// <summary>
+/// Adds item to ring, must only be called from one context at a time e.g. interrupt routines
+/// </summary>
+/// <param name="Item">item, copied into the ring</param>
+/// <returns>false if ring full and item dropped, else true</returns>
+template <class TItem>
+bool RingBufferClass<TItem>::Push ( const TItem& Item )
+{
+	bool bResult = false;
+	uint8_t uiHead = m_uiHead;
+	uint8_t uiNext = ( uiHead + 1 ) & m_uiMask;
+
+	if ( uiNext != m_uiTail )
+	{
+		m_pItems [ uiHead ] = Item;
+		m_uiHead = uiNext;						// publish item only once it is complete
+
+		uint8_t uiDepth = ( uiNext - m_uiTail ) & m_uiMask;
+		if ( uiDepth > m_uiHighWater )
+		{
+			m_uiHighWater = uiDepth;
+		}
+		bResult = true;
+	}
+	else if ( m_uiOverflowCount != 0xFFFF )
+	{
+		m_uiOverflowCount++;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Removes oldest item from ring, must only be called from one context at a time e.g. loop()
+/// </summary>
+/// <param name="pItem">receives item</param>
+/// <returns>false if ring empty, else true</returns>
+template <class TItem>
+bool RingBufferClass<TItem>::Pop ( TItem* pItem )
+{
+	bool bResult = false;
+	uint8_t uiTail = m_uiTail;
+
+	if ( uiTail != m_uiHead )
+	{
+		*pItem = m_pItems [ uiTail ];
+		m_uiTail = ( uiTail + 1 ) & m_uiMask;	// free slot only once item is copied
+		bResult = true;
+	}
+	return bResult;
+}
+
+/// <summary>
+/// Checks if there are no items waiting
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if empty, else false</returns>
+template <class TItem>
+bool RingBufferClass<TItem>::IsEmpty ( void )
+{
+	return m_uiTail == m_uiHead;
+}
+
+/// <summary>
+/// Discards all items and sets overflow count and high water mark back to 0
+/// </summary>
+/// <param name="">none</param>
+template <class TItem>
+void RingBufferClass<TItem>::Clear ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_uiHead			= 0;
+	m_uiTail			= 0;
+	m_uiOverflowCount	= 0;
+	m_uiHighWater		= 0;
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Gets the number of items dropped because the ring was full, stops at 0xFFFF
+/// </summary>
+/// <param name="">none</param>
+/// <returns>count of dropped items</returns>
+template <class TItem>
+uint16_t RingBufferClass<TItem>::GetOverflowCount ( void )
+{
+	// two bytes so read with producer held off
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	uint16_t uiResult = m_uiOverflowCount;
+	SREG = uiSREG;
+	return uiResult;
+}
+
+/// <summary>
+/// Gets the most items that have been waiting in the ring at once
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of items</returns>
+template <class TItem>
+uint8_t RingBufferClass<TItem>::GetHighWater ( void )
+{
+	return m_uiHighWater;
+}
+
+/// <summary>
+/// Sets overflow count and high water mark back to 0
+/// </summary>
+/// <param name="">none</param>
+template <class TItem>
+void RingBufferClass<TItem>::ResetCounters ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_uiOverflowCount	= 0;
+	m_uiHighWater		= 0;
+	SREG = uiSREG;
+}
+
+#endif
@@ -19,19 +19,23 @@
 /// <summary>
 /// Routine to be called if the target machine active (has power) pin is signalled - called by interrupt
 /// </summary>
-/// <param name="">none</param>
-void MachineActiveSignal ( void )
+/// <param name="pContext">machine whose pin signalled</param>
+/// <param name="uiPinState">level of pin</param>
+void TargetMachineClass::MachineActiveSignal ( void* pContext, uint8_t uiPinState )
 {
-	TheMachine.CheckActivity ();
+	( (TargetMachineClass*)pContext )->ActiveEdge ( uiPinState, millis () );
 }
 
 /// <summary>
-/// Routine to be called if MACHINE_WORK_PIN is signalled - called by interrupt
+/// Routine to be called if the target machine work pin is signalled - called by interrupt
 /// </summary>
-/// <param name="">none</param>
-void MachineWorkUnitSignal ( void )
+/// <param name="pContext">machine whose pin signalled</param>
+/// <param name="uiPinState">level of pin, not used</param>
+void TargetMachineClass::MachineWorkUnitSignal ( void* pContext, uint8_t uiPinState )
 {
-	TheMachine.IncWorkUnit ( 1 );
+	TargetMachineClass* pMachine = (TargetMachineClass*)pContext;
+	pMachine->MeasurePeriod ( micros () );
+	pMachine->IncWorkUnit ( 1 );
 }
 
 // Class routines
@@ -41,9 +45,17 @@ TargetMachineClass::TargetMachineClass ( void )
 	m_uiActivePin		= NOT_A_PIN;
 	m_State				= NOT_READY;
 	m_Active			= IDLE;
+	m_ullActivems		= 0ULL;
+	m_timeActiveStarted	= 0UL;
+	m_uiActiveSeq		= 0;
 	m_uiActivePinMode	= MACHINE_ACTIVE_PIN_MODE;		// set default value
 	m_uiWorkPinMode		= MACHINE_WORK_PIN_MODE;		// set default value
 	m_uiActiveState		= MACHINE_ACTIVE_STATE;			// set default value
+	m_uiWorkWatchCount	= 0;
+	m_ulNextWorkWatch	= 0UL;
+	m_ulLastWorkSignalus	= 0UL;
+	m_ulPeriodSum		= 0UL;
+	m_ulMinPeriodus		= 0UL;
 }
 
 /// <summary>
@@ -67,14 +79,14 @@ bool TargetMachineClass::AddFeatures ( uint8_t uiActivePin, uint8_t uiWorkPin )
 
 	if ( uiActivePin != NOT_A_PIN )
 	{
-		if ( PCIHandler.AddPin ( uiActivePin, MachineActiveSignal, MACHINE_ACTIVE_PIN_SIGNAL, m_uiActivePinMode ) == false )
+		if ( PCIHandler.AddPin ( uiActivePin, MachineActiveSignal, this, MACHINE_ACTIVE_PIN_SIGNAL, m_uiActivePinMode ) == false )
 		{
 			bResult = false;
 		}
 	}
 	if ( uiWorkPin != NOT_A_PIN )
 	{
-		if ( PCIHandler.AddPin ( uiWorkPin, MachineWorkUnitSignal, MACHINE_WORK_PIN_SIGNAL, m_uiWorkPinMode ) == false )
+		if ( PCIHandler.AddPin ( uiWorkPin, MachineWorkUnitSignal, this, MACHINE_WORK_PIN_SIGNAL, m_uiWorkPinMode ) == false )
 		{
 			bResult = false;
 		}
@@ -88,52 +100,54 @@ bool TargetMachineClass::AddFeatures ( uint8_t uiActivePin, uint8_t uiWorkPin )
 /// <param name="">none</param>
 void TargetMachineClass::RestartMonitoring ( void )
 {
-	m_timeActive = 0UL;
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_ullActivems = 0ULL;
 	m_ulWorkUnitCount = 0UL;
 	if ( m_State != NO_FEATURES )
 	{
 		m_State = NOT_READY;
 		m_Active = m_uiActivePin == NOT_A_PIN ? IDLE : digitalRead ( m_uiActivePin ) == m_uiActiveState ? ACTIVE : IDLE;
-		if ( m_Active == ACTIVE )
-		{
-			m_timeActiveStarted = millis ();
-		}
+		m_timeActiveStarted = millis ();
 	}
+	m_uiActiveSeq++;
+	SREG = uiSREG;
+	ResetPeakRPM ();
 }
 
 /// <summary>
-/// called when active signal changes state. If target machine is active (has power) and if so remembers start time, if not active calculates how much time was with power and adds to count 
+/// Reads the active pin and records any change in the machine being active, for use where the active pin is not monitored by interrupt
 /// </summary>
 /// <param name="">none</param>
 void TargetMachineClass::CheckActivity ( void )
 {
-	// see how machine has changed state
-	if ( digitalRead ( m_uiActivePin ) == m_uiActiveState )
-	{
-		// machine gone active so remember when this started
-		GoneActive ( millis () );
-	}
-	else
-	{
-		// machine gone idle so calc time was active and save it
-		IncActiveTime ( millis () );
-	}
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	ActiveEdge ( digitalRead ( m_uiActivePin ), millis () );
+	SREG = uiSREG;
 }
 
 /// <summary>
-/// If currently active updates powered time calc
+/// called when active signal changes state. If target machine is now active (has power) remembers start time, if now idle adds the time it was
+/// active to the total. Must be called with interrupts off e.g. from the pin interrupt
 /// </summary>
-/// <param name="">none</param>
-/// <returns>Nothing</returns>
-void TargetMachineClass::UpdatePoweredTime ( void )
+/// <param name="uiPinState">level of active pin</param>
+/// <param name="tNow">millis when pin changed</param>
+void TargetMachineClass::ActiveEdge ( uint8_t uiPinState, uint32_t tNow )
 {
-	// Check time is up to date
-	if ( m_Active == ACTIVE )
+	eActiveState NewState = uiPinState == m_uiActiveState ? ACTIVE : IDLE;
+	if ( NewState != m_Active )
 	{
-		// add time to now and check if passed threshold
-		uint32_t tNow = millis ();
-		IncActiveTime ( tNow );
-		m_timeActiveStarted = tNow;
+		if ( NewState == ACTIVE )
+		{
+			m_timeActiveStarted = tNow;
+		}
+		else
+		{
+			m_ullActivems += (uint32_t)( tNow - m_timeActiveStarted );
+		}
+		m_Active = NewState;
+		m_uiActiveSeq++;				// tells a reader in loop () it was interrupted by an update
 	}
 }
 
@@ -144,9 +158,51 @@ void TargetMachineClass::UpdatePoweredTime ( void )
 /// <returns>number of seconds</returns>
 uint32_t TargetMachineClass::GetActiveTime ( void )
 {
-	// Ensure time is updated before returning value
-	UpdatePoweredTime ();
-	return m_timeActive / 1000;
+	return (uint32_t)( GetActiveTimems64 () / 1000 );
+}
+
+/// <summary>
+/// Gets the number of milliseconds the targetmachine has been with power since monitoring was last started.
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of milliseconds, wraps after 49 days</returns>
+uint32_t TargetMachineClass::GetActiveTimems ( void )
+{
+	return (uint32_t)GetActiveTimems64 ();
+}
+
+/// <summary>
+/// Gets the number of milliseconds the targetmachine has been with power since monitoring was last started. Interrupts are not disabled,
+/// instead the values are copied again if the active signal changed whilst they were being copied
+/// </summary>
+/// <param name="">none</param>
+/// <returns>number of milliseconds</returns>
+uint64_t TargetMachineClass::GetActiveTimems64 ( void )
+{
+	uint8_t			uiSeq;
+	uint64_t		ullActivems;
+	uint32_t		tStarted;
+	eActiveState	Active;
+	do
+	{
+		uiSeq		= m_uiActiveSeq;
+		ullActivems	= m_ullActivems;
+		tStarted	= m_timeActiveStarted;
+		Active		= m_Active;
+	} while ( uiSeq != m_uiActiveSeq );
+
+	// time since going active is not added until machine goes idle
+	return Active == ACTIVE ? ullActivems + (uint32_t)( millis () - tStarted ) : ullActivems;
+}
+
+/// <summary>
+/// Checks if the targetmachine has power, whilst it has its active time increases at the same rate as elapsed time
+/// </summary>
+/// <param name="">none</param>
+/// <returns>true if active, else false</returns>
+bool TargetMachineClass::IsActive ( void )
+{
+	return m_Active == ACTIVE;
 }
 
 /// <summary>
@@ -160,24 +216,100 @@ uint32_t TargetMachineClass::GetWorkUnits ( void )
 }
 
 /// <summary>
-/// add active time in milliseconds to total since machine became active 
+/// Updates the average time between work signals, called by interrupt. Average is kept as a sum scaled by 2^MACHINE_RPM_SMOOTHING so it is
+/// updated with shifts rather than division. The first signal after a stop only records its time as there is no period to measure
+/// </summary>
+/// <param name="ulNowus">micros when work pin signalled</param>
+void TargetMachineClass::MeasurePeriod ( uint32_t ulNowus )
+{
+	uint32_t ulPeriodus = ulNowus - m_ulLastWorkSignalus;
+	m_ulLastWorkSignalus = ulNowus;
+
+	if ( ulPeriodus >= MACHINE_RPM_TIMEOUTMS * 1000UL )
+	{
+		// machine was stopped, start a new average
+		m_ulPeriodSum = 0UL;
+	}
+	else if ( ulPeriodus > 0UL )
+	{
+		if ( m_ulPeriodSum == 0UL )
+		{
+			m_ulPeriodSum = ulPeriodus << MACHINE_RPM_SMOOTHING;
+		}
+		else
+		{
+			m_ulPeriodSum += ulPeriodus - ( m_ulPeriodSum >> MACHINE_RPM_SMOOTHING );
+		}
+		uint32_t ulAverageus = m_ulPeriodSum >> MACHINE_RPM_SMOOTHING;
+		if ( m_ulMinPeriodus == 0UL || ulAverageus < m_ulMinPeriodus )
+		{
+			m_ulMinPeriodus = ulAverageus;
+		}
+	}
+}
+
+/// <summary>
+/// Converts a period between work signals into work units per minute
+/// </summary>
+/// <param name="ulPeriodus">us between work signals, 0 if none</param>
+/// <returns>RPM, 0 if no period, limited to 65535</returns>
+uint16_t TargetMachineClass::PeriodToRPM ( uint32_t ulPeriodus )
+{
+	uint32_t ulRPM = ulPeriodus == 0UL ? 0UL : 60000000UL / ulPeriodus;
+	return ulRPM > 0xFFFFUL ? 0xFFFF : (uint16_t)ulRPM;
+}
+
+/// <summary>
+/// Gets the rate of work from the smoothed time between work signals, e.g. spindle RPM if the work pin signals once a revolution
+/// </summary>
+/// <param name="">none</param>
+/// <returns>work units per minute, 0 if no work signal for MACHINE_RPM_TIMEOUTMS</returns>
+uint16_t TargetMachineClass::GetRPM ( void )
+{
+	return PeriodToRPM ( GetPeriodus () );
+}
+
+/// <summary>
+/// Gets the smoothed time between work signals, without the division GetRPM () makes so it can be read with interrupts held off
+/// </summary>
+/// <param name="">none</param>
+/// <returns>us between work signals, 0 if no work signal for MACHINE_RPM_TIMEOUTMS</returns>
+uint32_t TargetMachineClass::GetPeriodus ( void )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	uint32_t ulPeriodSum	= m_ulPeriodSum;
+	uint32_t ulSinceus		= micros () - m_ulLastWorkSignalus;
+	SREG = uiSREG;
+
+	return ulSinceus >= MACHINE_RPM_TIMEOUTMS * 1000UL ? 0UL : ulPeriodSum >> MACHINE_RPM_SMOOTHING;
+}
+
+/// <summary>
+/// Gets the highest smoothed rate of work seen
 /// </summary>
-/// <param name="tNow">current time in milliseconds</param>
-void TargetMachineClass::IncActiveTime ( uint32_t tNow )
+/// <param name="">none</param>
+/// <returns>work units per minute, 0 if none measured</returns>
+uint16_t TargetMachineClass::GetPeakRPM ( void )
 {
-	m_timeActive += ( tNow - m_timeActiveStarted );
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	uint32_t ulMinPeriodus = m_ulMinPeriodus;
+	SREG = uiSREG;
 
-	m_Active = digitalRead ( m_uiActivePin ) == m_uiActiveState ? ACTIVE : IDLE;
+	return PeriodToRPM ( ulMinPeriodus );
 }
 
 /// <summary>
-/// called to update state and remember when targetmachine got power
+/// Forgets the highest rate of work seen so far
 /// </summary>
-/// <param name="tNow">time in milliseconds</param>
-void TargetMachineClass::GoneActive ( uint32_t tNow )
+/// <param name="">none</param>
+void TargetMachineClass::ResetPeakRPM ( void )
 {
-	m_Active = ACTIVE;
-	m_timeActiveStarted = tNow;
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	m_ulMinPeriodus = 0UL;
+	SREG = uiSREG;
 }
 
 /// <summary>
@@ -187,6 +319,138 @@ void TargetMachineClass::GoneActive ( uint32_t tNow )
 void TargetMachineClass::IncWorkUnit ( uint32_t ulIncAmount )
 {
 	m_ulWorkUnitCount += ulIncAmount;
+
+	// only the nearest watch is checked here, others cannot be due before it
+	if ( m_uiWorkWatchCount > 0 && (int32_t)( m_ulWorkUnitCount - m_ulNextWorkWatch ) >= 0 )
+	{
+		CheckWorkWatches ();
+	}
+}
+
+/// <summary>
+/// Asks for a callback as soon as the count of work units reaches a value, e.g. so the oiler can restart the moment the lathe has done enough revs
+/// rather than when it next checks. The callback is made once from the interrupt that signals the unit of work.
+/// </summary>
+/// <param name="pCallback">routine with signature void func ( void* pContext, uint32_t ulWorkUnits )</param>
+/// <param name="pContext">value passed to callback, e.g. object to be notified</param>
+/// <param name="ulWorkUnits">count of work units, as returned by GetWorkUnits(), at which callback is made</param>
+/// <returns>false if max number of watches exceeded, else true</returns>
+bool TargetMachineClass::SetWorkWatch ( WorkWatchCallback pCallback, void* pContext, uint32_t ulWorkUnits )
+{
+	bool bResult = false;
+
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	int8_t iIndex = FindWorkWatch ( pCallback, pContext );
+	if ( iIndex < 0 && m_uiWorkWatchCount < MAX_WORK_WATCHES )
+	{
+		iIndex = m_uiWorkWatchCount++;
+		m_WorkWatches [ iIndex ].pCallback = pCallback;
+		m_WorkWatches [ iIndex ].pContext = pContext;
+	}
+	if ( iIndex >= 0 )
+	{
+		m_WorkWatches [ iIndex ].ulWorkUnits = ulWorkUnits;
+		UpdateNextWorkWatch ();
+		bResult = true;
+	}
+	SREG = uiSREG;
+	return bResult;
+}
+
+/// <summary>
+/// Removes watch set by SetWorkWatch, does nothing if there is none
+/// </summary>
+/// <param name="pCallback">routine passed to SetWorkWatch</param>
+/// <param name="pContext">context passed to SetWorkWatch</param>
+void TargetMachineClass::RemoveWorkWatch ( WorkWatchCallback pCallback, void* pContext )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	int8_t iIndex = FindWorkWatch ( pCallback, pContext );
+	if ( iIndex >= 0 )
+	{
+		RemoveWorkWatchEntry ( iIndex );
+		UpdateNextWorkWatch ();
+	}
+	SREG = uiSREG;
+}
+
+/// <summary>
+/// Makes callback of each watch that has been reached and removes it. A callback may set a new watch, including its own.
+/// </summary>
+/// <param name="">none</param>
+void TargetMachineClass::CheckWorkWatches ( void )
+{
+	// one watch at a time as a callback can change the watches, bounded in case a callback keeps setting a watch that is already reached
+	for ( uint8_t n = 0; n < MAX_WORK_WATCHES; n++ )
+	{
+		int8_t iIndex = -1;
+		for ( uint8_t i = 0; i < m_uiWorkWatchCount && iIndex < 0; i++ )
+		{
+			if ( (int32_t)( m_ulWorkUnitCount - m_WorkWatches [ i ].ulWorkUnits ) >= 0 )
+			{
+				iIndex = i;
+			}
+		}
+		if ( iIndex < 0 )
+		{
+			break;
+		}
+		WorkWatchCallback pCallback = m_WorkWatches [ iIndex ].pCallback;
+		void* pContext = m_WorkWatches [ iIndex ].pContext;
+		RemoveWorkWatchEntry ( iIndex );
+		UpdateNextWorkWatch ();
+		pCallback ( pContext, m_ulWorkUnitCount );
+	}
+}
+
+/// <summary>
+/// Finds watch of callback
+/// </summary>
+/// <param name="pCallback">routine of watch</param>
+/// <param name="pContext">context of watch</param>
+/// <returns>index of watch or -1 if not found</returns>
+int8_t TargetMachineClass::FindWorkWatch ( WorkWatchCallback pCallback, void* pContext )
+{
+	int8_t iResult = -1;
+	for ( uint8_t i = 0; i < m_uiWorkWatchCount && iResult < 0; i++ )
+	{
+		if ( m_WorkWatches [ i ].pCallback == pCallback && m_WorkWatches [ i ].pContext == pContext )
+		{
+			iResult = i;
+		}
+	}
+	return iResult;
+}
+
+/// <summary>
+/// Removes watch by moving last watch into its place, interrupts must be disabled by caller
+/// </summary>
+/// <param name="uiIndex">index of watch</param>
+void TargetMachineClass::RemoveWorkWatchEntry ( uint8_t uiIndex )
+{
+	m_uiWorkWatchCount--;
+	if ( uiIndex != m_uiWorkWatchCount )
+	{
+		m_WorkWatches [ uiIndex ] = m_WorkWatches [ m_uiWorkWatchCount ];
+	}
+}
+
+/// <summary>
+/// Recalculates the nearest watched count, interrupts must be disabled by caller
+/// </summary>
+/// <param name="">none</param>
+void TargetMachineClass::UpdateNextWorkWatch ( void )
+{
+	for ( uint8_t i = 0; i < m_uiWorkWatchCount; i++ )
+	{
+		// compared as a difference so that it works across a wrap of the count
+		if ( i == 0 || (int32_t)( m_WorkWatches [ i ].ulWorkUnits - m_ulNextWorkWatch ) < 0 )
+		{
+			m_ulNextWorkWatch = m_WorkWatches [ i ].ulWorkUnits;
+		}
+	}
 }
 
 /// <summary>
@@ -247,4 +511,4 @@ bool TargetMachineClass::SetActiveState ( uint8_t uiState )
 	return bResult;
 }
 
-TargetMachineClass TheMachine;				// Create instance
+TargetMachineClass TheMachine;				// Create default instance, declare more TargetMachineClass objects to oil more than one machine
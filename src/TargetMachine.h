@@ -12,6 +12,12 @@
 //	In our example machine - a metal working lathe, the active signal indicaates the machine is moving and the unit of work is a completed full rototation of the lather spindle
 //
 // The class keeps track of active time and number of units of work completed. These are optional inputs for the Oiler class to refine when it delivers oil.
+// Active time is only added to when the active signal changes, using the level and time of the change, so reading it needs no pin read, just a copy
+// that is retried if the active signal changed during it and one subtraction. It is held in 64 bit ms so does not overflow.
+// It also measures the time between work signals, smoothed with a fixed point moving average so the interrupt needs no division, to give the rate of
+// work as RPM (work units per minute) when a work unit is one revolution.
+//
+// TheMachine is provided for the usual case of one machine, more instances can be declared if one board oils several machines, each with its own pins.
 //
 #ifndef _TARGETMACHINE_h
 #define _TARGETMACHINE_h
@@ -23,9 +29,13 @@
 #define		MACHINE_ACTIVE_STATE		HIGH				// signal HIGH when machine is active, change to LOW if that is how target machine works
 #define		MACHINE_WORK_PIN_MODE		INPUT_PULLUP		// Default value
 #define		MACHINE_WORK_PIN_SIGNAL		FALLING				// signal FALLS when unit completed, change to RISING if that is how target machine works
+#define		MAX_WORK_WATCHES			4					// max number of work unit counts that can be watched at once
+#define		MACHINE_RPM_SMOOTHING		3					// each work signal moves average period 1 / 2^n of the way to the latest period, higher is smoother but slower to follow
+#define		MACHINE_RPM_TIMEOUTMS		2000UL				// RPM is 0 if no work signal for this long, so slowest RPM measured is 60000 / MACHINE_RPM_TIMEOUTMS
 
 
 typedef void ( *InterruptCallback )( void );
+typedef void ( *WorkWatchCallback )( void* pContext, uint32_t ulWorkUnits );	// called when work unit count reaches watched value, passed count at the time
 
 class TargetMachineClass
 {
@@ -37,30 +47,58 @@ public:
 	void			RestartMonitoring ( void );
 
 	uint32_t		GetActiveTime ( void );						// Active time in secs since oiler stopped
+	uint32_t		GetActiveTimems ( void );					// Active time in ms since oiler stopped, wraps after 49 days
+	uint64_t		GetActiveTimems64 ( void );					// Active time in ms since oiler stopped, does not wrap
+	bool			IsActive ( void );							// true if machine has power
+	uint16_t		GetRPM ( void );							// work units per minute from smoothed time between work signals, 0 if stopped
+	uint32_t		GetPeriodus ( void );						// smoothed us between work signals, 0 if stopped, cheap enough to read with interrupts off
+	static uint16_t	PeriodToRPM ( uint32_t ulPeriodus );		// work units per minute from us between work signals
+	uint16_t		GetPeakRPM ( void );						// highest RPM since monitoring restarted or ResetPeakRPM ()
+	void			ResetPeakRPM ( void );
 	uint32_t		GetWorkUnits ( void );						// number of work units since oiler stopped
 
 	void			IncWorkUnit ( uint32_t ulIncAmount );
 	bool			SetActivePinMode ( uint8_t uiMode );		// set Active input pin to INPUT or INPUT_PULLUP
 	bool			SetWorkPinMode ( uint8_t uiMode );			// set Work input pin to INPUT or INPUT_PULLUP
 	bool			SetActiveState ( uint8_t uiState );			// set if HIGH or LOW indicates machine has power
-	void			CheckActivity ( void );						// check activity after change in signal from machine
+	void			CheckActivity ( void );						// read active pin and update active time if it changed, not needed when pin interrupt is set by AddFeatures
+	bool			SetWorkWatch ( WorkWatchCallback pCallback, void* pContext, uint32_t ulWorkUnits );	// call once when work units reach given count, replaces any watch with same callback and context
+	void			RemoveWorkWatch ( WorkWatchCallback pCallback, void* pContext );
 
 protected:
-	void			UpdatePoweredTime ( void );
-	void			IncActiveTime ( uint32_t tActive );
+	static void		MachineActiveSignal ( void* pContext, uint8_t uiPinState );	// called by interrupt when active pin signals, context is the machine
+	static void		MachineWorkUnitSignal ( void* pContext, uint8_t uiPinState );	// called by interrupt when work pin signals, context is the machine
+	void			ActiveEdge ( uint8_t uiPinState, uint32_t tNow );	// record change of active signal to given level at given millis
 
 	eMachineState	m_State;
-	eActiveState	m_Active;
-	void			GoneActive ( uint32_t tNow );
+	volatile eActiveState	m_Active;
+	void			CheckWorkWatches ( void );
+	int8_t			FindWorkWatch ( WorkWatchCallback pCallback, void* pContext );
+	void			RemoveWorkWatchEntry ( uint8_t uiIndex );
+	void			UpdateNextWorkWatch ( void );
+	void			MeasurePeriod ( uint32_t ulNowus );			// called by interrupt with time of work signal to update average period
 
-	uint32_t		m_timeActive;								// time machine has been active since monitor reset
-	uint32_t		m_timeActiveStarted;						// time machine last went active
+	volatile uint64_t	m_ullActivems;							// ms machine was active before it last went active, since monitor reset
+	volatile uint32_t	m_timeActiveStarted;					// millis machine last went active
+	volatile uint8_t	m_uiActiveSeq;							// changed each time active time is updated so a reader can tell if it copied a partial update
 	uint32_t		m_ulWorkUnitCount;
+	uint32_t		m_ulLastWorkSignalus;						// micros of last work signal
+	uint32_t		m_ulPeriodSum;								// average us between work signals * 2^MACHINE_RPM_SMOOTHING, 0 if no period measured yet
+	uint32_t		m_ulMinPeriodus;							// shortest average period seen, gives peak RPM, 0 if none
 	uint8_t			m_uiActivePin;								// Pin used to signal when machine is active
 	uint8_t			m_uiWorkPin;								// Pin used to signal when machine has completed work
 	uint8_t			m_uiActivePinMode;
 	uint8_t			m_uiWorkPinMode;
 	uint8_t			m_uiActiveState;							// state that inidcates machine has power - must be HIGH or LOW
+
+	struct WORK_WATCH
+	{
+		uint32_t			ulWorkUnits;						// count at which callback is due
+		WorkWatchCallback	pCallback;
+		void*				pContext;
+	} m_WorkWatches [ MAX_WORK_WATCHES ];
+	uint8_t			m_uiWorkWatchCount;							// number of watches set
+	uint32_t		m_ulNextWorkWatch;							// nearest watched count, only this is checked as each unit of work is signalled
 };
 
 extern TargetMachineClass TheMachine;
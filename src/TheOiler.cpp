@@ -0,0 +1,12 @@
+// 
+//  TheOiler.cpp
+// 
+// (c) Mark Naylor June 2021
+//
+//	Default oiler instance, kept in its own file so that it is only linked into sketches that use it. Sketches needing a different number
+//	of motors can declare their own OilerGroupClass<n> instead and will not pay for this one.
+//
+
+#include "OilerLib.h"
+
+OilerGroupClass<OILER_MAX_MOTORS> TheOiler;
@@ -42,60 +42,149 @@ TimerClass::TimerClass ( void )
 /// <param name="ulInterval">number of 1/4000 sec ticks after which callback should be invoked</param>
 /// <returns>true if max number of callbacks not exceeded and this callback is not alreasy registered. else false</returns>
 bool TimerClass::AddCallBack ( TimerCallback Routine, uint32_t ulInterval )
+{
+	return AddCallBack ( Routine, 0, 0, ulInterval );
+}
+
+/// <summary>
+/// adds a callback routine to be called with a context at specified interval, the same routine can be added for different contexts
+/// </summary>
+/// <param name="Routine">address of callback routine with signature of void func ( void* pContext )</param>
+/// <param name="pContext">value passed to callback, e.g. object to be serviced</param>
+/// <param name="ulInterval">number of 1/4000 sec ticks after which callback should be invoked</param>
+/// <returns>true if max number of callbacks not exceeded and this callback and context is not alreasy registered. else false</returns>
+bool TimerClass::AddCallBack ( ContextTimerCallback Routine, void* pContext, uint32_t ulInterval )
+{
+	return AddCallBack ( 0, Routine, pContext, ulInterval );
+}
+
+bool TimerClass::AddCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext, uint32_t ulInterval )
 {
 	bool bResult = false;
 
-	if ( m_uiCallbackCount < MAX_CALLBACKS )
+	// check callback not already registered
+	if ( m_uiCallbackCount < MAX_CALLBACKS && ulInterval > 0 && FindCallBack ( Routine, ContextRoutine, pContext ) < 0 )
 	{
-		// check callback not already registered
-		for ( uint8_t i = 0; i < m_uiCallbackCount; i++ )
-		{
-			// look for match
-			if ( m_aFunctions [ i ] == Routine )
-			{
-				// already here, so quit
-				return bResult;
-			}
-		}
+		// may be called from an interrupt routine so restore rather than enable interrupts
+		uint8_t uiSREG = SREG;
+		noInterrupts ();
 		m_aFunctions [ m_uiCallbackCount ] = Routine;
+		m_aContextFunctions [ m_uiCallbackCount ] = ContextRoutine;
+		m_aContexts [ m_uiCallbackCount ] = pContext;
 		m_aFunctionIntervals [ m_uiCallbackCount ] = ulInterval;
+		m_aCountdown [ m_uiCallbackCount ] = ulInterval;
 		m_uiCallbackCount++;
+		SREG = uiSREG;
 
 		bResult = true;
 	}
 	return bResult;
 }
 
+/// <summary>
+/// Sets a callback routine to be called once with a context after specified delay. If the routine and context are already registered, as an alarm
+/// or at an interval, the entry is changed to be called once after the new delay
+/// </summary>
+/// <param name="Routine">address of callback routine with signature of void func ( void* pContext )</param>
+/// <param name="pContext">value passed to callback, e.g. object to be serviced</param>
+/// <param name="ulDelay">number of ticks after which callback should be invoked, min 1</param>
+/// <returns>true if alarm set, false if max number of callbacks exceeded</returns>
+bool TimerClass::SetAlarm ( ContextTimerCallback Routine, void* pContext, uint32_t ulDelay )
+{
+	bool bResult = false;
+
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	int8_t iIndex = FindCallBack ( 0, Routine, pContext );
+	if ( iIndex < 0 && m_uiCallbackCount < MAX_CALLBACKS )
+	{
+		iIndex = m_uiCallbackCount++;
+		m_aFunctions [ iIndex ] = 0;
+		m_aContextFunctions [ iIndex ] = Routine;
+		m_aContexts [ iIndex ] = pContext;
+	}
+	if ( iIndex >= 0 )
+	{
+		m_aFunctionIntervals [ iIndex ] = 0;
+		m_aCountdown [ iIndex ] = ulDelay > 0 ? ulDelay : 1;
+		bResult = true;
+	}
+	SREG = uiSREG;
+	return bResult;
+}
+
+/// <summary>
+/// Finds entry for callback
+/// </summary>
+/// <param name="Routine">routine without context or 0</param>
+/// <param name="ContextRoutine">routine with context or 0</param>
+/// <param name="pContext">context of routine</param>
+/// <returns>index of entry or -1 if not found</returns>
+int8_t TimerClass::FindCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext )
+{
+	int8_t iResult = -1;
+	for ( uint8_t i = 0; i < m_uiCallbackCount; i++ )
+	{
+		// look for match
+		if ( m_aFunctions [ i ] == Routine && m_aContextFunctions [ i ] == ContextRoutine && m_aContexts [ i ] == pContext )
+		{
+			iResult = i;
+			break;
+		}
+	}
+	return iResult;
+}
+
 /// <summary>
 /// Removes specified callback from configured list
 /// </summary>
 /// <param name="Routine">address of callback routine with signature of void func ( void )</param>
 /// <returns>true if callback removed successfully, else false</returns>
 bool TimerClass::RemoveCallBack ( TimerCallback Routine )
+{
+	return RemoveCallBack ( Routine, 0, 0 );
+}
+
+/// <summary>
+/// Removes specified callback and context from configured list
+/// </summary>
+/// <param name="Routine">address of callback routine with signature of void func ( void* pContext )</param>
+/// <param name="pContext">context callback was added with</param>
+/// <returns>true if callback removed successfully, else false</returns>
+bool TimerClass::RemoveCallBack ( ContextTimerCallback Routine, void* pContext )
+{
+	return RemoveCallBack ( 0, Routine, pContext );
+}
+
+bool TimerClass::RemoveCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext )
 {
 	bool bResult = false;
-	if ( m_uiCallbackCount > 0 )
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	int8_t iIndex = FindCallBack ( Routine, ContextRoutine, pContext );
+	if ( iIndex >= 0 )
 	{
-		for ( uint16_t i = 0; i < m_uiCallbackCount; i++ )
-		{
-			// look for match
-			if ( m_aFunctions [ i ] == Routine )
-			{
-				// match found
-				// overwrite with last entry
-				noInterrupts ();
-				m_aFunctions [ i ] = m_aFunctions [ m_uiCallbackCount ];
-				m_aFunctionIntervals [ i ] = m_aFunctionIntervals [ m_uiCallbackCount ];
-				m_uiCallbackCount--;
-				interrupts ();
-				bResult = true;
-				break;
-			}
-		}
+		RemoveEntry ( iIndex );
+		bResult = true;
 	}
+	SREG = uiSREG;
 	return bResult;
 }
 
+/// <summary>
+/// Removes entry by overwriting it with last entry, must be called with interrupts disabled
+/// </summary>
+/// <param name="uiIndex">index of entry to remove</param>
+void TimerClass::RemoveEntry ( uint8_t uiIndex )
+{
+	m_uiCallbackCount--;
+	m_aFunctions [ uiIndex ] = m_aFunctions [ m_uiCallbackCount ];
+	m_aContextFunctions [ uiIndex ] = m_aContextFunctions [ m_uiCallbackCount ];
+	m_aContexts [ uiIndex ] = m_aContexts [ m_uiCallbackCount ];
+	m_aFunctionIntervals [ uiIndex ] = m_aFunctionIntervals [ m_uiCallbackCount ];
+	m_aCountdown [ uiIndex ] = m_aCountdown [ m_uiCallbackCount ];
+}
+
 /// <summary>
 /// Gets the number of 1/4000 sec ticks required to pass before the callback whose index is provided is invoked
 /// </summary>
@@ -116,6 +205,95 @@ TimerCallback	TimerClass::GetCallback ( uint8_t uiIndex )
 	return m_aFunctions [ uiIndex ];
 }
 
+/// <summary>
+/// Invokes the callback whose index is provided, passing its context if it has one
+/// </summary>
+/// <param name="uiIndex">zero based index of callback list entry required</param>
+void TimerClass::InvokeCallback ( uint8_t uiIndex )
+{
+	if ( m_aContextFunctions [ uiIndex ] )
+	{
+		m_aContextFunctions [ uiIndex ] ( m_aContexts [ uiIndex ] );
+	}
+	else
+	{
+		m_aFunctions [ uiIndex ] ();
+	}
+}
+
+/// <summary>
+/// Called every tick by timer interrupt. Counts down each entry and invokes those that reach 0, interval entries are reloaded and alarms that
+/// were not re-armed by their callback are removed
+/// </summary>
+/// <param name="">none</param>
+void TimerClass::Tick ( void )
+{
+	uint8_t i = 0;
+	while ( i < m_uiCallbackCount )
+	{
+		if ( m_aCountdown [ i ] > 1 )
+		{
+			m_aCountdown [ i ]--;
+			i++;
+		}
+		else
+		{
+			// due, reload before calling so callback can change it
+			m_aCountdown [ i ] = m_aFunctionIntervals [ i ];
+			ContextTimerCallback ContextRoutine = m_aContextFunctions [ i ];
+			void* pContext = m_aContexts [ i ];
+			InvokeCallback ( i );
+			if ( i < m_uiCallbackCount && m_aCountdown [ i ] == 0 && m_aContextFunctions [ i ] == ContextRoutine && m_aContexts [ i ] == pContext )
+			{
+				// alarm has gone off, last entry moves here and is processed next
+				RemoveEntry ( i );
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+}
+
+/// <summary>
+/// Gets the number of ticks until the next callback is due, so that ticks before it can be skipped e.g. whilst the mcu sleeps
+/// </summary>
+/// <param name="">none</param>
+/// <returns>ticks until nearest entry is called, 0 if no entries</returns>
+uint32_t TimerClass::GetTicksToNextCallback ( void )
+{
+	uint32_t ulResult = 0UL;
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	for ( uint8_t i = 0; i < m_uiCallbackCount; i++ )
+	{
+		// an entry counted down to 1 or less is called on the next tick
+		uint32_t ulCountdown = m_aCountdown [ i ] > 1 ? m_aCountdown [ i ] : 1;
+		if ( ulResult == 0UL || ulCountdown < ulResult )
+		{
+			ulResult = ulCountdown;
+		}
+	}
+	SREG = uiSREG;
+	return ulResult;
+}
+
+/// <summary>
+/// Counts down all entries by a number of ticks without calling them, same as that many calls of Tick () when none are due
+/// </summary>
+/// <param name="ulTicks">ticks to count down, must be less than GetTicksToNextCallback () so no entry becomes due</param>
+void TimerClass::SkipTicks ( uint32_t ulTicks )
+{
+	uint8_t uiSREG = SREG;
+	noInterrupts ();
+	for ( uint8_t i = 0; i < m_uiCallbackCount; i++ )
+	{
+		m_aCountdown [ i ] = m_aCountdown [ i ] > ulTicks ? m_aCountdown [ i ] - ulTicks : 1;
+	}
+	SREG = uiSREG;
+}
+
 /// <summary>
 /// Clears callback list
 /// </summary>
@@ -140,21 +318,12 @@ uint8_t TimerClass::GetNumCallbacks ( void )
 
 /// <summary>
 /// hardware Timer2 interrupt - called every 1/4000 second. Checks if any configured callback is due to be called and invokes if necessary
+/// <para>each entry holds a count of ticks until it is due so no division is needed</para>
 /// </summary>
 /// <param name="">none</param>
 ISR ( TIMER2_COMPA_vect )
 {
-	static uint32_t ulCount = 0;
-	uint8_t uiNumCallbacks = TheTimer.GetNumCallbacks ();
-
-	for ( uint8_t i = 0; i < uiNumCallbacks; i++ )
-	{
-		if ( ( ulCount % TheTimer.GetInterval ( i ) ) == 0 )
-		{
-			TheTimer.GetCallback ( i ) ( );
-		}
-	}
-	ulCount++;
+	TheTimer.Tick ();
 	TCNT2 = 0;		// Shouldn't be necessary!
 }
 
@@ -1,6 +1,7 @@
 // Timer.h
 //
 // This defines a timer class that encapsulates a microsecond timer that has functions to call at given intervals
+// or once after a given delay (alarm)
 //
 // (c) Mark Naylor June 2021
 //
@@ -14,24 +15,40 @@
 #define RESOLUTION		2000		// ticks per sec
 
 typedef void ( *TimerCallback )( void );
+typedef void ( *ContextTimerCallback )( void* pContext );		// callback passed the context it was registered with
 
 class TimerClass
 {
 public:
 	TimerClass ( void );
 	bool		AddCallBack ( TimerCallback Routine, uint32_t uiInterval );
+	bool		AddCallBack ( ContextTimerCallback Routine, void* pContext, uint32_t uiInterval );
+	bool		SetAlarm ( ContextTimerCallback Routine, void* pContext, uint32_t ulDelay );	// call routine once after delay, re-arms if already set
 	bool		RemoveCallBack ( TimerCallback Routine );
+	bool		RemoveCallBack ( ContextTimerCallback Routine, void* pContext );
 	uint32_t	GetInterval ( uint8_t uiIndex );
 	TimerCallback GetCallback ( uint8_t uiIndex );
+	void		InvokeCallback ( uint8_t uiIndex );
+	void		Tick ( void );												// called by timer interrupt, invokes callbacks that are due
+	uint32_t	GetTicksToNextCallback ( void );							// ticks until next callback is due, 0 if none
+	void		SkipTicks ( uint32_t ulTicks );								// count down ticks in one go, must be fewer than GetTicksToNextCallback ()
 	void		ClearAllCallBacks ( void );
 	uint8_t		GetNumCallbacks ( void );
 
 
 
 protected:
+	bool		AddCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext, uint32_t ulInterval );
+	bool		RemoveCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext );
+	int8_t		FindCallBack ( TimerCallback Routine, ContextTimerCallback ContextRoutine, void* pContext );
+	void		RemoveEntry ( uint8_t uiIndex );
+
 	uint8_t			m_uiCallbackCount;
 	TimerCallback	m_aFunctions [ MAX_CALLBACKS ];
-	uint32_t		m_aFunctionIntervals [ MAX_CALLBACKS ];
+	ContextTimerCallback	m_aContextFunctions [ MAX_CALLBACKS ];	// used in place of m_aFunctions entry if not 0
+	void*			m_aContexts [ MAX_CALLBACKS ];
+	uint32_t		m_aFunctionIntervals [ MAX_CALLBACKS ];				// 0 => alarm, entry removed once called
+	uint32_t		m_aCountdown [ MAX_CALLBACKS ];						// ticks until entry next called
 };
 
 extern TimerClass TheTimer;